@@ -0,0 +1,82 @@
+# Active Directory forest configuration sources, shared by benchmarks/ and tests/.
+# QLIQDIRECT_SRC (qmake variable or environment) is the root of the qliqDirect tree
+# providing dao/, db/, json/, qliqdirect/shared/, QsLog.h and qliqDirectAD.h, and
+# QLIQDIRECT_LIBS the libraries implementing them.
+
+isEmpty(QLIQDIRECT_SRC): QLIQDIRECT_SRC = $$(QLIQDIRECT_SRC)
+isEmpty(QLIQDIRECT_LIBS): QLIQDIRECT_LIBS = $$(QLIQDIRECT_LIBS)
+
+QT += core sql network widgets
+CONFIG += c++14
+
+INCLUDEPATH += $$PWD $$QLIQDIRECT_SRC
+LIBS += $$QLIQDIRECT_LIBS
+
+HEADERS += \
+    $$PWD/ActiveDirectoryDomainControllerManager.h \
+    $$PWD/DatabaseWriter.h \
+    $$PWD/DirectorySessionPool.h \
+    $$PWD/DomainControllerDiscovery.h \
+    $$PWD/DomainControllerHealthCache.h \
+    $$PWD/DomainControllerProbe.h \
+    $$PWD/ForestChangeBatchWriter.h \
+    $$PWD/ForestConfigurationSnapshot.h \
+    $$PWD/ForestDeletionJob.h \
+    $$PWD/ForestDiff.h \
+    $$PWD/ForestMetrics.h \
+    $$PWD/ForestRescopeJob.h \
+    $$PWD/ForestSchema.h \
+    $$PWD/ForestSchemaMigration.h \
+    $$PWD/ForestSnapshotFile.h \
+    $$PWD/ForestSyncScheduler.h \
+    $$PWD/GearColumnDelegate.h \
+    $$PWD/MenuColumnTableExport.h \
+    $$PWD/MenuColumnTableFilterIndex.h \
+    $$PWD/MenuColumnTableModel.h \
+    $$PWD/MenuColumnTableShared.h \
+    $$PWD/MenuColumnTableView.h \
+    $$PWD/MenuColumnTableWidget.h \
+    $$PWD/MenuColumnTableWidthStats.h \
+    $$PWD/ObjectGuid.h \
+    $$PWD/SyncProgressLedger.h \
+    $$PWD/ThreadDatabase.h
+
+SOURCES += \
+    $$PWD/ActiveDirectoryDomainControllerManager.cpp \
+    $$PWD/DatabaseWriter.cpp \
+    $$PWD/DirectorySessionPool.cpp \
+    $$PWD/DomainControllerDiscovery.cpp \
+    $$PWD/DomainControllerHealthCache.cpp \
+    $$PWD/DomainControllerProbe.cpp \
+    $$PWD/ForestChangeBatchWriter.cpp \
+    $$PWD/ForestDeletionJob.cpp \
+    $$PWD/ForestDiff.cpp \
+    $$PWD/ForestMetrics.cpp \
+    $$PWD/ForestRescopeJob.cpp \
+    $$PWD/ForestSchemaMigration.cpp \
+    $$PWD/ForestSnapshotFile.cpp \
+    $$PWD/ForestSyncScheduler.cpp \
+    $$PWD/GearColumnDelegate.cpp \
+    $$PWD/MenuColumnTableExport.cpp \
+    $$PWD/MenuColumnTableFilterIndex.cpp \
+    $$PWD/MenuColumnTableModel.cpp \
+    $$PWD/MenuColumnTableShared.cpp \
+    $$PWD/MenuColumnTableView.cpp \
+    $$PWD/MenuColumnTableWidget.cpp \
+    $$PWD/MenuColumnTableWidthStats.cpp \
+    $$PWD/ObjectGuid.cpp \
+    $$PWD/SyncProgressLedger.cpp \
+    $$PWD/ThreadDatabase.cpp
+
+# ADSI and DsGetDc backends
+win32 {
+    HEADERS += \
+        $$PWD/AdsiDirectorySession.h \
+        $$PWD/DomainControllerManager.h \
+        $$PWD/DsGetDcResolver.h
+    SOURCES += \
+        $$PWD/AdsiDirectorySession.cpp \
+        $$PWD/DomainControllerManager.cpp \
+        $$PWD/DsGetDcResolver.cpp
+    LIBS += -lactiveds -ladsiid -lnetapi32 -lpsapi
+}
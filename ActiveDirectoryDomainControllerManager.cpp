@@ -1,81 +1,292 @@
 #include "ActiveDirectoryDomainControllerManager.h"
 #include <QString>
 #include <QDebug>
+#include <QHash>
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QElapsedTimer>
 #include <QsLog.h>
 #include "dao/ActiveDirectoryDao.h"
 #include "db/DatabaseUtil.h"
 #include "json/qt-json/qtjson.h"
 #include "AdForestComparator.h"
+#include "DomainControllerProbe.h"
+#include "ThreadDatabase.h"
+#include "ForestSchema.h"
+#include "ForestChangeBatchWriter.h"
+#include "ForestDiff.h"
+#include "ForestMetrics.h"
+#include "ForestSchemaMigration.h"
+#include "ForestSnapshotFile.h"
+#ifdef Q_OS_WIN
+#include "AdsiDirectorySession.h"
+#endif
 
 namespace ActiveDirectory {
 
 namespace  {
 
-bool updateDatabaseWithForestChanges(QSqlDatabase db, QVector<ForestComparator::ForestWithChange> changes)
-{
-    return DatabaseUtil::inTransaction(db, "update AD forests", [&changes](QSqlDatabase db) -> bool {
-        foreach (const auto& fc, changes) {
-            QLOG_SUPPORT() << "Processing changes for forest" << fc.forest.objectGuid;
-
-            if (hasChange(fc, ForestComparator::Added)) {
-                QLOG_SUPPORT() << "This is a new forest (added)";
-                ForestDao::insert(fc.forest, db);
-                // Domain controllers will be added in a loop below
-            } else if (hasChange(fc, ForestComparator::Deleted)) {
-                QLOG_SUPPORT() << "This forest is deleted now";
-                ActiveDirectoryUserDao::markDeletedAllOfForest(fc.forest.objectGuid, db);
-                ActiveDirectoryGroupDao::deleteMainGroupsOfForest(fc.forest.objectGuid, db);
-                ActiveDirectoryGroupDao::markDeletedAllOfForest(fc.forest.objectGuid, db);
-                ForestGroupMembershipDao::deleteOfForest(fc.forest.objectGuid, db);
-                ForestDao::delete_(ForestDao::ObjectGuidColumn, fc.forest.objectGuid, db);
-                SyncContextDao::delete_(SyncContextDao::ForestGuidColumn, fc.forest.objectGuid, db);
-            } else {
-                if (hasChange(fc, ForestComparator::CredentialsChanged)) {
-                    QLOG_SUPPORT() << "Credentials changed for forest";
-                    ForestDao::updateColumn(ForestDao::UserNameCoumn, fc.forest.userName, fc.forest, db);
-                    ForestDao::updateColumn(ForestDao::PasswordColumn, fc.forest.password, fc.forest, db);
-                }
-                if (hasChange(fc, ForestComparator::SyncGroupChanged)) {
-                    QLOG_SUPPORT() << "Sync group changed for forest, full sync is pending";
-                    ForestDao::updateColumn(ForestDao::SyncGroupColumn, fc.forest.syncGroup, fc.forest, db);
-                    SyncContextDao::delete_(SyncContextDao::ForestGuidColumn, fc.forest.objectGuid, db);
-                }
-            }
+bool writeForestChanges(QSqlDatabase db, const QVector<ForestComparator::ForestWithChange>& changes, bool isIncrementalRescope,
+                        bool *outHasDeletedForests, int *outRowsAffected)
+{
+    ForestChangeBatchWriter writer(db);
+    writer.setIncrementalRescope(isIncrementalRescope);
+    foreach (const auto& fc, changes) {
+        writer.add(fc);
+    }
+    bool ret = writer.write();
+    QLOG_SUPPORT() << "Applied" << writer.changeCount() << "forest changes," << writer.rowsAffected() << "rows affected";
+    *outHasDeletedForests = writer.hasDeletedForests();
+    *outRowsAffected = writer.rowsAffected();
+    return ret;
+}
 
-            foreach (const auto& dcc, fc.domainControllerChanges) {
-                switch (dcc.change) {
-                case ForestComparator::DomainControllerWithChange::Added:
-                    QLOG_SUPPORT() << "Domain controller added" << dcc.domainContoller.host << "is primary:" << dcc.domainContoller.isPrimary;
-                    ForestDomainControllerMembershipDao::insert(fc.forest.objectGuid, dcc.domainContoller, db);
-                    break;
-                case ForestComparator::DomainControllerWithChange::IsPrimaryChanged:
-                    QLOG_SUPPORT() << "Domain controller changed" << dcc.domainContoller.host << "now primary:" << dcc.domainContoller.isPrimary;
-                    ForestDomainControllerMembershipDao::updateIsPrimary(fc.forest.objectGuid, dcc.domainContoller, db);
-                    break;
-                case ForestComparator::DomainControllerWithChange::Deleted:
-                    QLOG_SUPPORT() << "Domain controller deleted" << dcc.domainContoller.host << "was primary:" << dcc.domainContoller.isPrimary;
-                    ForestDomainControllerMembershipDao::delete_(fc.forest.objectGuid, dcc.domainContoller, db);
-                    // Delete sync context for that dc
-                    SyncContextDao::delete_(SyncContextDao::DomainControllerHostColumn, dcc.domainContoller.host, db);
-                    break;
-                }
+bool writeForestChanges(QSqlDatabase db, const QVector<ForestComparator::ForestWithChange>& changes, bool isIncrementalRescope,
+                        bool *outHasDeletedForests, int *outRowsAffected, ForestConfigurationStamp *outStamp)
+{
+    if (!writeForestChanges(db, changes, isIncrementalRescope, outHasDeletedForests, outRowsAffected)) {
+        return false;
+    }
+    // Read in the same transaction, so it is the stamp of exactly these changes
+    if (!ForestSnapshotFile::readStamp(db, outStamp)) {
+        *outStamp = ForestConfigurationStamp();
+    }
+    return true;
+}
+
+/*
+ * With a writer the changes are committed on its thread (possibly together with other queued writes),
+ * this waits only for durability, it does not hold the database while probes write.
+ * 'outStamp' receives the configuration stamp after the changes (invalid if unknown).
+ */
+bool updateDatabaseWithForestChanges(QSqlDatabase db, QSharedPointer<DatabaseWriter> databaseWriter,
+                                     QVector<ForestComparator::ForestWithChange> changes, bool isIncrementalRescope,
+                                     bool *outHasDeletedForests, ForestConfigurationStamp *outStamp)
+{
+    ForestMetricsTimer metricsTimer;
+    bool hasDeletedForests = false;
+    int rowsAffected = 0;
+    ForestConfigurationStamp stamp;
+    bool ret = false;
+    if (databaseWriter) {
+        ret = databaseWriter->write("update AD forests", [changes, isIncrementalRescope, &hasDeletedForests, &rowsAffected, &stamp](QSqlDatabase db) -> bool {
+            return writeForestChanges(db, changes, isIncrementalRescope, &hasDeletedForests, &rowsAffected, &stamp);
+        });
+    } else {
+        ret = DatabaseUtil::inTransaction(db, "update AD forests", [&changes, isIncrementalRescope, &hasDeletedForests, &rowsAffected, &stamp](QSqlDatabase db) -> bool {
+            return writeForestChanges(db, changes, isIncrementalRescope, &hasDeletedForests, &rowsAffected, &stamp);
+        });
+    }
+    *outHasDeletedForests = hasDeletedForests;
+    *outStamp = ret ? stamp : ForestConfigurationStamp();
+
+    if (metricsTimer.isEnabled()) {
+        QString result = ForestMetrics::label("result", ret ? "committed" : "rolled_back");
+        metricsTimer.observe(METRIC_CONFIG_TRANSACTION_DURATION, result);
+        ForestMetrics::instance()->increment(METRIC_CONFIG_TRANSACTION_TOTAL, result);
+        if (ret) {
+            ForestMetrics::instance()->increment(METRIC_CONFIG_ROWS_AFFECTED_TOTAL, QString(), rowsAffected);
+        }
+    }
+    return ret;
+}
+
+#define DC_MEMBERSHIP_SELECT_ALL "SELECT " DC_MEMBERSHIP_FOREST_GUID_COLUMN ", " DC_MEMBERSHIP_HOST_COLUMN ", " \
+    DC_MEMBERSHIP_IS_PRIMARY_COLUMN ", " DC_MEMBERSHIP_FULL_SERVER_NAME_COLUMN " FROM " DC_MEMBERSHIP_TABLE " ORDER BY rowid"
+
+/*
+ * Load all forests with their domain controllers using two set based queries
+ * (one for DC memberships, one for forests) instead of 1 + 2 * N queries.
+ * Result is the same as loading forest by forest: only forests having domain controllers
+ * are returned, in order of their first domain controller membership row.
+ */
+QVector<Forest> loadForestsInBulk(QSqlDatabase db)
+{
+    QVector<Forest> forests;
+    QStringList forestGuids;
+    QHash<QString, Forest> forestByGuid;
+
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    if (!query.exec(DC_MEMBERSHIP_SELECT_ALL)) {
+        QLOG_ERROR() << "Cannot load domain controllers of forests:" << query.lastError().text();
+        return forests;
+    }
+
+    QHash<QString, QVector<DomainController> > dcsByForest;
+    while (query.next()) {
+        QString forestGuid = query.value(0).toString();
+        DomainController dc;
+        dc.host = query.value(1).toString();
+        dc.isPrimary = query.value(2).toBool();
+        dc.dnsName = query.value(3).toString();
+
+        auto it = dcsByForest.find(forestGuid);
+        if (it == dcsByForest.end()) {
+            forestGuids.append(forestGuid);
+            it = dcsByForest.insert(forestGuid, QVector<DomainController>());
+        }
+        // Empty DC should not be possible, but just in case test for it
+        if (dc.host.trimmed().isEmpty()) {
+            QLOG_FATAL() << "Empty DC found for forest" << forestGuid;
+            continue;
+        }
+        it->append(dc);
+    }
+
+    foreach (const Forest& forest, ForestDao::selectAll(db)) {
+        if (dcsByForest.contains(forest.objectGuid)) {
+            forestByGuid.insert(forest.objectGuid, forest);
+        }
+    }
+
+    forests.reserve(forestGuids.size());
+    foreach (const QString& forestGuid, forestGuids) {
+        auto it = forestByGuid.find(forestGuid);
+        if (it == forestByGuid.end() || it->isEmpty()) {
+            QLOG_ERROR() << "Cannot load forest with guid " << forestGuid << "from database but it has domain controllers";
+            continue;
+        }
+
+        Forest& forest = *it;
+        forest.domainControllers.clear();
+        foreach (const DomainController& dc, dcsByForest.value(forestGuid)) {
+            forest.domainControllers.append(dc);
+        }
+        forest.sortDomainControllersByPrimary();
+        forests.append(forest);
+    }
+    return forests;
+}
+
+/*
+ * Forests pushed by qD Manager have no DNS names of their DCs. DCs kept from the previous
+ * configuration have the names probes learned in their membership rows, so the published
+ * forests (and the snapshot file written from them) match what a load from the database gives.
+ */
+void fillLearnedDnsNames(QVector<Forest> *forests, QSqlDatabase db)
+{
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    if (!query.exec("SELECT " DC_MEMBERSHIP_FOREST_GUID_COLUMN ", " DC_MEMBERSHIP_HOST_COLUMN ", " DC_MEMBERSHIP_FULL_SERVER_NAME_COLUMN
+                    " FROM " DC_MEMBERSHIP_TABLE " WHERE " DC_MEMBERSHIP_FULL_SERVER_NAME_COLUMN " <> ''")) {
+        QLOG_ERROR() << "Cannot read DNS names of domain controllers:" << query.lastError().text();
+        return;
+    }
+
+    // Keyed by forest guid and lower case host
+    QHash<QString, QString> dnsNames;
+    while (query.next()) {
+        dnsNames.insert(query.value(0).toString() + '\n' + query.value(1).toString().toLower(), query.value(2).toString());
+    }
+    if (dnsNames.isEmpty()) {
+        return;
+    }
+    for (int i = 0; i < forests->size(); ++i) {
+        Forest& forest = (*forests)[i];
+        for (int j = 0; j < forest.domainControllers.size(); ++j) {
+            DomainController& dc = forest.domainControllers[j];
+            if (dc.dnsName.isEmpty()) {
+                dc.dnsName = dnsNames.value(forest.objectGuid + '\n' + dc.host.toLower());
             }
         }
-        return true;
-    });
+    }
+}
+
+bool containsHost(const QVector<DomainController>& domainControllers, const QString& host)
+{
+    foreach (const DomainController& dc, domainControllers) {
+        if (dc.host.compare(host, Qt::CaseInsensitive) == 0 || dc.dnsName.compare(host, Qt::CaseInsensitive) == 0) {
+            return true;
+        }
+    }
+    return false;
 }
 
 } // anonymous namespace
 
+ForestCursor::ForestCursor() :
+    m_manager(nullptr),
+    m_index(-1)
+{
+}
+
+ForestCursor::ForestCursor(DomainControllerManager *manager, const ForestConfigurationSnapshotPtr& snapshot) :
+    m_manager(manager),
+    m_snapshot(snapshot),
+    m_index(-1)
+{
+}
+
+/*
+ * Next forest of the snapshot with its accessible domain controller
+ */
+bool ForestCursor::next(Forest *outForest, DomainController *outActiveDomainController)
+{
+    if (!isValid()) {
+        return false;
+    }
+
+    m_index++;
+    if (m_index < m_snapshot->forests.size()) {
+        ForestMetricsTimer metricsTimer;
+        Forest forest = m_snapshot->forests[m_index];
+        while (m_manager->isDeletionPending(forest.objectGuid)) {
+            QLOG_SUPPORT() << "Forest" << forest.objectGuid << "is skipped, data of its previous configuration is being deleted";
+            if (++m_index >= m_snapshot->forests.size()) {
+                return false;
+            }
+            forest = m_snapshot->forests[m_index];
+        }
+        DomainController dc;
+        bool ret = m_manager->selectDomainController(&forest, &dc);
+        if (metricsTimer.isEnabled()) {
+            metricsTimer.observe(METRIC_NEXT_FOREST_DURATION, ForestMetrics::label("forest", forest.objectGuid));
+        }
+        if (ret) {
+            *outForest = forest;
+            *outActiveDomainController = dc;
+            return true;
+        }
+
+        // TODO: here send email to admin that we cannot connect to any of domain controllers of this forest
+    }
+    return false;
+}
+
+quint64 ForestCursor::generation() const
+{
+    return m_snapshot ? m_snapshot->generation : 0;
+}
+
+bool ForestCursor::isValid() const
+{
+    return m_manager && m_snapshot;
+}
+
 DomainControllerManager::DomainControllerManager() :
-    m_forestIndex(-1),
-    m_isLoaded(false)
+    m_isLoaded(false),
+    m_snapshot(std::make_shared<ForestConfigurationSnapshot>()),
+    m_defaultProbeTier(FullProbeTier),
+    m_isIncrementalRescope(false),
+    m_isDatabaseWriterEnabled(true),
+    m_isSnapshotFilePathSet(false),
+    m_isParallelProbe(false),
+    m_probeDeadlineMs(30000),
+    m_primaryGraceMs(2000)
 {
+#ifdef Q_OS_WIN
+    m_sessionPool = AdsiDirectorySessionBackend::sharedPool();
+#endif
+    QObject::connect(&m_deletionJob, &ForestDeletionJob::finished, &m_deletionJob, [this](const QString& forestGuid) {
+        QMutexLocker locker(&m_pendingDeletionMutex);
+        m_pendingDeletionForestGuids.remove(forestGuid);
+    });
 }
 
 void DomainControllerManager::resetIteration()
 {
-    m_forestIndex = -1;
+    m_cursor = cursor();
 }
 
 /*
@@ -90,22 +301,95 @@ bool DomainControllerManager::nextForest(Forest *outForest, DomainController *ou
     if (!m_isLoaded) {
         QLOG_ERROR() << "Forest configuration is not loaded (in nextForest()), loading now";
         load();
+        m_cursor = cursor();
     }
 
-    m_forestIndex++;
-    if (m_forestIndex < m_forests.size()) {
-        Forest forest = m_forests[m_forestIndex];
+    // Iteration continues over the snapshot it started with, resetIteration() moves to the latest one
+    if (!m_cursor.isValid()) {
+        m_cursor = cursor();
+    }
+    return m_cursor.next(outForest, outActiveDomainController);
+}
 
-        for (int i = 0; i < forest.domainControllers.size(); ++i) {
-            DomainController& dc = forest.domainControllers[i];
-            if (isServerAccessible(&dc, forest)) {
-                *outForest = forest;
-                *outActiveDomainController = dc;
-                return true;
-            }
+/*
+ * Find accessible domain controller of the forest, preferably primary one.
+ * This method is thread safe, so ForestSyncScheduler workers call it concurrently.
+ * Discovered DCs take part in the selection, 'forest' keeps only its configured DCs.
+ */
+bool DomainControllerManager::selectDomainController(Forest *forest, DomainController *outActiveDomainController)
+{
+    Forest candidates = *forest;
+    int configuredCount = candidates.domainControllers.size();
+    if (appendDiscoveredDomainControllers(&candidates) == 0) {
+        return selectDomainControllerOf(forest, outActiveDomainController);
+    }
+
+    bool ret = selectDomainControllerOf(&candidates, outActiveDomainController);
+    // DNS names learned by the probes
+    for (int i = 0; i < configuredCount; ++i) {
+        forest->domainControllers[i].dnsName = candidates.domainControllers[i].dnsName;
+    }
+    if (ret) {
+        recordReplicationState(*forest, *outActiveDomainController);
+    }
+    return ret;
+}
+
+/*
+ * Like updateServerName(), written on the calling thread or queued to the writer
+ */
+void DomainControllerManager::recordReplicationState(const Forest& forest, const DomainController& dc)
+{
+    ReplicationStateFunction reader;
+    {
+        QMutexLocker locker(&m_probeMutex);
+        reader = m_replicationStateReader;
+    }
+    DirectoryReplicationState state;
+    if (!reader || !reader(forest, dc, &state)) {
+        return;
+    }
+
+    QString forestGuid = forest.objectGuid;
+    QString host = dc.host;
+    DatabaseWriter::Operation operation = [forestGuid, host, state](QSqlDatabase db) -> bool {
+        return SyncProgressLedger::recordObservation(forestGuid, host, state, db);
+    };
+    if (m_databaseWriter) {
+        m_databaseWriter->submit("record DC replication state", operation);
+    } else {
+        DatabaseUtil::inTransaction(databaseForCurrentThread(m_db), "record DC replication state", operation);
+    }
+}
+
+bool DomainControllerManager::selectDomainControllerOf(Forest *forest, DomainController *outActiveDomainController)
+{
+    // Primary first, then the fastest healthy DCs. DCs in failure backoff are tried last,
+    // one after another, in order of their retry time.
+    int backedOffCount = 0;
+    QVector<int> order = m_healthCache.rank(*forest, &backedOffCount);
+    QVector<int> backedOff = order.mid(order.size() - backedOffCount);
+    order.resize(order.size() - backedOffCount);
+    if (order.isEmpty() && !backedOff.isEmpty()) {
+        QLOG_ERROR() << "All domain controllers of forest" << forest->objectGuid << "are in failure backoff, trying them anyway";
+    }
+
+    if (m_isParallelProbe && order.size() > 1) {
+        int index = findAccessibleInParallel(forest, order);
+        if (index != -1) {
+            *outActiveDomainController = forest->domainControllers[index];
+            return true;
         }
+        order.clear();
+    }
 
-        // TODO: here send email to admin that we cannot connect to any of domain controllers of this forest
+    order += backedOff;
+    foreach (int i, order) {
+        DomainController& dc = forest->domainControllers[i];
+        if (isServerAccessible(&dc, *forest)) {
+            *outActiveDomainController = dc;
+            return true;
+        }
     }
     return false;
 }
@@ -115,28 +399,199 @@ bool DomainControllerManager::nextForest(Forest *outForest, DomainController *ou
  */
 bool DomainControllerManager::isServerAccessible(DomainController *domainController, const Forest& config)
 {
-    QString errorMsg;
-    QString dnsName;
-    ActiveDirectoryApi ad;
     QLOG_SUPPORT() << "Checking accessibility of domain controller:" << domainController->host;
-    long hr = ad.isServerAccessible(domainController->host, &dnsName, &errorMsg, m_db);
+    // Sequential check runs on the calling thread like it always did, no probe is left behind
+    ProbeCancellationToken probeCancellation = cancellation();
+    QString dnsName;
+    QString errorMsg;
+    QElapsedTimer timer;
+    timer.start();
+    long hr = probeFor(config)->probe(domainController->host, &dnsName, &errorMsg, probeCancellation);
+    qint64 latencyMs = timer.elapsed();
+    if (hr == E_ABORT && probeCancellation.isCancelled()) {
+        QLOG_SUPPORT() << "Accessibility check of domain controller:" << domainController->host << "was cancelled";
+        return false;
+    }
+
     bool ret = false;
     if (SUCCEEDED(hr)) {
-        QLOG_SUPPORT() << "Domain controller:" << domainController->host << "is accessible with full name:" << dnsName;
-
-        // update fullServerName in active_directory_forest_dc_membership. This is required
-        // as active_directory_sync_context table identify domain controller with fullServerName
-        if (domainController->dnsName.isEmpty()) {
-            domainController->dnsName = dnsName;
-            ForestDomainControllerMembershipDao::updateServerName(config.objectGuid, *domainController, m_db);
-        }
+        recordProbeResult(domainController->host, true, latencyMs);
+        updateServerName(domainController, dnsName, config);
         ret = true;
     } else {
-        QLOG_ERROR() << "Domain controller:" << domainController->host << "is not accessible with error:" << hr;
+        recordProbeResult(domainController->host, false, latencyMs);
+        QLOG_ERROR() << "Domain controller:" << domainController->host << "is not accessible with error:" << hr << errorMsg;
     }
     return ret;
 }
 
+/*
+ * Probe domain controllers of the forest (listed in 'order') at once. Returns index of the selected
+ * domain controller in forest->domainControllers or -1 if none is accessible.
+ */
+int DomainControllerManager::findAccessibleInParallel(Forest *forest, const QVector<int>& order)
+{
+    QStringList hosts;
+    foreach (int i, order) {
+        hosts.append(forest->domainControllers[i].host);
+    }
+    // Ranking puts primary first, so only the first one can be primary
+    bool firstIsPrimary = forest->domainControllers[order.first()].isPrimary;
+
+    QString dnsName;
+    QVector<DomainControllerProbeOutcome> outcomes;
+    int winner = ParallelDomainControllerProber::probe(probeFor(*forest), hosts, firstIsPrimary, m_probeDeadlineMs, m_primaryGraceMs,
+                                                       &dnsName, &outcomes, cancellation());
+
+    // Probes cancelled before they answered say nothing about health of the DC
+    for (int i = 0; i < outcomes.size(); ++i) {
+        if (!outcomes[i].isDone) {
+            continue;
+        }
+        if (outcomes[i].hr != E_ABORT) {
+            recordProbeResult(hosts[i], SUCCEEDED(outcomes[i].hr), outcomes[i].latencyMs);
+        }
+    }
+
+    if (winner == -1) {
+        return -1;
+    }
+    int index = order[winner];
+    updateServerName(&forest->domainControllers[index], dnsName, *forest);
+    return index;
+}
+
+void DomainControllerManager::recordProbeResult(const QString& host, bool isAccessible, qint64 latencyMs)
+{
+    if (isAccessible) {
+        m_healthCache.recordSuccess(host, latencyMs);
+    } else {
+        m_healthCache.recordFailure(host);
+    }
+
+    if (ForestMetrics::isEnabled()) {
+        QString labels = ForestMetrics::label("host", host) + "," + ForestMetrics::label("result", isAccessible ? "ok" : "fail");
+        ForestMetrics::instance()->observe(METRIC_DC_PROBE_DURATION, labels, latencyMs);
+        ForestMetrics::instance()->increment(METRIC_DC_PROBE_TOTAL, labels);
+    }
+}
+
+/*
+ * Database is written here, on the calling thread, never from probe threads.
+ * With a writer the update is only queued, the probing caller does not wait for it.
+ */
+void DomainControllerManager::updateServerName(DomainController *domainController, const QString& dnsName, const Forest& config)
+{
+    QLOG_SUPPORT() << "Domain controller:" << domainController->host << "is accessible with full name:" << dnsName;
+
+    // update fullServerName in active_directory_forest_dc_membership. This is required
+    // as active_directory_sync_context table identify domain controller with fullServerName
+    if (domainController->dnsName.isEmpty()) {
+        domainController->dnsName = dnsName;
+        if (setDiscoveredServerName(config.objectGuid, domainController->host, dnsName)) {
+            // Not in the configuration, nothing to update in the database
+        } else if (m_databaseWriter) {
+            QString forestGuid = config.objectGuid;
+            DomainController dc = *domainController;
+            m_databaseWriter->submit("update DC server name", [forestGuid, dc](QSqlDatabase db) -> bool {
+                ForestDomainControllerMembershipDao::updateServerName(forestGuid, dc, db);
+                return true;
+            });
+        } else {
+            ForestDomainControllerMembershipDao::updateServerName(config.objectGuid, *domainController, databaseForCurrentThread(m_db));
+        }
+    }
+}
+
+QSharedPointer<DomainControllerProbe> DomainControllerManager::probe()
+{
+    QMutexLocker locker(&m_probeMutex);
+    if (!m_probe) {
+        m_probe.reset(new ActiveDirectoryApiProbe(m_db));
+    }
+    return m_probe;
+}
+
+/*
+ * Probe of the tier configured for the forest. DNS names already stored in configuration
+ * let the ping tier skip the full check.
+ */
+QSharedPointer<DomainControllerProbe> DomainControllerManager::probeFor(const Forest& forest)
+{
+    QSharedPointer<DomainControllerProbe> full = probe();
+    QMutexLocker locker(&m_probeMutex);
+    DomainControllerProbeTier tier = m_probeTiers.value(forest.objectGuid, m_defaultProbeTier);
+    if (tier == FullProbeTier) {
+        return full;
+    }
+    if (!m_pingProbe) {
+        m_pingProbe.reset(new TcpConnectProbe());
+    }
+
+    QHash<QString, QString> knownDnsNames;
+    foreach (const DomainController& dc, forest.domainControllers) {
+        if (!dc.dnsName.isEmpty()) {
+            knownDnsNames.insert(dc.host, dc.dnsName);
+        }
+    }
+    return QSharedPointer<DomainControllerProbe>(new TieredDomainControllerProbe(m_pingProbe, full, tier, knownDnsNames));
+}
+
+void DomainControllerManager::setPingProbe(QSharedPointer<DomainControllerProbe> probe)
+{
+    QMutexLocker locker(&m_probeMutex);
+    m_pingProbe = probe;
+}
+
+void DomainControllerManager::setDefaultProbeTier(DomainControllerProbeTier tier)
+{
+    QMutexLocker locker(&m_probeMutex);
+    m_defaultProbeTier = tier;
+}
+
+void DomainControllerManager::setProbeTier(const QString& forestGuid, DomainControllerProbeTier tier)
+{
+    QMutexLocker locker(&m_probeMutex);
+    m_probeTiers.insert(forestGuid, tier);
+}
+
+ProbeCancellationToken DomainControllerManager::cancellation()
+{
+    QMutexLocker locker(&m_probeMutex);
+    return m_cancellation;
+}
+
+/*
+ * Used on shutdown or before a config push, so nobody waits for hung probes.
+ * Probes started after this call are not affected.
+ */
+void DomainControllerManager::cancelPendingProbes()
+{
+    QMutexLocker locker(&m_probeMutex);
+    QLOG_SUPPORT() << "Cancelling pending domain controller probes";
+    m_cancellation.cancel();
+    m_cancellation = ProbeCancellationToken();
+}
+
+void DomainControllerManager::setReplicationStateReader(ReplicationStateFunction reader)
+{
+    QMutexLocker locker(&m_probeMutex);
+    m_replicationStateReader = reader;
+}
+
+void DomainControllerManager::setProbe(QSharedPointer<DomainControllerProbe> probe)
+{
+    QMutexLocker locker(&m_probeMutex);
+    m_probe = probe;
+}
+
+void DomainControllerManager::setParallelProbe(bool on, int deadlineMs, int primaryGraceMs)
+{
+    m_isParallelProbe = on;
+    m_probeDeadlineMs = deadlineMs;
+    m_primaryGraceMs = primaryGraceMs;
+}
+
 bool DomainControllerManager::saveForests(QVector<Forest> forests)
 {
     if (!m_isLoaded) {
@@ -144,7 +599,8 @@ bool DomainControllerManager::saveForests(QVector<Forest> forests)
         load();
     }
 
-    QLOG_SUPPORT() << "New forests (count" << forests.size() << ", old count" << m_forests.size() << ") to save";
+    ForestConfigurationSnapshotPtr current = snapshot();
+    QLOG_SUPPORT() << "New forests (count" << forests.size() << ", old count" << current->forests.size() << ") to save";
     bool ret = true;
 
     // qD Manager validates configuration so it should no be possible to have invalid one
@@ -160,11 +616,23 @@ bool DomainControllerManager::saveForests(QVector<Forest> forests)
     }
 
     QVector<ForestComparator::ForestWithChange> changes;
-    bool anyChange = ForestComparator::compare(m_forests, forests, &changes);
+    QVector<quint64> contentHashes;
+    bool anyChange = ForestDiff::compare(current->forests, current->contentHashes, forests, &changes, &contentHashes);
     if (anyChange) {
-        ret = updateDatabaseWithForestChanges(m_db, changes);
+        bool hasDeletedForests = false;
+        ForestConfigurationStamp stamp;
+        ret = updateDatabaseWithForestChanges(m_db, m_databaseWriter, changes, m_isIncrementalRescope, &hasDeletedForests, &stamp);
         if (ret) {
-            m_forests = forests;
+            invalidateSessions(changes);
+            // Content hashes do not cover DNS names, they stay valid
+            fillLearnedDnsNames(&forests, databaseForCurrentThread(m_db));
+            publish(forests, contentHashes);
+            writeSnapshotFile(stamp, snapshot());
+            // A forest added back may still have a tombstone
+            loadPendingDeletions();
+            if (hasDeletedForests) {
+                m_deletionJob.start();
+            }
         }
     } else {
         QLOG_SUPPORT() << "There is no change in forest configuration to apply";
@@ -173,54 +641,332 @@ bool DomainControllerManager::saveForests(QVector<Forest> forests)
     return ret;
 }
 
+/*
+ * Sessions bound with old credentials would keep working until the server drops them,
+ * so they are closed as soon as the new credentials are committed
+ */
+void DomainControllerManager::invalidateSessions(const QVector<ForestComparator::ForestWithChange>& changes)
+{
+    if (!m_sessionPool) {
+        return;
+    }
+    foreach (const auto& fc, changes) {
+        if (hasChange(fc, ForestComparator::CredentialsChanged) || hasChange(fc, ForestComparator::Deleted)) {
+            m_sessionPool->invalidateForest(fc.forest.objectGuid);
+        }
+    }
+}
+
+void DomainControllerManager::setIncrementalRescope(bool on)
+{
+    m_isIncrementalRescope = on;
+}
+
+void DomainControllerManager::setDatabaseWriterEnabled(bool on)
+{
+    m_isDatabaseWriterEnabled = on;
+    if (!on) {
+        setDatabaseWriter(QSharedPointer<DatabaseWriter>());
+    } else if (!m_databaseWriter && m_db.isValid()) {
+        setDatabaseWriter(QSharedPointer<DatabaseWriter>(new DatabaseWriter(m_db)));
+    }
+}
+
+/*
+ * Previous writer is stopped after its queued writes are committed
+ */
+void DomainControllerManager::setDatabaseWriter(QSharedPointer<DatabaseWriter> writer)
+{
+    if (m_databaseWriter) {
+        m_databaseWriter->stop();
+    }
+    m_databaseWriter = writer;
+    if (m_databaseWriter) {
+        m_databaseWriter->start();
+    }
+    m_healthCache.setDatabaseWriter(m_databaseWriter);
+    m_deletionJob.setDatabaseWriter(m_databaseWriter);
+}
+
+bool DomainControllerManager::writeDatabase(const char *name, DatabaseWriter::Operation operation)
+{
+    if (m_databaseWriter) {
+        return m_databaseWriter->write(name, operation);
+    }
+    return DatabaseUtil::inTransaction(m_db, name, operation);
+}
+
+void DomainControllerManager::setSessionPool(QSharedPointer<DirectorySessionPool> pool)
+{
+    m_sessionPool = pool;
+}
+
+void DomainControllerManager::setDiscovery(QSharedPointer<DomainControllerDiscovery> discovery)
+{
+    QMutexLocker locker(&m_discoveredMutex);
+    m_discovery = discovery;
+    m_discoveredDomainControllers.clear();
+    if (!m_discovery) {
+        return;
+    }
+    foreach (const QString& domain, m_watchedDomains.values()) {
+        m_discovery->refresh(domain);
+    }
+}
+
+void DomainControllerManager::watchDomain(const QString& forestGuid, const QString& domain)
+{
+    QMutexLocker locker(&m_discoveredMutex);
+    m_watchedDomains.insert(forestGuid, domain);
+    if (m_discovery) {
+        m_discovery->refresh(domain);
+    }
+}
+
+QVector<DomainController> DomainControllerManager::discoveredDomainControllers(const QString& forestGuid) const
+{
+    QMutexLocker locker(&m_discoveredMutex);
+    return m_discoveredDomainControllers.value(forestGuid);
+}
+
+/*
+ * Hosts of the watched domain which are not configured become additional (not primary) domain
+ * controllers of the forest. The overlay is built from the current discovery list on every call,
+ * so hosts found by any refresh are used, also those found before the forest was configured.
+ * They are kept in memory only: saving them would make the next config push from the server
+ * delete them again, and the server remains the owner of forest configuration.
+ */
+int DomainControllerManager::appendDiscoveredDomainControllers(Forest *forest)
+{
+    QSharedPointer<DomainControllerDiscovery> discovery;
+    QString domain;
+    {
+        QMutexLocker locker(&m_discoveredMutex);
+        discovery = m_discovery;
+        domain = m_watchedDomains.value(forest->objectGuid);
+    }
+    if (!discovery || domain.isEmpty()) {
+        return 0;
+    }
+    // Never blocks, an expired list is refreshed in the background and used meanwhile
+    QVector<DiscoveredDomainController> found = discovery->domainControllers(domain);
+
+    QMutexLocker locker(&m_discoveredMutex);
+    const QVector<DomainController> previous = m_discoveredDomainControllers.value(forest->objectGuid);
+    QVector<DomainController> discovered;
+    foreach (const DiscoveredDomainController& discoveredDc, found) {
+        if (containsHost(forest->domainControllers, discoveredDc.host)) {
+            continue;
+        }
+        DomainController dc;
+        dc.host = discoveredDc.host;
+        dc.isPrimary = false;
+        foreach (const DomainController& previousDc, previous) {
+            if (previousDc.host.compare(dc.host, Qt::CaseInsensitive) == 0) {
+                dc.dnsName = previousDc.dnsName;
+                break;
+            }
+        }
+        if (!containsHost(previous, dc.host)) {
+            QLOG_SUPPORT() << "Using discovered domain controller" << dc.host << "for forest" << forest->objectGuid;
+        }
+        forest->domainControllers.append(dc);
+        discovered.append(dc);
+    }
+    if (discovered.isEmpty()) {
+        m_discoveredDomainControllers.remove(forest->objectGuid);
+    } else {
+        m_discoveredDomainControllers.insert(forest->objectGuid, discovered);
+    }
+    return discovered.size();
+}
+
+/*
+ * Returns false if the host is not a discovered DC of the forest
+ */
+bool DomainControllerManager::setDiscoveredServerName(const QString& forestGuid, const QString& host, const QString& dnsName)
+{
+    QMutexLocker locker(&m_discoveredMutex);
+    auto it = m_discoveredDomainControllers.find(forestGuid);
+    if (it == m_discoveredDomainControllers.end()) {
+        return false;
+    }
+    for (int i = 0; i < it.value().size(); ++i) {
+        DomainController& dc = it.value()[i];
+        if (dc.host.compare(host, Qt::CaseInsensitive) == 0) {
+            dc.dnsName = dnsName;
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * Discovered DCs which the configuration now has and those of removed forests are dropped
+ */
+void DomainControllerManager::pruneDiscoveredDomainControllers(const QVector<Forest>& forests)
+{
+    QMutexLocker locker(&m_discoveredMutex);
+    if (m_discoveredDomainControllers.isEmpty()) {
+        return;
+    }
+    QHash<QString, QVector<DomainController> > pruned;
+    foreach (const Forest& forest, forests) {
+        auto it = m_discoveredDomainControllers.constFind(forest.objectGuid);
+        if (it == m_discoveredDomainControllers.constEnd()) {
+            continue;
+        }
+        QVector<DomainController> discovered;
+        foreach (const DomainController& dc, it.value()) {
+            if (!containsHost(forest.domainControllers, dc.host)) {
+                discovered.append(dc);
+            }
+        }
+        if (!discovered.isEmpty()) {
+            pruned.insert(forest.objectGuid, discovered);
+        }
+    }
+    m_discoveredDomainControllers.swap(pruned);
+}
+
 QVector<Forest> DomainControllerManager::forests() const
 {
-    return m_forests;
+    return snapshot()->forests;
+}
+
+ForestConfigurationSnapshotPtr DomainControllerManager::snapshot() const
+{
+    return std::atomic_load(&m_snapshot);
+}
+
+ForestCursor DomainControllerManager::cursor()
+{
+    return ForestCursor(this, snapshot());
+}
+
+/*
+ * Readers holding the previous snapshot keep using it until they ask for a new one
+ */
+void DomainControllerManager::publish(const QVector<Forest>& forests, QVector<quint64> contentHashes)
+{
+    if (contentHashes.size() != forests.size()) {
+        contentHashes = ForestDiff::contentHashes(forests);
+    }
+
+    pruneDiscoveredDomainControllers(forests);
+
+    QMutexLocker locker(&m_publishMutex);
+    quint64 generation = std::atomic_load(&m_snapshot)->generation + 1;
+    std::atomic_store(&m_snapshot, ForestConfigurationSnapshotPtr(std::make_shared<ForestConfigurationSnapshot>(generation, forests, contentHashes)));
 }
 
 void DomainControllerManager::setDatabase(const QSqlDatabase& db)
 {
     m_db = db;
+    m_healthCache.setDatabase(db);
+    if (m_isDatabaseWriterEnabled) {
+        setDatabaseWriter(QSharedPointer<DatabaseWriter>(new DatabaseWriter(db)));
+    }
+    m_deletionJob.setDatabase(db);
+    // Default probe is bound to the database, recreate it on next use
+    QMutexLocker locker(&m_probeMutex);
+    if (m_probe && dynamic_cast<ActiveDirectoryApiProbe *>(m_probe.data())) {
+        m_probe.clear();
+    }
 }
 
 // Load forest configuration from database and cache it
 void DomainControllerManager::load()
 {
-    m_forests.clear();
+    // Only a database older than the current schema version is written to
+    if (!ForestSchemaMigration::isCurrent(m_db)) {
+        writeDatabase("migrate AD forest schema", ForestSchemaMigration::runWithoutTransaction);
+    }
 
-    QList<QString> forestGuids = ForestDomainControllerMembershipDao::selectForestGuids(m_db);
-    foreach (const QString& forestGuid, forestGuids) {
-        Forest forest = ForestDao::selectOneBy(ForestDao::ObjectGuidColumn, forestGuid, 0, m_db);
-        if (!forest.isEmpty()) {
-            forest.domainControllers = ForestDomainControllerMembershipDao::selectOfForest(forestGuid, m_db);
-
-            // Empty DC should not be possible, but just in case test for it
-            for (int i = 0; i < forest.domainControllers.size(); ) {
-                if (forest.domainControllers[i].host.trimmed().isEmpty()) {
-                    forest.domainControllers.removeAt(i);
-                    QLOG_FATAL() << "Empty DC found for forest" << forestGuid;
-                } else {
-                    ++i;
-                }
-            }
+    // Stamp is read before forests, so a change made meanwhile makes the snapshot file older, never newer
+    ForestConfigurationStamp stamp;
+    if (!writeDatabase("create AD forest stamp", ForestSnapshotFile::createStampIfNotExists) ||
+        !ForestSnapshotFile::readStamp(m_db, &stamp)) {
+        stamp = ForestConfigurationStamp();
+    }
 
-            forest.sortDomainControllersByPrimary();
-            m_forests.append(forest);
-        } else {
-            QLOG_ERROR() << "Cannot load forest with guid " << forestGuid << "from database but it has domain controllers";
-        }
+    ForestMetricsTimer metricsTimer;
+    QVector<Forest> forests;
+    QVector<quint64> contentHashes;
+    QString path = snapshotFilePath();
+    bool isFromSnapshot = !path.isEmpty() && ForestSnapshotFile::read(path, stamp, m_db, &forests, &contentHashes);
+    if (isFromSnapshot) {
+        publish(forests, contentHashes);
+    } else {
+        publish(loadForestsInBulk(m_db));
+        writeSnapshotFile(stamp, snapshot());
+    }
+    if (metricsTimer.isEnabled()) {
+        metricsTimer.observe(METRIC_CONFIG_LOAD_DURATION, ForestMetrics::label("source", isFromSnapshot ? "snapshot" : "database"));
     }
 
+    m_healthCache.load();
+    // Resume cleanup of forests deleted before restart
+    loadPendingDeletions();
+    m_deletionJob.start();
+
     m_isLoaded = true;
     QLOG_SUPPORT() << "Loaded forest configuration from database";
 }
 
 void DomainControllerManager::reset()
 {
-    m_forests.clear();
+    publish(QVector<Forest>());
     m_isLoaded = false;
 }
 
+void DomainControllerManager::setSnapshotFilePath(const QString& path)
+{
+    m_snapshotFilePath = path;
+    m_isSnapshotFilePathSet = true;
+}
+
+QString DomainControllerManager::snapshotFilePath() const
+{
+    if (m_isSnapshotFilePathSet) {
+        return m_snapshotFilePath;
+    }
+    QString databaseName = m_db.databaseName();
+    if (databaseName.isEmpty() || databaseName == ":memory:") {
+        return QString();
+    }
+    return databaseName + ".forests";
+}
+
+void DomainControllerManager::writeSnapshotFile(const ForestConfigurationStamp& stamp, const ForestConfigurationSnapshotPtr& snapshot)
+{
+    QString path = snapshotFilePath();
+    if (path.isEmpty() || !stamp.isValid()) {
+        return;
+    }
+    if (ForestSnapshotFile::write(path, stamp, snapshot->forests, snapshot->contentHashes)) {
+        QLOG_SUPPORT() << "Wrote forest configuration snapshot of" << snapshot->forests.size() << "forests, stamp" << stamp.counter;
+    }
+}
+
+ForestDeletionJob *DomainControllerManager::deletionJob()
+{
+    return &m_deletionJob;
+}
+
+bool DomainControllerManager::isDeletionPending(const QString& forestGuid) const
+{
+    QMutexLocker locker(&m_pendingDeletionMutex);
+    return m_pendingDeletionForestGuids.contains(forestGuid);
+}
+
+void DomainControllerManager::loadPendingDeletions()
+{
+    QStringList forestGuids = ForestDeletionJob::pendingForestGuids(databaseForCurrentThread(m_db));
+    QMutexLocker locker(&m_pendingDeletionMutex);
+    m_pendingDeletionForestGuids = QSet<QString>::fromList(forestGuids);
+}
+
 bool DomainControllerManager::deleteForestDatabaseTablesAndSyncContextWithoutTransaction(QSqlDatabase db)
 {
     bool ret = true;
@@ -2,37 +2,175 @@
 #define ACTIVEDIRECTORYDOMAINCONTROLLERMANAGER_H
 #include <QVector>
 #include <QSqlDatabase>
+#include <QSharedPointer>
+#include <QMutex>
+#include <QHash>
+#include <QSet>
 #include "qliqDirectAD.h"
 #include "qliqdirect/shared/ActiveDirectoryDataTypes.h"
+#include "DomainControllerHealthCache.h"
+#include "ForestDeletionJob.h"
+#include "ForestConfigurationSnapshot.h"
+#include "DomainControllerProbe.h"
+#include "DirectorySessionPool.h"
+#include "DomainControllerDiscovery.h"
+#include "DatabaseWriter.h"
+#include "ForestSnapshotFile.h"
+#include "SyncProgressLedger.h"
 
 namespace ActiveDirectory {
 
+class DomainControllerManager;
+
+/*
+ * Iterates forests of one configuration snapshot, so the iteration stays consistent
+ * even if the configuration is changed meanwhile
+ */
+class ForestCursor {
+public:
+    ForestCursor();
+    ForestCursor(DomainControllerManager *manager, const ForestConfigurationSnapshotPtr& snapshot);
+
+    bool next(Forest *outForest, DomainController *outActiveDomainController);
+    quint64 generation() const;
+    bool isValid() const;
+
+private:
+    DomainControllerManager *m_manager;
+    ForestConfigurationSnapshotPtr m_snapshot;
+    int m_index;
+};
+
 class DomainControllerManager {
 public:
     DomainControllerManager();
 
     bool nextForest(Forest *outForest, DomainController *outActiveDomainController);
     void resetIteration();
+    // Thread safe, used by ForestSyncScheduler to process forests concurrently
+    bool selectDomainController(Forest *forest, DomainController *outActiveDomainController);
 
     bool saveForests(QVector<Forest> forests);
     QVector<Forest> forests() const;
+    // Current configuration, safe to call from any thread, it never copies forests
+    ForestConfigurationSnapshotPtr snapshot() const;
+    ForestCursor cursor();
 
     // Methods from ForestConfigurationLoader
     void setDatabase(const QSqlDatabase& db);
     void load();
     void reset();
 
+    // Pluggable accessibility check, by default ActiveDirectoryApi is used
+    void setProbe(QSharedPointer<DomainControllerProbe> probe);
+    // Probe all DCs of a forest at once instead of one after another
+    // Deadline and grace window (of primary DC) apply only to parallel mode,
+    // one after another every check runs on the calling thread until the backend answers
+    void setParallelProbe(bool on, int deadlineMs = 30000, int primaryGraceMs = 2000);
+    // Cheap check done before/instead of the full one depending on forest tier, by default TCP connect to LDAP port
+    void setPingProbe(QSharedPointer<DomainControllerProbe> probe);
+    void setDefaultProbeTier(DomainControllerProbeTier tier);
+    void setProbeTier(const QString& forestGuid, DomainControllerProbeTier tier);
+    // Completes all probes in flight as cancelled, thread safe
+    void cancelPendingProbes();
+
+    // Reads invocationId, highestCommittedUSN and up-to-dateness vector of a DC, implemented by the sync engine
+    typedef std::function<bool (const Forest& forest, const DomainController& dc, DirectoryReplicationState *out)> ReplicationStateFunction;
+    // When set, state of every selected DC is recorded as a SyncProgressLedger observation, so a later
+    // failover to that DC can resume from it once our knowledge covers it. Costs one read per selection.
+    void setReplicationStateReader(ReplicationStateFunction reader);
+
+    // Sync group change rescopes the forest with ForestRescopeJob instead of a full sync.
+    // Sync engine must run the job for forests with a pending rescope.
+    void setIncrementalRescope(bool on);
+
+    // Writes go through a DatabaseWriter thread (default), probes only queue their writes and
+    // readers use WAL. When disabled everything is written synchronously on the calling thread.
+    void setDatabaseWriterEnabled(bool on);
+    void setDatabaseWriter(QSharedPointer<DatabaseWriter> writer);
+
+    // load() uses this file instead of the database queries when its stamp matches the database,
+    // it is rewritten after every load() from the database and successful saveForests().
+    // By default it is next to the database file, empty path disables it.
+    void setSnapshotFilePath(const QString& path);
+
+    // Pooled directory sessions of forests are closed when their credentials change or the forest is deleted.
+    // By default it is the process wide ADSI pool which the legacy ::DomainControllerManager uses as well.
+    void setSessionPool(QSharedPointer<DirectorySessionPool> pool);
+
+    // DCs found by discovery in the watched domain of a forest are tried as additional DCs of it.
+    // The cached discovery list is read on every DC selection, so it follows each refresh.
+    // They are kept apart from forest configuration (not saved, not in forests()/snapshot()).
+    void setDiscovery(QSharedPointer<DomainControllerDiscovery> discovery);
+    void watchDomain(const QString& forestGuid, const QString& domain);
+    // Discovered DCs used by the last selection of the forest
+    QVector<DomainController> discoveredDomainControllers(const QString& forestGuid) const;
+
+    // Background cleanup of users/groups of deleted forests, see progress() and finished() signals
+    ForestDeletionJob *deletionJob();
+    // Forest deleted and added again whose old data is still being deleted, it is not synced
+    // (skipped by nextForest()) until ForestDeletionJob finishes it
+    bool isDeletionPending(const QString& forestGuid) const;
+
     static bool deleteForestDatabaseTablesAndSyncContextWithoutTransaction(QSqlDatabase db);
 
 private:
+    bool selectDomainControllerOf(Forest *forest, DomainController *outActiveDomainController);
+    int appendDiscoveredDomainControllers(Forest *forest);
+    void loadPendingDeletions();
+    bool setDiscoveredServerName(const QString& forestGuid, const QString& host, const QString& dnsName);
+    void pruneDiscoveredDomainControllers(const QVector<Forest>& forests);
     bool isServerAccessible(DomainController *dc, const Forest& config);
+    int findAccessibleInParallel(Forest *forest, const QVector<int>& order);
+    void recordProbeResult(const QString& host, bool isAccessible, qint64 latencyMs);
+    void recordReplicationState(const Forest& forest, const DomainController& dc);
+    void updateServerName(DomainController *dc, const QString& dnsName, const Forest& config);
+    QSharedPointer<DomainControllerProbe> probe();
+    QSharedPointer<DomainControllerProbe> probeFor(const Forest& forest);
+    ProbeCancellationToken cancellation();
     void saveForest(const QVariant& item);
+    QString snapshotFilePath() const;
+    void writeSnapshotFile(const ForestConfigurationStamp& stamp, const ForestConfigurationSnapshotPtr& snapshot);
+    void invalidateSessions(const QVector<ForestComparator::ForestWithChange>& changes);
+    // Through the DatabaseWriter if there is one, otherwise in a transaction of m_db
+    bool writeDatabase(const char *name, DatabaseWriter::Operation operation);
+    // 'contentHashes' are computed if not given
+    void publish(const QVector<Forest>& forests, QVector<quint64> contentHashes = QVector<quint64>());
 
 private:
-    int m_forestIndex;
+    ForestCursor m_cursor;
     QSqlDatabase m_db;
     bool m_isLoaded;
-    QVector<Forest> m_forests;
+    // Accessed only with std::atomic_load/atomic_store
+    ForestConfigurationSnapshotPtr m_snapshot;
+    QMutex m_publishMutex;
+    QMutex m_probeMutex;
+    QSharedPointer<DomainControllerProbe> m_probe;
+    QSharedPointer<DomainControllerProbe> m_pingProbe;
+    DomainControllerProbeTier m_defaultProbeTier;
+    QHash<QString, DomainControllerProbeTier> m_probeTiers;
+    ReplicationStateFunction m_replicationStateReader;
+    bool m_isIncrementalRescope;
+    bool m_isDatabaseWriterEnabled;
+    QSharedPointer<DatabaseWriter> m_databaseWriter;
+    QString m_snapshotFilePath;
+    bool m_isSnapshotFilePathSet;
+    ProbeCancellationToken m_cancellation;
+    DomainControllerHealthCache m_healthCache;
+    ForestDeletionJob m_deletionJob;
+    mutable QMutex m_pendingDeletionMutex;
+    QSet<QString> m_pendingDeletionForestGuids;
+    QSharedPointer<DirectorySessionPool> m_sessionPool;
+    // Guards m_discovery, m_watchedDomains and m_discoveredDomainControllers
+    mutable QMutex m_discoveredMutex;
+    QSharedPointer<DomainControllerDiscovery> m_discovery;
+    // forest guid -> discovered DCs which are not in its configuration, with DNS names learned by probes
+    QHash<QString, QVector<DomainController> > m_discoveredDomainControllers;
+    // forest guid -> domain
+    QHash<QString, QString> m_watchedDomains;
+    bool m_isParallelProbe;
+    int m_probeDeadlineMs;
+    int m_primaryGraceMs;
 };
 
 } // namespace ActiveDirectory
@@ -0,0 +1,127 @@
+#include "AdsiDirectorySession.h"
+#include <QString>
+#include <QsLog.h>
+#include <iads.h>
+#include <wtypes.h>
+#include <activeds.h>
+#include <objbase.h>
+#include <windows.h>
+
+namespace ActiveDirectory {
+
+namespace {
+
+inline const WCHAR *q2cwstr(const QString& str)
+{
+    return reinterpret_cast<const WCHAR *>(str.utf16());
+}
+
+} // namespace
+
+AdsiDirectorySession::AdsiDirectorySession(IADs *object) :
+    m_object(object)
+{
+}
+
+AdsiDirectorySession::~AdsiDirectorySession()
+{
+    if (m_object) {
+        m_object->Release();
+    }
+}
+
+IADs *AdsiDirectorySession::object() const
+{
+    Q_ASSERT(AdsiDirectorySessionBackend::isMultithreadedApartment());
+    return m_object;
+}
+
+/*
+ * GetInfo() reloads the object attributes from the server, it fails if the connection
+ * was dropped or the credentials are no longer valid
+ */
+bool AdsiDirectorySession::isHealthy()
+{
+    return m_object && SUCCEEDED(m_object->GetInfo());
+}
+
+QSharedPointer<DirectorySession> AdsiDirectorySessionBackend::open(const DirectorySessionKey& key, QString *errorMsg)
+{
+    // Object opened in a single threaded apartment must not be called from other threads
+    if (!isMultithreadedApartment()) {
+        *errorMsg = "Directory sessions can be opened only by a thread in the multithreaded apartment "
+                    "(CoInitializeEx(COINIT_MULTITHREADED))";
+        return QSharedPointer<DirectorySession>();
+    }
+
+    IADs *pADs = bind(key, errorMsg);
+    if (!pADs) {
+        return QSharedPointer<DirectorySession>();
+    }
+    return QSharedPointer<DirectorySession>(new AdsiDirectorySession(pADs));
+}
+
+IADs *AdsiDirectorySessionBackend::bind(const DirectorySessionKey& key, QString *errorMsg)
+{
+    IADsOpenDSObject *pDSO = NULL;
+    HRESULT hr = ADsGetObject(L"LDAP:", IID_IADsOpenDSObject, (void**) &pDSO);
+    if (FAILED(hr)) {
+        *errorMsg = QString("ADsGetObject failed, hr: 0x%1").arg(static_cast<ulong>(hr), 8, 16, QChar('0'));
+        return NULL;
+    }
+
+    const QString path = adsPath(key);
+    IDispatch *pDisp = NULL;
+    hr = pDSO->OpenDSObject(const_cast<WCHAR *>(q2cwstr(path)),
+                            const_cast<WCHAR *>(q2cwstr(key.userName)),
+                            const_cast<WCHAR *>(q2cwstr(key.password)),
+                            ADS_SECURE_AUTHENTICATION | (key.host.isEmpty() ? 0 : ADS_SERVER_BIND),
+                            &pDisp);
+    pDSO->Release();
+    if (FAILED(hr)) {
+        *errorMsg = QString("OpenDSObject of %1 failed, hr: 0x%2").arg(path).arg(static_cast<ulong>(hr), 8, 16, QChar('0'));
+        return NULL;
+    }
+
+    IADs *pADs = NULL;
+    hr = pDisp->QueryInterface(IID_IADs, (void**) &pADs);
+    pDisp->Release();
+    if (FAILED(hr)) {
+        *errorMsg = QString("QueryInterface(IADs) failed, hr: 0x%1").arg(static_cast<ulong>(hr), 8, 16, QChar('0'));
+        return NULL;
+    }
+
+    QLOG_SUPPORT() << "Opened directory session" << path << "as" << key.userName;
+    return pADs;
+}
+
+QSharedPointer<DirectorySessionPool> AdsiDirectorySessionBackend::sharedPool()
+{
+    static QSharedPointer<DirectorySessionPool> pool(
+                new DirectorySessionPool(QSharedPointer<DirectorySessionBackend>(new AdsiDirectorySessionBackend())));
+    return pool;
+}
+
+bool AdsiDirectorySessionBackend::isMultithreadedApartment()
+{
+    APTTYPE type;
+    APTTYPEQUALIFIER qualifier;
+    if (FAILED(CoGetApartmentType(&type, &qualifier))) {
+        // CO_E_NOTINITIALIZED, COM is not initialized on this thread
+        return false;
+    }
+    return type == APTTYPE_MTA || (type == APTTYPE_NA && qualifier == APTTYPEQUALIFIER_NA_ON_MTA);
+}
+
+QString AdsiDirectorySessionBackend::adsPath(const DirectorySessionKey& key)
+{
+    if (key.host.isEmpty()) {
+        return "LDAP://" + key.baseDn;
+    } else if (key.baseDn.isEmpty()) {
+        return "LDAP://" + key.host;
+    } else {
+        return "LDAP://" + key.host + "/" + key.baseDn;
+    }
+}
+
+} // namespace ActiveDirectory
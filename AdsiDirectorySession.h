@@ -0,0 +1,46 @@
+#ifndef ADSIDIRECTORYSESSION_H
+#define ADSIDIRECTORYSESSION_H
+#include "DirectorySessionPool.h"
+
+struct IADs;
+
+namespace ActiveDirectory {
+
+/*
+ * Object bound with IADsOpenDSObject::OpenDSObject(). ADSI reuses the underlying LDAP
+ * connection while the object is alive, releasing it closes the connection.
+ * The pooled object is shared between threads, so they must be in the multithreaded apartment,
+ * open() fails on a thread which is not. Such threads (GUI) use bind() instead.
+ */
+class AdsiDirectorySession : public DirectorySession {
+public:
+    explicit AdsiDirectorySession(IADs *object);
+    ~AdsiDirectorySession();
+
+    IADs *object() const;
+    bool isHealthy() override;
+
+private:
+    AdsiDirectorySession(const AdsiDirectorySession&) = delete;
+    AdsiDirectorySession& operator=(const AdsiDirectorySession&) = delete;
+
+    IADs *m_object;
+};
+
+class AdsiDirectorySessionBackend : public DirectorySessionBackend {
+public:
+    QSharedPointer<DirectorySession> open(const DirectorySessionKey& key, QString *errorMsg) override;
+
+    // Binds without pooling, on any apartment. The object lives in the apartment of the calling
+    // thread, the caller releases it on that thread. Returns null on failure.
+    static IADs *bind(const DirectorySessionKey& key, QString *errorMsg);
+    // LDAP://host/baseDn, LDAP://host or LDAP://baseDn
+    static QString adsPath(const DirectorySessionKey& key);
+    // Process wide pool of ADSI sessions, both DC managers use it unless another pool is set
+    static QSharedPointer<DirectorySessionPool> sharedPool();
+    static bool isMultithreadedApartment();
+};
+
+} // namespace ActiveDirectory
+
+#endif // ADSIDIRECTORYSESSION_H
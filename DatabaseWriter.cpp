@@ -0,0 +1,282 @@
+#include "DatabaseWriter.h"
+#include <QThread>
+#include <QMutexLocker>
+#include <QVector>
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QsLog.h>
+
+#define DEFAULT_MAX_BATCH_SIZE 256
+#define DEFAULT_COALESCE_INTERVAL_MS 5
+#define BUSY_TIMEOUT_MS 10000
+
+namespace ActiveDirectory {
+
+////////////////////////////////////////////////////////////////////////////////
+// DatabaseWriteFuture
+
+struct DatabaseWriteFuture::State {
+    mutable QMutex mutex;
+    QWaitCondition finished;
+    bool isFinished;
+    bool isCommitted;
+
+    State() : isFinished(false), isCommitted(false) {}
+};
+
+DatabaseWriteFuture::DatabaseWriteFuture()
+{
+}
+
+bool DatabaseWriteFuture::isValid() const
+{
+    return !m_state.isNull();
+}
+
+bool DatabaseWriteFuture::isFinished() const
+{
+    if (!m_state) {
+        return true;
+    }
+    QMutexLocker locker(&m_state->mutex);
+    return m_state->isFinished;
+}
+
+bool DatabaseWriteFuture::waitForFinished(QDeadlineTimer until) const
+{
+    if (!m_state) {
+        return true;
+    }
+    QMutexLocker locker(&m_state->mutex);
+    while (!m_state->isFinished) {
+        if (!m_state->finished.wait(&m_state->mutex, until)) {
+            return m_state->isFinished;
+        }
+    }
+    return true;
+}
+
+bool DatabaseWriteFuture::result() const
+{
+    if (!m_state) {
+        return false;
+    }
+    waitForFinished();
+    QMutexLocker locker(&m_state->mutex);
+    return m_state->isCommitted;
+}
+
+void DatabaseWriteFuture::finish(bool isCommitted) const
+{
+    QMutexLocker locker(&m_state->mutex);
+    m_state->isFinished = true;
+    m_state->isCommitted = isCommitted;
+    m_state->finished.wakeAll();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// DatabaseWriter
+
+DatabaseWriter::DatabaseWriter(const QSqlDatabase& db) :
+    m_db(db),
+    m_connectionName(db.connectionName() + "-writer"),
+    m_thread(nullptr),
+    m_isStopping(false),
+    m_maxBatchSize(DEFAULT_MAX_BATCH_SIZE),
+    m_coalesceIntervalMs(DEFAULT_COALESCE_INTERVAL_MS)
+{
+}
+
+DatabaseWriter::~DatabaseWriter()
+{
+    stop();
+}
+
+void DatabaseWriter::setMaxBatchSize(int operations)
+{
+    QMutexLocker locker(&m_mutex);
+    m_maxBatchSize = qMax(1, operations);
+}
+
+void DatabaseWriter::setCoalesceInterval(int ms)
+{
+    QMutexLocker locker(&m_mutex);
+    m_coalesceIntervalMs = qMax(0, ms);
+}
+
+void DatabaseWriter::start()
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_thread) {
+        return;
+    }
+    m_isStopping = false;
+    m_thread = QThread::create([this]() { run(); });
+    m_thread->setObjectName("DatabaseWriter");
+    m_thread->start();
+}
+
+void DatabaseWriter::stop()
+{
+    QThread *thread = nullptr;
+    {
+        QMutexLocker locker(&m_mutex);
+        m_isStopping = true;
+        m_queueChanged.wakeAll();
+        thread = m_thread;
+        m_thread = nullptr;
+    }
+    if (thread) {
+        thread->wait();
+        delete thread;
+    }
+
+    // Queued before start() and never run
+    QMutexLocker locker(&m_mutex);
+    while (!m_queue.isEmpty()) {
+        m_queue.dequeue().future.finish(false);
+    }
+}
+
+bool DatabaseWriter::isRunning() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_thread && !m_isStopping;
+}
+
+/*
+ * Operations queued before start() run once the writer is started
+ */
+DatabaseWriteFuture DatabaseWriter::submit(const QString& name, Operation operation)
+{
+    return enqueue(name, operation, false);
+}
+
+bool DatabaseWriter::write(const QString& name, Operation operation)
+{
+    return enqueue(name, operation, true).result();
+}
+
+bool DatabaseWriter::flush(QDeadlineTimer until)
+{
+    // Operations run in FIFO order, so everything queued earlier is finished before this one
+    return enqueue("flush", [](QSqlDatabase) { return true; }, true).waitForFinished(until);
+}
+
+DatabaseWriteFuture DatabaseWriter::enqueue(const QString& name, Operation operation, bool isWaited)
+{
+    PendingWrite write;
+    write.name = name;
+    write.operation = operation;
+    write.isWaited = isWaited;
+    write.future.m_state.reset(new DatabaseWriteFuture::State());
+
+    QMutexLocker locker(&m_mutex);
+    if (m_isStopping) {
+        QLOG_ERROR() << "Database writer is stopped, cannot write" << name;
+        write.future.finish(false);
+        return write.future;
+    }
+    m_queue.enqueue(write);
+    m_queueChanged.wakeAll();
+    return write.future;
+}
+
+void DatabaseWriter::run()
+{
+    {
+        QSqlDatabase db = openConnection();
+        forever {
+            QVector<PendingWrite> batch;
+            {
+                QMutexLocker locker(&m_mutex);
+                while (m_queue.isEmpty() && !m_isStopping) {
+                    m_queueChanged.wait(&m_mutex);
+                }
+                if (m_queue.isEmpty()) {
+                    break;
+                }
+
+                // Give other writers a moment to join this transaction, unless the only
+                // queued write has a caller blocked on it
+                bool isWaitedAlone = m_queue.size() == 1 && m_queue.head().isWaited;
+                QDeadlineTimer coalesceDeadline(isWaitedAlone ? 0 : m_coalesceIntervalMs);
+                while (m_queue.size() < m_maxBatchSize && !m_isStopping && !coalesceDeadline.hasExpired()) {
+                    m_queueChanged.wait(&m_mutex, coalesceDeadline);
+                }
+                while (!m_queue.isEmpty() && batch.size() < m_maxBatchSize) {
+                    batch.append(m_queue.dequeue());
+                }
+            }
+
+            QVector<bool> results;
+            writeBatch(db, batch, &results);
+            for (int i = 0; i < batch.size(); ++i) {
+                batch[i].future.finish(results[i]);
+            }
+        }
+        db.close();
+    }
+    QSqlDatabase::removeDatabase(m_connectionName);
+}
+
+QSqlDatabase DatabaseWriter::openConnection()
+{
+    // Cloned by name, the QSqlDatabase overload would read m_db's driver from this thread
+    QSqlDatabase db = QSqlDatabase::cloneDatabase(m_db.connectionName(), m_connectionName);
+    if (!db.open()) {
+        QLOG_ERROR() << "Cannot open database writer connection:" << db.lastError().text();
+        return db;
+    }
+
+    if (db.driverName().startsWith("QSQLITE")) {
+        // WAL is persistent, every connection to the file uses it from now on
+        QSqlQuery query(db);
+        if (!query.exec("PRAGMA journal_mode=WAL")) {
+            QLOG_ERROR() << "Cannot switch database to WAL mode:" << query.lastError().text();
+        }
+        query.exec("PRAGMA synchronous=NORMAL");
+        query.exec("PRAGMA busy_timeout=" + QString::number(BUSY_TIMEOUT_MS));
+    }
+    return db;
+}
+
+/*
+ * Runs the batch in one transaction, every operation in its own savepoint.
+ * 'outResults' tells which operations are committed.
+ */
+bool DatabaseWriter::writeBatch(QSqlDatabase db, const QVector<PendingWrite>& batch, QVector<bool> *outResults)
+{
+    outResults->fill(false, batch.size());
+
+    QSqlQuery query(db);
+    if (!query.exec("BEGIN IMMEDIATE")) {
+        QLOG_ERROR() << "Cannot begin transaction of" << batch.size() << "writes:" << query.lastError().text();
+        return false;
+    }
+
+    for (int i = 0; i < batch.size(); ++i) {
+        const PendingWrite& write = batch[i];
+        if (!query.exec("SAVEPOINT pending_write")) {
+            QLOG_ERROR() << "Cannot create savepoint for" << write.name << query.lastError().text();
+            continue;
+        }
+        if (write.operation(db)) {
+            (*outResults)[i] = query.exec("RELEASE pending_write");
+        } else {
+            QLOG_ERROR() << "Database write" << write.name << "failed, rolling it back";
+            query.exec("ROLLBACK TO pending_write");
+            query.exec("RELEASE pending_write");
+        }
+    }
+
+    if (!query.exec("COMMIT")) {
+        QLOG_ERROR() << "Cannot commit transaction of" << batch.size() << "writes:" << query.lastError().text();
+        query.exec("ROLLBACK");
+        outResults->fill(false);
+        return false;
+    }
+    return true;
+}
+
+} // namespace ActiveDirectory
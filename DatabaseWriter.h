@@ -0,0 +1,100 @@
+#ifndef DATABASEWRITER_H
+#define DATABASEWRITER_H
+#include <functional>
+#include <QString>
+#include <QQueue>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QSharedPointer>
+#include <QSqlDatabase>
+#include <QDeadlineTimer>
+
+class QThread;
+
+namespace ActiveDirectory {
+
+/*
+ * Handle of a write queued to DatabaseWriter. The write is finished when the transaction
+ * it was grouped into is committed (result() is true) or it is rolled back.
+ */
+class DatabaseWriteFuture {
+public:
+    DatabaseWriteFuture();
+
+    bool isValid() const;
+    bool isFinished() const;
+    // Returns false if 'until' expired before the write finished
+    bool waitForFinished(QDeadlineTimer until = QDeadlineTimer(QDeadlineTimer::Forever)) const;
+    // Waits for the write to finish, true if it is committed
+    bool result() const;
+
+private:
+    friend class DatabaseWriter;
+    struct State;
+
+    void finish(bool isCommitted) const;
+
+    QSharedPointer<State> m_state;
+};
+
+/*
+ * Single writer of the database. One thread owns the write connection and runs queued
+ * operations in FIFO order, grouping the ones queued meanwhile into one transaction
+ * (each of them in its own savepoint, so a failing operation rolls back only itself).
+ * Database is switched to WAL mode, so readers on other connections (ThreadDatabase clones)
+ * neither wait for nor block the writer.
+ * Operations must not open transactions themselves.
+ */
+class DatabaseWriter {
+public:
+    typedef std::function<bool (QSqlDatabase db)> Operation;
+
+    // 'db' is cloned for the writer thread
+    explicit DatabaseWriter(const QSqlDatabase& db);
+    ~DatabaseWriter();
+
+    // Max operations grouped into one transaction
+    void setMaxBatchSize(int operations);
+    // How long the writer waits for more operations before it starts a transaction
+    void setCoalesceInterval(int ms);
+
+    void start();
+    // Writes queued before the call are finished, later ones fail
+    void stop();
+    bool isRunning() const;
+
+    // Thread safe
+    DatabaseWriteFuture submit(const QString& name, Operation operation);
+    // Submits and waits for the result. Alone in the queue it starts at once,
+    // without the coalesce interval.
+    bool write(const QString& name, Operation operation);
+    // Waits until all operations queued before the call are finished
+    bool flush(QDeadlineTimer until = QDeadlineTimer(QDeadlineTimer::Forever));
+
+private:
+    struct PendingWrite {
+        QString name;
+        Operation operation;
+        DatabaseWriteFuture future;
+        bool isWaited;
+    };
+
+    DatabaseWriteFuture enqueue(const QString& name, Operation operation, bool isWaited);
+    void run();
+    QSqlDatabase openConnection();
+    bool writeBatch(QSqlDatabase db, const QVector<PendingWrite>& batch, QVector<bool> *outResults);
+
+    QSqlDatabase m_db;
+    QString m_connectionName;
+    QThread *m_thread;
+    mutable QMutex m_mutex;
+    QWaitCondition m_queueChanged;
+    QQueue<PendingWrite> m_queue;
+    bool m_isStopping;
+    int m_maxBatchSize;
+    int m_coalesceIntervalMs;
+};
+
+} // namespace ActiveDirectory
+
+#endif // DATABASEWRITER_H
@@ -0,0 +1,327 @@
+#include "DirectorySessionPool.h"
+#include <QDeadlineTimer>
+#include <QsLog.h>
+
+#define DEFAULT_MAX_SIZE 32
+#define DEFAULT_IDLE_TIMEOUT_MS (5 * 60 * 1000)
+#define DEFAULT_ACQUIRE_TIMEOUT_MS (60 * 1000)
+#define DEFAULT_HEALTH_CHECK_INTERVAL_MS (30 * 1000)
+
+namespace ActiveDirectory {
+
+DirectorySessionKey::DirectorySessionKey(const QString& forestGuid, const QString& host, const QString& baseDn,
+                                         const QString& userName, const QString& password) :
+    forestGuid(forestGuid),
+    host(host),
+    baseDn(baseDn),
+    userName(userName),
+    password(password)
+{
+}
+
+bool DirectorySessionKey::operator==(const DirectorySessionKey& other) const
+{
+    return forestGuid == other.forestGuid &&
+           host.compare(other.host, Qt::CaseInsensitive) == 0 &&
+           baseDn.compare(other.baseDn, Qt::CaseInsensitive) == 0 &&
+           userName.compare(other.userName, Qt::CaseInsensitive) == 0 &&
+           password == other.password;
+}
+
+uint qHash(const DirectorySessionKey& key, uint seed)
+{
+    // Password is compared by operator== only
+    return ::qHash(key.forestGuid, seed) ^ ::qHash(key.host.toLower(), seed) ^ ::qHash(key.userName.toLower(), seed);
+}
+
+DirectorySessionPool::Lease::Lease() :
+    m_pool(nullptr),
+    m_generation(0),
+    m_isDiscarded(false)
+{
+}
+
+DirectorySessionPool::Lease::Lease(Lease&& other) :
+    m_pool(other.m_pool),
+    m_key(other.m_key),
+    m_session(other.m_session),
+    m_generation(other.m_generation),
+    m_isDiscarded(other.m_isDiscarded)
+{
+    other.m_pool = nullptr;
+    other.m_session.clear();
+}
+
+DirectorySessionPool::Lease& DirectorySessionPool::Lease::operator=(Lease&& other)
+{
+    if (this != &other) {
+        release();
+        m_pool = other.m_pool;
+        m_key = other.m_key;
+        m_session = other.m_session;
+        m_generation = other.m_generation;
+        m_isDiscarded = other.m_isDiscarded;
+        other.m_pool = nullptr;
+        other.m_session.clear();
+    }
+    return *this;
+}
+
+DirectorySessionPool::Lease::~Lease()
+{
+    release();
+}
+
+bool DirectorySessionPool::Lease::isValid() const
+{
+    return !m_session.isNull();
+}
+
+QSharedPointer<DirectorySession> DirectorySessionPool::Lease::session() const
+{
+    return m_session;
+}
+
+void DirectorySessionPool::Lease::discard()
+{
+    m_isDiscarded = true;
+}
+
+void DirectorySessionPool::Lease::release()
+{
+    if (m_pool) {
+        m_pool->release(this);
+        m_pool = nullptr;
+    }
+    m_session.clear();
+}
+
+DirectorySessionPool::DirectorySessionPool(QSharedPointer<DirectorySessionBackend> backend) :
+    m_backend(backend),
+    m_maxSize(DEFAULT_MAX_SIZE),
+    m_idleTimeoutMs(DEFAULT_IDLE_TIMEOUT_MS),
+    m_acquireTimeoutMs(DEFAULT_ACQUIRE_TIMEOUT_MS),
+    m_healthCheckIntervalMs(DEFAULT_HEALTH_CHECK_INTERVAL_MS),
+    m_leasedCount(0),
+    m_generation(0)
+{
+}
+
+void DirectorySessionPool::setMaxSize(int sessions)
+{
+    QList<IdleSession> closed;
+    QMutexLocker locker(&m_mutex);
+    m_maxSize = qMax(1, sessions);
+    while (m_idle.size() + m_leasedCount > m_maxSize && evictOldestIdleLocked(&closed)) {
+    }
+    m_slotReleased.wakeAll();
+}
+
+void DirectorySessionPool::setIdleTimeout(int ms)
+{
+    QMutexLocker locker(&m_mutex);
+    m_idleTimeoutMs = qMax(0, ms);
+}
+
+void DirectorySessionPool::setAcquireTimeout(int ms)
+{
+    QMutexLocker locker(&m_mutex);
+    m_acquireTimeoutMs = qMax(0, ms);
+}
+
+void DirectorySessionPool::setHealthCheckInterval(int ms)
+{
+    QMutexLocker locker(&m_mutex);
+    m_healthCheckIntervalMs = qMax(0, ms);
+}
+
+DirectorySessionPool::Lease DirectorySessionPool::acquire(const DirectorySessionKey& key, QString *errorMsg)
+{
+    QSharedPointer<DirectorySession> session;
+    quint64 generation = 0;
+    QDeadlineTimer slotDeadline;
+    bool isSlotDeadlineSet = false;
+
+    while (true) {
+        IdleSession candidate;
+        int healthCheckIntervalMs = 0;
+        QList<IdleSession> closed;
+        {
+            QMutexLocker locker(&m_mutex);
+            evictIdleLocked(&closed);
+
+            // Most recently used first, it is the most likely to be still alive
+            int index = -1;
+            for (int i = m_idle.size() - 1; i >= 0; --i) {
+                if (m_idle[i].key == key) {
+                    index = i;
+                    break;
+                }
+            }
+            if (index == -1) {
+                while (m_idle.size() + m_leasedCount >= m_maxSize && evictOldestIdleLocked(&closed)) {
+                }
+                if (m_leasedCount >= m_maxSize) {
+                    // Every session is leased, wait for one to come back
+                    if (!isSlotDeadlineSet) {
+                        slotDeadline = QDeadlineTimer(m_acquireTimeoutMs);
+                        isSlotDeadlineSet = true;
+                    }
+                    if (slotDeadline.hasExpired() || !m_slotReleased.wait(&m_mutex, static_cast<unsigned long>(slotDeadline.remainingTime()))) {
+                        QString error = QString("All %1 directory sessions are in use").arg(m_maxSize);
+                        QLOG_ERROR() << "Cannot open directory session to" << key.host << "forest" << key.forestGuid << error;
+                        if (errorMsg) {
+                            *errorMsg = error;
+                        }
+                        return Lease();
+                    }
+                    continue;
+                }
+                // Reserve the slot before opening outside of the lock
+                m_leasedCount++;
+                generation = ++m_generation;
+                break;
+            }
+            candidate = m_idle.takeAt(index);
+            m_leasedCount++;
+            healthCheckIntervalMs = m_healthCheckIntervalMs;
+        }
+
+        // Health check outside of the lock, it can take a round trip
+        if (candidate.idleTimer.elapsed() < healthCheckIntervalMs || candidate.session->isHealthy()) {
+            Lease lease;
+            lease.m_pool = this;
+            lease.m_key = key;
+            lease.m_session = candidate.session;
+            lease.m_generation = candidate.generation;
+            return lease;
+        }
+
+        QLOG_WARN() << "Pooled directory session to" << key.host << "is not healthy, closing it";
+        candidate.session.clear();
+        releaseSlot();
+    }
+
+    QString error;
+    session = m_backend->open(key, &error);
+    if (!session) {
+        QLOG_ERROR() << "Cannot open directory session to" << key.host << "forest" << key.forestGuid << error;
+        if (errorMsg) {
+            *errorMsg = error;
+        }
+        releaseSlot();
+        return Lease();
+    }
+
+    Lease lease;
+    lease.m_pool = this;
+    lease.m_key = key;
+    lease.m_session = session;
+    lease.m_generation = generation;
+    return lease;
+}
+
+void DirectorySessionPool::release(Lease *lease)
+{
+    QSharedPointer<DirectorySession> closed;
+    QMutexLocker locker(&m_mutex);
+    m_leasedCount--;
+    m_slotReleased.wakeOne();
+
+    if (lease->m_isDiscarded || lease->m_generation <= generationLocked(lease->m_key) ||
+            m_idle.size() + m_leasedCount >= m_maxSize) {
+        // Destroyed (unbound) after the lock is released
+        closed = lease->m_session;
+        return;
+    }
+
+    IdleSession idle;
+    idle.key = lease->m_key;
+    idle.session = lease->m_session;
+    idle.generation = lease->m_generation;
+    idle.idleTimer.start();
+    m_idle.append(idle);
+}
+
+void DirectorySessionPool::releaseSlot()
+{
+    QMutexLocker locker(&m_mutex);
+    m_leasedCount--;
+    m_slotReleased.wakeOne();
+}
+
+void DirectorySessionPool::invalidateForest(const QString& forestGuid)
+{
+    QList<IdleSession> closed;
+    QMutexLocker locker(&m_mutex);
+    m_forestInvalidatedAt[forestGuid] = m_generation;
+    for (int i = m_idle.size() - 1; i >= 0; --i) {
+        if (m_idle[i].key.forestGuid == forestGuid) {
+            closed.append(m_idle.takeAt(i));
+        }
+    }
+    QLOG_SUPPORT() << "Invalidated" << closed.size() << "idle directory sessions of forest" << forestGuid;
+}
+
+void DirectorySessionPool::invalidateHost(const QString& host)
+{
+    QList<IdleSession> closed;
+    QMutexLocker locker(&m_mutex);
+    m_hostInvalidatedAt[host.toLower()] = m_generation;
+    for (int i = m_idle.size() - 1; i >= 0; --i) {
+        if (m_idle[i].key.host.compare(host, Qt::CaseInsensitive) == 0) {
+            closed.append(m_idle.takeAt(i));
+        }
+    }
+}
+
+void DirectorySessionPool::evictIdle()
+{
+    QList<IdleSession> closed;
+    QMutexLocker locker(&m_mutex);
+    evictIdleLocked(&closed);
+}
+
+void DirectorySessionPool::clear()
+{
+    QList<IdleSession> closed;
+    QMutexLocker locker(&m_mutex);
+    closed.swap(m_idle);
+}
+
+int DirectorySessionPool::size() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_idle.size() + m_leasedCount;
+}
+
+int DirectorySessionPool::idleCount() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_idle.size();
+}
+
+void DirectorySessionPool::evictIdleLocked(QList<IdleSession> *closed)
+{
+    // Oldest are at the front
+    while (!m_idle.isEmpty() && m_idle.first().idleTimer.elapsed() >= m_idleTimeoutMs) {
+        closed->append(m_idle.takeFirst());
+    }
+}
+
+bool DirectorySessionPool::evictOldestIdleLocked(QList<IdleSession> *closed)
+{
+    if (m_idle.isEmpty()) {
+        return false;
+    }
+    closed->append(m_idle.takeFirst());
+    return true;
+}
+
+quint64 DirectorySessionPool::generationLocked(const DirectorySessionKey& key) const
+{
+    return qMax(m_forestInvalidatedAt.value(key.forestGuid, 0),
+                m_hostInvalidatedAt.value(key.host.toLower(), 0));
+}
+
+} // namespace ActiveDirectory
@@ -0,0 +1,138 @@
+#ifndef DIRECTORYSESSIONPOOL_H
+#define DIRECTORYSESSIONPOOL_H
+#include <QString>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QElapsedTimer>
+#include <QSharedPointer>
+
+namespace ActiveDirectory {
+
+struct DirectorySessionKey {
+    QString forestGuid;
+    QString host;       // empty to let ADSI pick a DC of 'baseDn' domain
+    QString baseDn;
+    QString userName;
+    QString password;
+
+    DirectorySessionKey() {}
+    DirectorySessionKey(const QString& forestGuid, const QString& host, const QString& baseDn,
+                        const QString& userName, const QString& password);
+
+    bool operator==(const DirectorySessionKey& other) const;
+};
+
+uint qHash(const DirectorySessionKey& key, uint seed = 0);
+
+/*
+ * Bound and authenticated connection to a directory server
+ */
+class DirectorySession {
+public:
+    virtual ~DirectorySession() {}
+
+    // May do a round trip to the server
+    virtual bool isHealthy() = 0;
+};
+
+class DirectorySessionBackend {
+public:
+    virtual ~DirectorySessionBackend() {}
+
+    // Returns null on failure
+    virtual QSharedPointer<DirectorySession> open(const DirectorySessionKey& key, QString *errorMsg) = 0;
+};
+
+/*
+ * Keeps directory sessions bound per (forest, DC host, credentials), so every operation
+ * does not pay for a new bind and authentication. Idle sessions are evicted after idle timeout
+ * or when the pool is full, idle sessions are health checked before reuse. Max size is a hard
+ * limit: when every session is leased acquire() waits for a release up to the acquire timeout.
+ * Sessions are closed (unbound) outside of the pool lock.
+ * invalidateForest() drops sessions of a forest, i.e. when its credentials change; sessions
+ * leased at that moment are closed when returned. Thread safe. The pool must outlive its leases.
+ */
+class DirectorySessionPool {
+public:
+    class Lease {
+    public:
+        Lease();
+        Lease(Lease&& other);
+        Lease& operator=(Lease&& other);
+        ~Lease();
+
+        bool isValid() const;
+        QSharedPointer<DirectorySession> session() const;
+        template <typename T> T *as() const { return dynamic_cast<T *>(m_session.data()); }
+
+        // Session is broken, close it instead of returning to the pool
+        void discard();
+        void release();
+
+    private:
+        friend class DirectorySessionPool;
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+
+        DirectorySessionPool *m_pool;
+        DirectorySessionKey m_key;
+        QSharedPointer<DirectorySession> m_session;
+        quint64 m_generation;
+        bool m_isDiscarded;
+    };
+
+    explicit DirectorySessionPool(QSharedPointer<DirectorySessionBackend> backend);
+
+    void setMaxSize(int sessions);
+    void setIdleTimeout(int ms);
+    // How long acquire() waits for a free slot when every session is leased
+    void setAcquireTimeout(int ms);
+    // Idle sessions older than this are checked with isHealthy() before reuse
+    void setHealthCheckInterval(int ms);
+
+    Lease acquire(const DirectorySessionKey& key, QString *errorMsg = nullptr);
+
+    void invalidateForest(const QString& forestGuid);
+    void invalidateHost(const QString& host);
+    void evictIdle();
+    void clear();
+
+    int size() const;
+    int idleCount() const;
+
+private:
+    struct IdleSession {
+        DirectorySessionKey key;
+        QSharedPointer<DirectorySession> session;
+        quint64 generation;
+        QElapsedTimer idleTimer;
+    };
+
+    void release(Lease *lease);
+    void releaseSlot();
+    // Evicted sessions are moved to 'closed', so they are destroyed after the lock is released
+    void evictIdleLocked(QList<IdleSession> *closed);
+    bool evictOldestIdleLocked(QList<IdleSession> *closed);
+    quint64 generationLocked(const DirectorySessionKey& key) const;
+
+    QSharedPointer<DirectorySessionBackend> m_backend;
+    int m_maxSize;
+    int m_idleTimeoutMs;
+    int m_acquireTimeoutMs;
+    int m_healthCheckIntervalMs;
+
+    mutable QMutex m_mutex;
+    QWaitCondition m_slotReleased;
+    QList<IdleSession> m_idle;      // most recently used at the end
+    int m_leasedCount;
+    quint64 m_generation;
+    // Sessions created before invalidation of their forest/host are not reused
+    QHash<QString, quint64> m_forestInvalidatedAt;
+    QHash<QString, quint64> m_hostInvalidatedAt;
+};
+
+} // namespace ActiveDirectory
+
+#endif // DIRECTORYSESSIONPOOL_H
@@ -0,0 +1,171 @@
+#include "DomainControllerDiscovery.h"
+#include <QRunnable>
+#include <functional>
+#include <QSet>
+#include <QsLog.h>
+
+#define DEFAULT_TTL_SECONDS (15 * 60)
+#define DEFAULT_RETRY_INTERVAL_SECONDS 60
+
+namespace ActiveDirectory {
+
+namespace {
+
+class RefreshTask : public QRunnable {
+public:
+    explicit RefreshTask(std::function<void ()> function) :
+        m_function(function)
+    {
+    }
+
+    void run() override
+    {
+        m_function();
+    }
+
+private:
+    std::function<void ()> m_function;
+};
+
+} // namespace
+
+DomainControllerDiscovery::DomainControllerDiscovery(QSharedPointer<DomainControllerResolver> resolver, QObject *parent) :
+    QObject(parent),
+    m_resolver(resolver),
+    m_ttlSeconds(DEFAULT_TTL_SECONDS),
+    m_retryIntervalSeconds(DEFAULT_RETRY_INTERVAL_SECONDS)
+{
+    // Lookups of a few domains, more threads would only hammer DNS
+    m_threadPool.setMaxThreadCount(2);
+}
+
+DomainControllerDiscovery::~DomainControllerDiscovery()
+{
+    // Tasks use this object
+    m_threadPool.waitForDone();
+}
+
+void DomainControllerDiscovery::setTtl(int seconds)
+{
+    QMutexLocker locker(&m_mutex);
+    m_ttlSeconds = qMax(0, seconds);
+}
+
+void DomainControllerDiscovery::setRetryInterval(int seconds)
+{
+    QMutexLocker locker(&m_mutex);
+    m_retryIntervalSeconds = qMax(0, seconds);
+}
+
+QVector<DiscoveredDomainController> DomainControllerDiscovery::domainControllers(const QString& domain)
+{
+    QMutexLocker locker(&m_mutex);
+    auto it = m_entries.find(key(domain));
+    if (it == m_entries.end() || !it->expiresAt.isValid() || it->expiresAt <= QDateTime::currentDateTimeUtc()) {
+        startRefreshLocked(domain);
+        it = m_entries.find(key(domain));
+    }
+    return it->domainControllers;
+}
+
+QStringList DomainControllerDiscovery::hosts(const QString& domain)
+{
+    QStringList ret;
+    foreach (const DiscoveredDomainController& dc, domainControllers(domain)) {
+        ret.append(dc.host);
+    }
+    return ret;
+}
+
+bool DomainControllerDiscovery::isCached(const QString& domain) const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_entries.value(key(domain)).expiresAt.isValid();
+}
+
+void DomainControllerDiscovery::refresh(const QString& domain)
+{
+    QMutexLocker locker(&m_mutex);
+    startRefreshLocked(domain);
+}
+
+bool DomainControllerDiscovery::refreshNow(const QString& domain)
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        Entry& entry = m_entries[key(domain)];
+        if (entry.isRefreshing) {
+            locker.unlock();
+            // Join the background refresh instead of resolving twice
+            m_threadPool.waitForDone();
+            return isCached(domain);
+        }
+        entry.isRefreshing = true;
+    }
+    return doRefresh(domain);
+}
+
+void DomainControllerDiscovery::waitForRefreshes(int ms)
+{
+    m_threadPool.waitForDone(ms);
+}
+
+QString DomainControllerDiscovery::key(const QString& domain)
+{
+    return domain.toLower();
+}
+
+bool DomainControllerDiscovery::startRefreshLocked(const QString& domain)
+{
+    Entry& entry = m_entries[key(domain)];
+    if (entry.isRefreshing) {
+        return false;
+    }
+    entry.isRefreshing = true;
+    m_threadPool.start(new RefreshTask([this, domain]() {
+        doRefresh(domain);
+    }));
+    return true;
+}
+
+/*
+ * Called with isRefreshing set, clears it
+ */
+bool DomainControllerDiscovery::doRefresh(const QString& domain)
+{
+    QVector<DiscoveredDomainController> dcs;
+    QString errorMsg;
+    bool ok = m_resolver->resolve(domain, &dcs, &errorMsg);
+
+    QStringList addedHosts;
+    {
+        QMutexLocker locker(&m_mutex);
+        Entry& entry = m_entries[key(domain)];
+        entry.isRefreshing = false;
+        if (!ok) {
+            QLOG_ERROR() << "Cannot discover domain controllers of domain" << domain << errorMsg << "keeping" << entry.domainControllers.size() << "cached";
+            entry.expiresAt = QDateTime::currentDateTimeUtc().addSecs(m_retryIntervalSeconds);
+            return false;
+        }
+
+        QSet<QString> known;
+        foreach (const DiscoveredDomainController& dc, entry.domainControllers) {
+            known.insert(dc.host.toLower());
+        }
+        foreach (const DiscoveredDomainController& dc, dcs) {
+            if (!known.contains(dc.host.toLower())) {
+                addedHosts.append(dc.host);
+            }
+        }
+        entry.domainControllers = dcs;
+        entry.expiresAt = QDateTime::currentDateTimeUtc().addSecs(m_ttlSeconds);
+    }
+
+    QLOG_SUPPORT() << "Discovered" << dcs.size() << "domain controllers of domain" << domain << "new:" << addedHosts;
+    if (!addedHosts.isEmpty()) {
+        emit domainControllersChanged(domain, addedHosts);
+    }
+    return true;
+}
+
+} // namespace ActiveDirectory
@@ -0,0 +1,89 @@
+#ifndef DOMAINCONTROLLERDISCOVERY_H
+#define DOMAINCONTROLLERDISCOVERY_H
+#include <QObject>
+#include <QHash>
+#include <QVector>
+#include <QStringList>
+#include <QDateTime>
+#include <QMutex>
+#include <QThreadPool>
+#include <QSharedPointer>
+
+namespace ActiveDirectory {
+
+struct DiscoveredDomainController {
+    QString host;
+    bool isSiteLocal;   // in the site of this computer
+    bool isPdc;
+
+    DiscoveredDomainController(const QString& host = QString(), bool isSiteLocal = false, bool isPdc = false) :
+        host(host), isSiteLocal(isSiteLocal), isPdc(isPdc) {}
+};
+
+/*
+ * Looks up domain controllers of a domain. Called from a background thread.
+ */
+class DomainControllerResolver {
+public:
+    virtual ~DomainControllerResolver() {}
+
+    // 'out' is ordered site-local first
+    virtual bool resolve(const QString& domain, QVector<DiscoveredDomainController> *out, QString *errorMsg) = 0;
+};
+
+/*
+ * TTL cache of domain controllers per domain. Lookups return the cached list at once and
+ * start a background refresh when it is missing or expired, so a sync never waits for DNS.
+ * A failed refresh keeps the previous list. domainControllersChanged() is emitted (from the
+ * refreshing thread) when a refresh finds hosts which were not known before. It carries only
+ * the new hosts, a consumer which needs the whole list reads domainControllers() instead.
+ */
+class DomainControllerDiscovery : public QObject
+{
+    Q_OBJECT
+public:
+    explicit DomainControllerDiscovery(QSharedPointer<DomainControllerResolver> resolver, QObject *parent = nullptr);
+    ~DomainControllerDiscovery();
+
+    void setTtl(int seconds);
+    // Pause after a failed refresh
+    void setRetryInterval(int seconds);
+
+    // Site-local first, never blocks, empty until the first refresh finishes
+    QVector<DiscoveredDomainController> domainControllers(const QString& domain);
+    QStringList hosts(const QString& domain);
+    bool isCached(const QString& domain) const;
+
+    // Starts a background refresh unless one is running for the domain
+    void refresh(const QString& domain);
+    // Refreshes on the calling thread, use only where blocking is fine (startup, tools)
+    bool refreshNow(const QString& domain);
+    void waitForRefreshes(int ms = -1);
+
+signals:
+    void domainControllersChanged(const QString& domain, const QStringList& addedHosts);
+
+private:
+    struct Entry {
+        QVector<DiscoveredDomainController> domainControllers;
+        QDateTime expiresAt;
+        bool isRefreshing;
+
+        Entry() : isRefreshing(false) {}
+    };
+
+    static QString key(const QString& domain);
+    bool startRefreshLocked(const QString& domain);
+    bool doRefresh(const QString& domain);
+
+    QSharedPointer<DomainControllerResolver> m_resolver;
+    int m_ttlSeconds;
+    int m_retryIntervalSeconds;
+    mutable QMutex m_mutex;
+    QHash<QString, Entry> m_entries;
+    QThreadPool m_threadPool;
+};
+
+} // namespace ActiveDirectory
+
+#endif // DOMAINCONTROLLERDISCOVERY_H
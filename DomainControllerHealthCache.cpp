@@ -0,0 +1,312 @@
+#include "DomainControllerHealthCache.h"
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QVariant>
+#include <algorithm>
+#include <QsLog.h>
+#include "ThreadDatabase.h"
+#include "DatabaseWriter.h"
+
+#define HEALTH_TABLE "active_directory_dc_health"
+#define DEFAULT_TTL_SECONDS (24 * 60 * 60)
+#define BACKOFF_BASE_SECONDS 30
+#define BACKOFF_MAX_SECONDS (60 * 60)
+#define LATENCY_SMOOTHING 0.3
+
+namespace ActiveDirectory {
+
+DomainControllerHealth::DomainControllerHealth() :
+    isAccessible(false),
+    averageLatencyMs(0),
+    failureCount(0)
+{
+}
+
+bool DomainControllerHealth::isEmpty() const
+{
+    return host.isEmpty();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// DomainControllerHealthDao
+
+bool DomainControllerHealthDao::createTableIfNotExists(QSqlDatabase db)
+{
+    QSqlQuery query(db);
+    bool ret = query.exec("CREATE TABLE IF NOT EXISTS " HEALTH_TABLE " ("
+                          " host TEXT PRIMARY KEY,"
+                          " is_accessible INTEGER NOT NULL,"
+                          " average_latency_ms REAL NOT NULL,"
+                          " failure_count INTEGER NOT NULL,"
+                          " checked_at INTEGER NOT NULL,"
+                          " retry_after INTEGER NOT NULL)");
+    if (!ret) {
+        QLOG_ERROR() << "Cannot create table" << HEALTH_TABLE << query.lastError().text();
+    }
+    return ret;
+}
+
+bool DomainControllerHealthDao::insertOrReplace(const DomainControllerHealth& health, QSqlDatabase db)
+{
+    QSqlQuery query(db);
+    query.prepare("INSERT OR REPLACE INTO " HEALTH_TABLE
+                  " (host, is_accessible, average_latency_ms, failure_count, checked_at, retry_after)"
+                  " VALUES (:host, :is_accessible, :average_latency_ms, :failure_count, :checked_at, :retry_after)");
+    query.bindValue(":host", health.host);
+    query.bindValue(":is_accessible", health.isAccessible ? 1 : 0);
+    query.bindValue(":average_latency_ms", health.averageLatencyMs);
+    query.bindValue(":failure_count", health.failureCount);
+    query.bindValue(":checked_at", health.checkedAt.toMSecsSinceEpoch());
+    query.bindValue(":retry_after", health.retryAfter.isValid() ? health.retryAfter.toMSecsSinceEpoch() : 0);
+    bool ret = query.exec();
+    if (!ret) {
+        QLOG_ERROR() << "Cannot save health of domain controller" << health.host << query.lastError().text();
+    }
+    return ret;
+}
+
+QVector<DomainControllerHealth> DomainControllerHealthDao::selectAll(QSqlDatabase db)
+{
+    QVector<DomainControllerHealth> ret;
+    QSqlQuery query(db);
+    if (query.exec("SELECT host, is_accessible, average_latency_ms, failure_count, checked_at, retry_after FROM " HEALTH_TABLE)) {
+        while (query.next()) {
+            DomainControllerHealth health;
+            health.host = query.value(0).toString();
+            health.isAccessible = query.value(1).toInt() != 0;
+            health.averageLatencyMs = query.value(2).toDouble();
+            health.failureCount = query.value(3).toInt();
+            health.checkedAt = QDateTime::fromMSecsSinceEpoch(query.value(4).toLongLong());
+            qint64 retryAfter = query.value(5).toLongLong();
+            if (retryAfter > 0) {
+                health.retryAfter = QDateTime::fromMSecsSinceEpoch(retryAfter);
+            }
+            ret.append(health);
+        }
+    } else {
+        QLOG_ERROR() << "Cannot load domain controller health" << query.lastError().text();
+    }
+    return ret;
+}
+
+bool DomainControllerHealthDao::deleteOlderThan(const QDateTime& checkedAt, QSqlDatabase db)
+{
+    QSqlQuery query(db);
+    query.prepare("DELETE FROM " HEALTH_TABLE " WHERE checked_at < :checked_at");
+    query.bindValue(":checked_at", checkedAt.toMSecsSinceEpoch());
+    return query.exec();
+}
+
+bool DomainControllerHealthDao::deleteAll(QSqlDatabase db)
+{
+    QSqlQuery query(db);
+    return query.exec("DELETE FROM " HEALTH_TABLE);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// DomainControllerHealthCache
+
+DomainControllerHealthCache::DomainControllerHealthCache() :
+    m_ttlSeconds(DEFAULT_TTL_SECONDS)
+{
+}
+
+void DomainControllerHealthCache::setDatabase(const QSqlDatabase& db)
+{
+    QMutexLocker locker(&m_mutex);
+    m_db = db;
+}
+
+void DomainControllerHealthCache::setDatabaseWriter(QSharedPointer<DatabaseWriter> writer)
+{
+    QMutexLocker locker(&m_mutex);
+    m_databaseWriter = writer;
+}
+
+void DomainControllerHealthCache::setTtl(int seconds)
+{
+    QMutexLocker locker(&m_mutex);
+    m_ttlSeconds = seconds;
+}
+
+void DomainControllerHealthCache::load()
+{
+    QMutexLocker locker(&m_mutex);
+    m_health.clear();
+    const QDateTime expiredBefore = QDateTime::currentDateTimeUtc().addSecs(-m_ttlSeconds);
+    auto prepare = [expiredBefore](QSqlDatabase db) -> bool {
+        if (!DomainControllerHealthDao::createTableIfNotExists(db)) {
+            return false;
+        }
+        DomainControllerHealthDao::deleteOlderThan(expiredBefore, db);
+        return true;
+    };
+    // Writer operations do not take m_mutex, waiting for one here cannot deadlock
+    bool isPrepared = m_databaseWriter ? m_databaseWriter->write("prepare DC health", prepare) : prepare(m_db);
+    if (!isPrepared) {
+        return;
+    }
+
+    foreach (const DomainControllerHealth& health, DomainControllerHealthDao::selectAll(m_db)) {
+        m_health.insert(key(health.host), health);
+    }
+    QLOG_SUPPORT() << "Loaded health of" << m_health.size() << "domain controllers";
+}
+
+void DomainControllerHealthCache::clear()
+{
+    QMutexLocker locker(&m_mutex);
+    m_health.clear();
+}
+
+void DomainControllerHealthCache::recordSuccess(const QString& host, qint64 latencyMs)
+{
+    QMutexLocker locker(&m_mutex);
+    DomainControllerHealth health = healthLocked(host);
+    if (health.isEmpty() || !health.isAccessible) {
+        health.averageLatencyMs = latencyMs;
+    } else {
+        health.averageLatencyMs = LATENCY_SMOOTHING * latencyMs + (1 - LATENCY_SMOOTHING) * health.averageLatencyMs;
+    }
+    health.host = host;
+    health.isAccessible = true;
+    health.failureCount = 0;
+    health.checkedAt = QDateTime::currentDateTimeUtc();
+    health.retryAfter = QDateTime();
+    store(health, &locker);
+}
+
+void DomainControllerHealthCache::recordFailure(const QString& host)
+{
+    QMutexLocker locker(&m_mutex);
+    DomainControllerHealth health = healthLocked(host);
+    health.host = host;
+    health.isAccessible = false;
+    health.failureCount++;
+    health.checkedAt = QDateTime::currentDateTimeUtc();
+
+    // 30s, 60s, 120s ... up to 1h
+    qint64 backoff = BACKOFF_BASE_SECONDS;
+    for (int i = 1; i < health.failureCount && backoff < BACKOFF_MAX_SECONDS; ++i) {
+        backoff *= 2;
+    }
+    backoff = qMin<qint64>(backoff, BACKOFF_MAX_SECONDS);
+    health.retryAfter = health.checkedAt.addSecs(backoff);
+
+    QLOG_SUPPORT() << "Domain controller" << host << "failed" << health.failureCount << "time(s), next check after" << backoff << "s";
+    store(health, &locker);
+}
+
+DomainControllerHealth DomainControllerHealthCache::health(const QString& host) const
+{
+    QMutexLocker locker(&m_mutex);
+    return healthLocked(host);
+}
+
+bool DomainControllerHealthCache::isBackedOff(const QString& host) const
+{
+    QMutexLocker locker(&m_mutex);
+    return isBackedOffLocked(host);
+}
+
+DomainControllerHealth DomainControllerHealthCache::healthLocked(const QString& host) const
+{
+    DomainControllerHealth health = m_health.value(HostNameTable::find(host));
+    if (!health.isEmpty() && isExpired(health)) {
+        return DomainControllerHealth();
+    }
+    return health;
+}
+
+bool DomainControllerHealthCache::isBackedOffLocked(const QString& host) const
+{
+    DomainControllerHealth health = healthLocked(host);
+    return !health.isEmpty() && health.retryAfter.isValid() && health.retryAfter > QDateTime::currentDateTimeUtc();
+}
+
+QVector<int> DomainControllerHealthCache::rank(const Forest& forest, int *outBackedOffCount) const
+{
+    QMutexLocker locker(&m_mutex);
+    struct Candidate {
+        int index;
+        int group;      // 0 - primary, 1 - healthy, 2 - unknown, 3 - failing but not backed off, 4 - backed off
+        double latency;
+        QDateTime retryAfter;
+    };
+
+    QVector<Candidate> candidates;
+    for (int i = 0; i < forest.domainControllers.size(); ++i) {
+        const DomainController& dc = forest.domainControllers[i];
+        DomainControllerHealth health = healthLocked(dc.host);
+        Candidate c;
+        c.index = i;
+        c.latency = health.averageLatencyMs;
+        c.retryAfter = health.retryAfter;
+        if (isBackedOffLocked(dc.host)) {
+            QLOG_SUPPORT() << "Domain controller" << dc.host << "is in failure backoff, it is tried last";
+            c.group = 4;
+        } else if (dc.isPrimary) {
+            c.group = 0;
+        } else if (health.isEmpty()) {
+            c.group = 2;
+        } else {
+            c.group = health.isAccessible ? 1 : 3;
+        }
+        candidates.append(c);
+    }
+
+    std::stable_sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) {
+        if (a.group != b.group) {
+            return a.group < b.group;
+        }
+        if (a.group == 4) {
+            return a.retryAfter < b.retryAfter;
+        }
+        return a.group == 1 && a.latency < b.latency;
+    });
+
+    QVector<int> ret;
+    ret.reserve(candidates.size());
+    int backedOffCount = 0;
+    foreach (const Candidate& c, candidates) {
+        ret.append(c.index);
+        if (c.group == 4) {
+            backedOffCount++;
+        }
+    }
+    if (outBackedOffCount) {
+        *outBackedOffCount = backedOffCount;
+    }
+    return ret;
+}
+
+HostId DomainControllerHealthCache::key(const QString& host)
+{
+    return HostNameTable::intern(host);
+}
+
+bool DomainControllerHealthCache::isExpired(const DomainControllerHealth& health) const
+{
+    return health.checkedAt.secsTo(QDateTime::currentDateTimeUtc()) > m_ttlSeconds;
+}
+
+void DomainControllerHealthCache::store(const DomainControllerHealth& health, QMutexLocker *locker)
+{
+    m_health.insert(key(health.host), health);
+    if (m_databaseWriter) {
+        // Table is created by load(). Queued under the lock, so rows are written in record order.
+        m_databaseWriter->submit("store DC health", [health](QSqlDatabase db) -> bool {
+            return DomainControllerHealthDao::insertOrReplace(health, db);
+        });
+        return;
+    }
+
+    // Probe threads calling rank() and record*() must not wait for the disk
+    QSqlDatabase db = m_db;
+    locker->unlock();
+    if (db.isValid()) {
+        DomainControllerHealthDao::insertOrReplace(health, databaseForCurrentThread(db));
+    }
+}
+
+} // namespace ActiveDirectory
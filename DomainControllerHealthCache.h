@@ -0,0 +1,87 @@
+#ifndef DOMAINCONTROLLERHEALTHCACHE_H
+#define DOMAINCONTROLLERHEALTHCACHE_H
+#include <QHash>
+#include <QVector>
+#include <QDateTime>
+#include <QSqlDatabase>
+#include <QMutex>
+#include <QSharedPointer>
+#include "qliqdirect/shared/ActiveDirectoryDataTypes.h"
+#include "ObjectGuid.h"
+
+namespace ActiveDirectory {
+
+class DatabaseWriter;
+
+struct DomainControllerHealth {
+    QString host;
+    bool isAccessible;
+    double averageLatencyMs;    // moving average of successful probes
+    int failureCount;           // consecutive failures
+    QDateTime checkedAt;
+    QDateTime retryAfter;       // host is skipped until this time (backoff)
+
+    DomainControllerHealth();
+    bool isEmpty() const;
+};
+
+/*
+ * Persists DomainControllerHealth records in active_directory_dc_health table,
+ * it lives next to ForestDomainControllerMembershipDao and follows the same static API.
+ */
+class DomainControllerHealthDao {
+public:
+    static bool createTableIfNotExists(QSqlDatabase db);
+    static bool insertOrReplace(const DomainControllerHealth& health, QSqlDatabase db);
+    static QVector<DomainControllerHealth> selectAll(QSqlDatabase db);
+    static bool deleteOlderThan(const QDateTime& checkedAt, QSqlDatabase db);
+    static bool deleteAll(QSqlDatabase db);
+};
+
+/*
+ * Remembers results of DC accessibility checks between sync cycles (and restarts) so
+ * dead DCs are skipped with exponential backoff and the fastest healthy DC is tried first.
+ * Methods are thread safe, writes go through the DatabaseWriter if set, otherwise through
+ * a per-thread connection.
+ */
+class DomainControllerHealthCache {
+public:
+    DomainControllerHealthCache();
+
+    void setDatabase(const QSqlDatabase& db);
+    void setDatabaseWriter(QSharedPointer<DatabaseWriter> writer);
+    // Entries not refreshed within ttl are forgotten
+    void setTtl(int seconds);
+    void load();
+    void clear();
+
+    void recordSuccess(const QString& host, qint64 latencyMs);
+    void recordFailure(const QString& host);
+
+    DomainControllerHealth health(const QString& host) const;
+    bool isBackedOff(const QString& host) const;
+
+    // Returns indexes of all forest.domainControllers in the order they should be tried:
+    // primary first, then healthy by latency, then unknown, then failing, then backed off DCs
+    // by their retryAfter (so a forest whose DCs are all backed off is still tried).
+    // 'outBackedOffCount' (optional) receives number of backed off DCs at the end.
+    QVector<int> rank(const Forest& forest, int *outBackedOffCount = nullptr) const;
+
+private:
+    static HostId key(const QString& host);
+    bool isExpired(const DomainControllerHealth& health) const;
+    DomainControllerHealth healthLocked(const QString& host) const;
+    bool isBackedOffLocked(const QString& host) const;
+    // Unlocks 'locker' before a synchronous database write
+    void store(const DomainControllerHealth& health, QMutexLocker *locker);
+
+    mutable QMutex m_mutex;
+    QSqlDatabase m_db;
+    QSharedPointer<DatabaseWriter> m_databaseWriter;
+    int m_ttlSeconds;
+    QHash<HostId, DomainControllerHealth> m_health;
+};
+
+} // namespace ActiveDirectory
+
+#endif // DOMAINCONTROLLERHEALTHCACHE_H
@@ -1,137 +1,108 @@
 #include "DomainControllerManager.h"
 #include <QString>
 #include <QMessageBox>
-#include <QDebug>
+#include <QsLog.h>
 #include <iads.h>
 #include <wtypes.h>
 #include <Winsock2.h>
 #include <activeds.h>
-#include <dsgetdc.h>
 #include <ntdsapi.h>
 #include <windows.h>
-#include <Lm.h>
+#include "DirectorySessionPool.h"
+#include "AdsiDirectorySession.h"
+#include "DomainControllerDiscovery.h"
+#include "DsGetDcResolver.h"
 
+using namespace ActiveDirectory;
 
-DomainControllerManager::DomainControllerManager()
+DomainControllerManager::DomainControllerManager() :
+    m_sessionPool(AdsiDirectorySessionBackend::sharedPool()),
+    m_discovery(new DomainControllerDiscovery(QSharedPointer<DomainControllerResolver>(new DsGetDcResolver())))
 {
 }
 
-inline const WCHAR *q2cwstr(const QString& str)
+void DomainControllerManager::setSessionPool(QSharedPointer<DirectorySessionPool> pool)
 {
-    return reinterpret_cast<const WCHAR *>(str.utf16());
+    m_sessionPool = pool;
 }
 
-
-void DomainControllerManager::openDC()
+void DomainControllerManager::setDiscovery(QSharedPointer<DomainControllerDiscovery> discovery)
 {
-    IADsOpenDSObject *pDSO = NULL;
-    HRESULT hr = S_OK;
-
-    hr = ADsGetObject(L"LDAP:", IID_IADsOpenDSObject, (void**) &pDSO);
-    if (SUCCEEDED(hr))
-    {
-        IDispatch *pDisp;
-        hr = pDSO->OpenDSObject(OLESTR("LDAP://DC=qliqsoft2, DC=com"),
-                           OLESTR("D2User1@qliqsoft2.com"),
-                           OLESTR("ActiveDir1"),
-                           ADS_SECURE_AUTHENTICATION,
-                           &pDisp);
-        pDSO->Release();
-        if (SUCCEEDED(hr))
-        {
-            IADs *pADs;
-            hr = pDisp->QueryInterface(IID_IADs, (void**) &pADs);
-            pDisp->Release();
-            if (SUCCEEDED(hr))
-            {
-            // Perform an object manipulation here.
-                pADs->Release();
-            }
-        }
-    }
-
+    m_discovery = discovery;
 }
 
-void DomainControllerManager::openDCEnumeration()
-{
-    DWORD dwRet;
-    PDOMAIN_CONTROLLER_INFO pdcInfo;
+namespace {
 
-    LPCSTR server1 = "s132-148-245-214.secureserver.net";
-    LPCSTR server2 = "s132-148-241-147.secureserver.net";
-    LPCSTR domainName  = "qliqsoft.com";
-    LPCSTR domainName2 = "qliqsoft2.com";
-
-    //dwRet = DsGetDcName(computerName, domainName, NULL, NULL, 0, &pdcInfo);
-    dwRet = DsGetDcName(server2, domainName2, NULL, NULL, DS_PDC_REQUIRED, &pdcInfo);
-    if (NO_ERROR == dwRet) {
-        //LPSTR
-        QString domainNam2 = pdcInfo->DomainName;
-        int iii=0;
-    } else if (dwRet == ERROR_ACCESS_DENIED) {
-        int iii=0;
+/*
+ * OpenDSObject() may return a cached object without talking to the server, GetInfo() loads
+ * the attributes of the bound object, so it fails if the DC or the credentials do not work
+ */
+bool verifyBoundObject(IADs *pADs, const Forest& forest, const DomainController& dc)
+{
+    HRESULT hr = pADs->GetInfo();
+    if (FAILED(hr))
+    {
+        QLOG_ERROR() << "Cannot read" << dc.host << "of forest" << forest.objectGuid
+                     << "hr: 0x" + QString::number(static_cast<ulong>(hr), 16);
+        return false;
     }
+    BSTR path = NULL;
+    if (SUCCEEDED(pADs->get_ADsPath(&path)))
+    {
+        QLOG_SUPPORT() << "Opened" << QString::fromWCharArray(path) << "of forest" << forest.objectGuid;
+        SysFreeString(path);
+    }
+    return true;
+}
 
-    // Free the DOMAIN_CONTROLLER_INFO structure.
-    NetApiBufferFree(pdcInfo);
-
-    // Open the enumeration.
-    HANDLE hGetDc;
-    dwRet = DsGetDcOpen(domainName2,
-                        DS_NOTIFY_AFTER_SITE_RECORDS,
-                        NULL,
-                        NULL,
-                        NULL,
-                        0,
-                        &hGetDc);
+} // namespace
 
-    if (ERROR_SUCCESS == dwRet) {
-        LPTSTR pszDnsHostName;
+bool DomainControllerManager::openDC(const Forest& forest, const DomainController& dc)
+{
+    DirectorySessionKey key(forest.objectGuid, dc.host, QString(), forest.userName, forest.password);
+    QString errorMsg;
 
-        /*
-        Enumerate each domain controller
-        */
-        while(TRUE)
+    // Pooled objects are shared with worker threads, which a single threaded apartment (GUI thread)
+    // cannot call into: bind just for this call, the object is released in this apartment
+    if (!AdsiDirectorySessionBackend::isMultithreadedApartment())
+    {
+        IADs *pADs = AdsiDirectorySessionBackend::bind(key, &errorMsg);
+        if (!pADs)
         {
-            ULONG ulSocketCount;
-            LPSOCKET_ADDRESS rgSocketAddresses;
-
-            dwRet = DsGetDcNext(
-                hGetDc,
-                &ulSocketCount,
-                &rgSocketAddresses,
-                &pszDnsHostName);
-
-            if (ERROR_SUCCESS == dwRet) {
-                qDebug() << "pszDnsHostName: "<<pszDnsHostName;
-
-                // Free the allocated string.
-                NetApiBufferFree(pszDnsHostName);
-
-                // Free the socket address array.
-                LocalFree(rgSocketAddresses);
-            }
-            else if (ERROR_NO_MORE_ITEMS == dwRet) {
-                qDebug() << "The end of the list has been reached.";
-                break;
-            } else if (ERROR_FILEMARK_DETECTED == dwRet) {
-                /*
-                DS_NOTIFY_AFTER_SITE_RECORDS was specified in
-                DsGetDcOpen and the end of the site-specific
-                records was reached.
-                */
-                qDebug() << "End of site-specific domain controllers\n";
-                continue;
-            } else {
-                // Some other error occurred.
-                break;
-            }
+            QLOG_ERROR() << "Cannot bind to" << dc.host << "of forest" << forest.objectGuid << errorMsg;
+            return false;
         }
-
-        // Close the enumeration.
-        DsGetDcCloseW(hGetDc);
+        bool ret = verifyBoundObject(pADs, forest, dc);
+        pADs->Release();
+        return ret;
     }
 
-    int iiii=0;
+    // Bound object is taken from the pool, it is returned (not released) when the lease goes out of scope.
+    // Keyed by forest, so invalidateForest() on a credentials change closes it.
+    DirectorySessionPool::Lease lease = m_sessionPool->acquire(key, &errorMsg);
+    if (!lease.isValid())
+    {
+        QLOG_ERROR() << "Cannot bind to" << dc.host << "of forest" << forest.objectGuid << errorMsg;
+        return false;
+    }
+    AdsiDirectorySession *session = lease.as<AdsiDirectorySession>();
+    if (!session)
+    {
+        QLOG_ERROR() << "Session pool of the legacy manager is not an ADSI one";
+        return false;
+    }
+    if (!verifyBoundObject(session->object(), forest, dc))
+    {
+        lease.discard();
+        return false;
+    }
+    return true;
 }
 
+void DomainControllerManager::openDCEnumeration()
+{
+    // Cached list, site-local DCs first. The first call only starts discovery in the background.
+    foreach (const DiscoveredDomainController& dc, m_discovery->domainControllers("qliqsoft2.com")) {
+        QLOG_DEBUG() << "pszDnsHostName: " << dc.host << "site local:" << dc.isSiteLocal << "pdc:" << dc.isPdc;
+    }
+}
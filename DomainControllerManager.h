@@ -1,6 +1,12 @@
 #ifndef DOMAINCONTROLLERMANAGER_H
 #define DOMAINCONTROLLERMANAGER_H
+#include <QSharedPointer>
+#include "qliqdirect/shared/ActiveDirectoryDataTypes.h"
 
+namespace ActiveDirectory {
+class DirectorySessionPool;
+class DomainControllerDiscovery;
+}
 
 class DomainControllerManager
 {
@@ -8,9 +14,18 @@ public:
     DomainControllerManager();
 
     void openDCEnumeration();
-    void openDC();
+    // Binds to 'dc' of 'forest' with the forest credentials and reads the bound object, returns false
+    // if the DC is not accessible. Pooled on MTA threads, bound per call on STA threads (GUI).
+    bool openDC(const Forest& forest, const DomainController& dc);
+
+    // By default the process wide ADSI pool is used, shared with ActiveDirectory::DomainControllerManager
+    void setSessionPool(QSharedPointer<ActiveDirectory::DirectorySessionPool> pool);
+    // By default DsGetDc based discovery is used
+    void setDiscovery(QSharedPointer<ActiveDirectory::DomainControllerDiscovery> discovery);
 
 private:
+    QSharedPointer<ActiveDirectory::DirectorySessionPool> m_sessionPool;
+    QSharedPointer<ActiveDirectory::DomainControllerDiscovery> m_discovery;
 };
 
 #endif // DOMAINCONTROLLERMANAGER_H
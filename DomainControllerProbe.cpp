@@ -0,0 +1,594 @@
+#include "DomainControllerProbe.h"
+#include <functional>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QWaitCondition>
+#include <QRunnable>
+#include <QThread>
+#include <QThreadPool>
+#include <QRandomGenerator>
+#include <QElapsedTimer>
+#include <QVector>
+#include <QTcpSocket>
+#include <QsLog.h>
+#include "qliqDirectAD.h"
+#include "ThreadDatabase.h"
+
+namespace ActiveDirectory {
+
+namespace {
+
+class FunctionTask : public QRunnable {
+public:
+    explicit FunctionTask(std::function<void ()> function) :
+        m_function(function)
+    {
+    }
+
+    void run() override
+    {
+        m_function();
+    }
+
+private:
+    std::function<void ()> m_function;
+};
+
+// Max time to sleep in one wait, bounds how late a deadline or cancellation of the token is noticed
+const unsigned long MAX_WAIT_STEP_MS = 100;
+
+unsigned long waitTime(QDeadlineTimer until, QDeadlineTimer deadline)
+{
+    qint64 ms = MAX_WAIT_STEP_MS;
+    if (!until.isForever()) {
+        ms = qMin(ms, until.remainingTime());
+    }
+    if (!deadline.isForever()) {
+        ms = qMin(ms, deadline.remainingTime());
+    }
+    return static_cast<unsigned long>(qMax<qint64>(1, ms));
+}
+
+} // anonymous namespace
+
+////////////////////////////////////////////////////////////////////////////////
+// ProbeCancellationToken
+
+struct ProbeCancellationToken::State {
+    QAtomicInt isCancelled;
+    QSharedPointer<State> parent;
+};
+
+ProbeCancellationToken::ProbeCancellationToken() :
+    m_state(new State())
+{
+}
+
+ProbeCancellationToken ProbeCancellationToken::child() const
+{
+    ProbeCancellationToken token;
+    token.m_state->parent = m_state;
+    return token;
+}
+
+void ProbeCancellationToken::cancel()
+{
+    markCancelled();
+}
+
+bool ProbeCancellationToken::isCancelled() const
+{
+    for (State *state = m_state.data(); state; state = state->parent.data()) {
+        if (state->isCancelled.load() != 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void ProbeCancellationToken::markCancelled() const
+{
+    m_state->isCancelled.store(1);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// DomainControllerProbeResult
+
+DomainControllerProbeResult::DomainControllerProbeResult() :
+    status(PendingStatus),
+    hr(E_PENDING),
+    latencyMs(0)
+{
+}
+
+bool DomainControllerProbeResult::isFinished() const
+{
+    return status != PendingStatus;
+}
+
+bool DomainControllerProbeResult::isAccessible() const
+{
+    return status == FinishedStatus && SUCCEEDED(hr);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// DomainControllerProbeFuture
+
+// Wait of waitForAny(), registered with every future it waits for
+struct DomainControllerProbeFuture::Waiter {
+    QMutex mutex;
+    QWaitCondition condition;
+    bool isWoken;
+
+    Waiter() : isWoken(false) {}
+
+    void wake()
+    {
+        QMutexLocker locker(&mutex);
+        isWoken = true;
+        condition.wakeAll();
+    }
+};
+
+struct DomainControllerProbeFuture::State {
+    // Guards everything below except 'deadline' and 'timer' which are set before the probe starts
+    QMutex mutex;
+    QWaitCondition finished;
+    DomainControllerProbeResult result;
+    QVector<QSharedPointer<Waiter> > waiters;
+    QDeadlineTimer deadline;
+    ProbeCancellationToken cancellation;
+    QElapsedTimer timer;
+};
+
+DomainControllerProbeFuture::DomainControllerProbeFuture()
+{
+}
+
+bool DomainControllerProbeFuture::isValid() const
+{
+    return !m_state.isNull();
+}
+
+bool DomainControllerProbeFuture::isFinished() const
+{
+    if (!isValid()) {
+        return true;
+    }
+    QMutexLocker locker(&m_state->mutex);
+    return refreshLocked(m_state.data());
+}
+
+bool DomainControllerProbeFuture::waitForFinished(QDeadlineTimer until) const
+{
+    if (!isValid()) {
+        return true;
+    }
+
+    QMutexLocker locker(&m_state->mutex);
+    while (!refreshLocked(m_state.data())) {
+        if (until.hasExpired()) {
+            return false;
+        }
+        m_state->finished.wait(&m_state->mutex, waitTime(until, m_state->deadline));
+    }
+    return true;
+}
+
+DomainControllerProbeResult DomainControllerProbeFuture::result() const
+{
+    if (!isValid()) {
+        return DomainControllerProbeResult();
+    }
+    waitForFinished();
+    QMutexLocker locker(&m_state->mutex);
+    return m_state->result;
+}
+
+void DomainControllerProbeFuture::cancel()
+{
+    if (isValid()) {
+        m_state->cancellation.cancel();
+        // Waiters notice the cancellation right away, not after their wait step
+        notify(m_state);
+    }
+}
+
+int DomainControllerProbeFuture::waitForAny(const QVector<DomainControllerProbeFuture>& futures, QDeadlineTimer until)
+{
+    if (futures.isEmpty()) {
+        return -1;
+    }
+
+    QSharedPointer<Waiter> waiter(new Waiter());
+    QDeadlineTimer nearestDeadline(QDeadlineTimer::Forever);
+    int ret = -1;
+    for (int i = 0; i < futures.size() && ret == -1; ++i) {
+        State *state = futures[i].m_state.data();
+        if (!state) {
+            ret = i;
+            break;
+        }
+        QMutexLocker locker(&state->mutex);
+        if (refreshLocked(state)) {
+            ret = i;
+        } else {
+            state->waiters.append(waiter);
+            if (state->deadline < nearestDeadline) {
+                nearestDeadline = state->deadline;
+            }
+        }
+    }
+
+    while (ret == -1 && !until.hasExpired()) {
+        {
+            QMutexLocker locker(&waiter->mutex);
+            if (!waiter->isWoken) {
+                waiter->condition.wait(&waiter->mutex, waitTime(until, nearestDeadline));
+            }
+            waiter->isWoken = false;
+        }
+        for (int i = 0; i < futures.size(); ++i) {
+            State *state = futures[i].m_state.data();
+            QMutexLocker locker(&state->mutex);
+            if (refreshLocked(state)) {
+                ret = i;
+                break;
+            }
+        }
+    }
+
+    foreach (const DomainControllerProbeFuture& future, futures) {
+        if (future.m_state) {
+            QMutexLocker locker(&future.m_state->mutex);
+            future.m_state->waiters.removeAll(waiter);
+        }
+    }
+    return ret;
+}
+
+/*
+ * Returns true if the probe is finished. Finishes it as timed out or cancelled if needed.
+ * Must be called with state->mutex locked.
+ */
+bool DomainControllerProbeFuture::refreshLocked(State *state)
+{
+    DomainControllerProbeResult& result = state->result;
+    if (result.isFinished()) {
+        return true;
+    }
+
+    if (state->cancellation.isCancelled()) {
+        result.status = DomainControllerProbeResult::CancelledStatus;
+        result.hr = E_ABORT;
+    } else if (state->deadline.hasExpired()) {
+        result.status = DomainControllerProbeResult::TimedOutStatus;
+        result.hr = HRESULT_FROM_WIN32(ERROR_TIMEOUT);
+        result.errorMsg = "Timed out";
+        // Let the backend stop, nobody is interested in its answer anymore
+        state->cancellation.markCancelled();
+    } else {
+        return false;
+    }
+    result.latencyMs = state->timer.elapsed();
+    return true;
+}
+
+void DomainControllerProbeFuture::finish(const QSharedPointer<State>& state, long hr, const QString& dnsName, const QString& errorMsg)
+{
+    {
+        QMutexLocker locker(&state->mutex);
+        // Deadline or cancellation may have finished it already
+        if (!refreshLocked(state.data())) {
+            DomainControllerProbeResult& result = state->result;
+            result.status = DomainControllerProbeResult::FinishedStatus;
+            result.hr = hr;
+            result.dnsName = dnsName;
+            result.errorMsg = errorMsg;
+            result.latencyMs = state->timer.elapsed();
+        }
+    }
+    notify(state);
+}
+
+/*
+ * Wakes waitForFinished() and waitForAny() callers of the future, waiters are woken
+ * without the state lock held
+ */
+void DomainControllerProbeFuture::notify(const QSharedPointer<State>& state)
+{
+    QVector<QSharedPointer<Waiter> > waiters;
+    {
+        QMutexLocker locker(&state->mutex);
+        state->finished.wakeAll();
+        waiters = state->waiters;
+    }
+    foreach (const QSharedPointer<Waiter>& waiter, waiters) {
+        waiter->wake();
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// AsyncDomainControllerProbe
+
+AsyncDomainControllerProbe::AsyncDomainControllerProbe(QSharedPointer<DomainControllerProbe> probe) :
+    m_probe(probe)
+{
+}
+
+DomainControllerProbeFuture AsyncDomainControllerProbe::start(const QString& host, QDeadlineTimer deadline,
+                                                              const ProbeCancellationToken& cancellation)
+{
+    typedef DomainControllerProbeFuture::State State;
+    QSharedPointer<State> state(new State());
+    state->result.host = host;
+    state->deadline = deadline;
+    // Own token, so a timeout of this probe does not cancel others
+    state->cancellation = cancellation.child();
+    state->timer.start();
+
+    QSharedPointer<DomainControllerProbe> probe = m_probe;
+    threadPool()->start(new FunctionTask([probe, state, host]() {
+        QString dnsName;
+        QString errorMsg;
+        long hr = E_ABORT;
+        if (!state->cancellation.isCancelled()) {
+            hr = probe->probe(host, &dnsName, &errorMsg, state->cancellation);
+        }
+        DomainControllerProbeFuture::finish(state, hr, dnsName, errorMsg);
+    }));
+
+    DomainControllerProbeFuture future;
+    future.m_state = state;
+    return future;
+}
+
+QVector<DomainControllerProbeFuture> AsyncDomainControllerProbe::startAll(const QStringList& hosts, QDeadlineTimer deadline,
+                                                                          const ProbeCancellationToken& cancellation)
+{
+    QVector<DomainControllerProbeFuture> futures;
+    futures.reserve(hosts.size());
+    foreach (const QString& host, hosts) {
+        futures.append(start(host, deadline, cancellation));
+    }
+    return futures;
+}
+
+QThreadPool *AsyncDomainControllerProbe::threadPool()
+{
+    static QThreadPool *pool = nullptr;
+    static QMutex poolMutex;
+    QMutexLocker locker(&poolMutex);
+    if (!pool) {
+        pool = new QThreadPool();
+        pool->setMaxThreadCount(16);
+        pool->setExpiryTimeout(60 * 1000);
+    }
+    return pool;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Backends
+
+ActiveDirectoryApiProbe::ActiveDirectoryApiProbe(const QSqlDatabase& db) :
+    m_db(db)
+{
+}
+
+long ActiveDirectoryApiProbe::probe(const QString& host, QString *dnsName, QString *errorMsg, const ProbeCancellationToken& cancellation)
+{
+    // ActiveDirectoryApi call itself cannot be interrupted
+    if (cancellation.isCancelled()) {
+        return E_ABORT;
+    }
+    ActiveDirectoryApi ad;
+    QSqlDatabase db = databaseForCurrentThread(m_db);
+    return ad.isServerAccessible(host, dnsName, errorMsg, db);
+}
+
+TcpConnectProbe::TcpConnectProbe(quint16 port, int timeoutMs) :
+    m_port(port),
+    m_timeoutMs(timeoutMs)
+{
+}
+
+long TcpConnectProbe::probe(const QString& host, QString *dnsName, QString *errorMsg, const ProbeCancellationToken& cancellation)
+{
+    Q_UNUSED(dnsName);
+    QTcpSocket socket;
+    socket.connectToHost(host, m_port);
+
+    // Wait in small steps so cancellation is noticed quickly
+    QElapsedTimer timer;
+    timer.start();
+    while (!socket.waitForConnected(qMin<qint64>(100, qMax<qint64>(1, m_timeoutMs - timer.elapsed())))) {
+        if (cancellation.isCancelled()) {
+            return E_ABORT;
+        }
+        if (socket.state() == QAbstractSocket::UnconnectedState || timer.elapsed() >= m_timeoutMs) {
+            if (errorMsg) {
+                *errorMsg = QString("Cannot connect to port %1: %2").arg(m_port).arg(socket.errorString());
+            }
+            return socket.error() == QAbstractSocket::SocketTimeoutError ? HRESULT_FROM_WIN32(ERROR_TIMEOUT) : E_FAIL;
+        }
+    }
+    socket.abort();
+    return S_OK;
+}
+
+TieredDomainControllerProbe::TieredDomainControllerProbe(QSharedPointer<DomainControllerProbe> ping, QSharedPointer<DomainControllerProbe> full,
+                                                         DomainControllerProbeTier tier, const QHash<QString, QString>& knownDnsNames) :
+    m_ping(ping),
+    m_full(full),
+    m_tier(tier),
+    m_knownDnsNames(knownDnsNames)
+{
+}
+
+long TieredDomainControllerProbe::probe(const QString& host, QString *dnsName, QString *errorMsg, const ProbeCancellationToken& cancellation)
+{
+    const QString knownDnsName = m_knownDnsNames.value(host);
+    if (m_tier == FullProbeTier || (m_tier == PingProbeTier && knownDnsName.isEmpty())) {
+        return m_full->probe(host, dnsName, errorMsg, cancellation);
+    }
+
+    // Dead DCs are ruled out without paying for the full check
+    long hr = m_ping->probe(host, nullptr, errorMsg, cancellation);
+    if (FAILED(hr)) {
+        return hr;
+    }
+    if (m_tier == PingThenFullProbeTier) {
+        return m_full->probe(host, dnsName, errorMsg, cancellation);
+    }
+
+    if (dnsName) {
+        *dnsName = knownDnsName;
+    }
+    return hr;
+}
+
+SimulatedDomainControllerProbe::SimulatedDomainControllerProbe(const HostBehavior& defaultBehavior) :
+    m_defaultBehavior(defaultBehavior)
+{
+}
+
+void SimulatedDomainControllerProbe::setHostBehavior(const QString& host, const HostBehavior& behavior)
+{
+    QMutexLocker locker(&m_mutex);
+    m_behaviors.insert(host, behavior);
+}
+
+int SimulatedDomainControllerProbe::probeCount() const
+{
+    return m_probeCount.load();
+}
+
+long SimulatedDomainControllerProbe::probe(const QString& host, QString *dnsName, QString *errorMsg, const ProbeCancellationToken& cancellation)
+{
+    HostBehavior behavior;
+    {
+        QMutexLocker locker(&m_mutex);
+        behavior = m_behaviors.value(host, m_defaultBehavior);
+    }
+    m_probeCount.fetchAndAddRelaxed(1);
+
+    // Sleep in small steps so cancellation is noticed quickly
+    QElapsedTimer timer;
+    timer.start();
+    while (timer.elapsed() < behavior.latencyMs) {
+        if (cancellation.isCancelled()) {
+            return E_ABORT;
+        }
+        QThread::msleep(static_cast<unsigned long>(qMin<qint64>(10, behavior.latencyMs - timer.elapsed())));
+    }
+
+    if (behavior.failureRate > 0 && QRandomGenerator::global()->generateDouble() < behavior.failureRate) {
+        if (errorMsg) {
+            *errorMsg = "Simulated failure";
+        }
+        return E_FAIL;
+    }
+    if (dnsName) {
+        *dnsName = host;
+    }
+    return S_OK;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// ParallelDomainControllerProber
+
+int ParallelDomainControllerProber::probe(QSharedPointer<DomainControllerProbe> probe, const QStringList& hosts, bool firstIsPrimary,
+                                          int deadlineMs, int primaryGraceMs, QString *outDnsName,
+                                          QVector<DomainControllerProbeOutcome> *outOutcomes,
+                                          const ProbeCancellationToken& cancellation)
+{
+    if (hosts.isEmpty()) {
+        return -1;
+    }
+
+    foreach (const QString& host, hosts) {
+        QLOG_SUPPORT() << "Checking accessibility of domain controller (parallel):" << host;
+    }
+
+    // Cancelling this token stops only probes of this call
+    ProbeCancellationToken probesCancellation = cancellation.child();
+    QDeadlineTimer deadline(deadlineMs);
+    QDeadlineTimer grace(firstIsPrimary ? primaryGraceMs : 0);
+    AsyncDomainControllerProbe async(probe);
+    QVector<DomainControllerProbeFuture> futures = async.startAll(hosts, deadline, probesCancellation);
+
+    QVector<int> pending;
+    for (int i = 0; i < futures.size(); ++i) {
+        pending.append(i);
+    }
+
+    int winner = -1;
+    int firstAccessible = -1;   // first host which answered successfully
+    bool isPrimaryDone = !firstIsPrimary;
+    while (!pending.isEmpty()) {
+        bool isGraceOver = isPrimaryDone || grace.hasExpired();
+        if (isGraceOver && firstAccessible != -1) {
+            break;
+        }
+
+        QVector<DomainControllerProbeFuture> pendingFutures;
+        foreach (int i, pending) {
+            pendingFutures.append(futures[i]);
+        }
+        int pendingIndex = DomainControllerProbeFuture::waitForAny(pendingFutures, isGraceOver ? deadline : qMin(grace, deadline));
+        if (pendingIndex == -1) {
+            if (deadline.hasExpired()) {
+                break;
+            }
+            continue;   // grace window is over
+        }
+
+        int i = pending.takeAt(pendingIndex);
+        DomainControllerProbeResult result = futures[i].result();
+        if (i == 0 && firstIsPrimary) {
+            isPrimaryDone = true;
+            if (result.isAccessible()) {
+                winner = 0;
+                break;
+            }
+        }
+        if (result.isAccessible()) {
+            if (firstAccessible == -1) {
+                firstAccessible = i;
+            }
+        } else if (result.status == DomainControllerProbeResult::FinishedStatus) {
+            QLOG_ERROR() << "Domain controller:" << hosts[i] << "is not accessible with error:" << result.hr << result.errorMsg;
+        }
+    }
+    if (winner == -1) {
+        winner = firstAccessible;
+    }
+
+    if (!pending.isEmpty()) {
+        QLOG_SUPPORT() << "Cancelling" << pending.size() << "domain controller probe(s) still in flight";
+    }
+    probesCancellation.cancel();
+
+    if (winner != -1 && outDnsName) {
+        *outDnsName = futures[winner].result().dnsName;
+    }
+    if (outOutcomes) {
+        outOutcomes->resize(hosts.size());
+        for (int i = 0; i < hosts.size(); ++i) {
+            // Every future is finished now, at least as cancelled
+            DomainControllerProbeResult result = futures[i].result();
+            DomainControllerProbeOutcome& outcome = (*outOutcomes)[i];
+            outcome.isDone = result.status == DomainControllerProbeResult::FinishedStatus ||
+                             result.status == DomainControllerProbeResult::TimedOutStatus;
+            outcome.hr = result.hr;
+            outcome.latencyMs = result.latencyMs;
+        }
+    }
+
+    if (winner == -1) {
+        QLOG_ERROR() << "None of" << hosts.size() << "domain controllers answered within" << deadlineMs << "ms";
+    }
+    return winner;
+}
+
+} // namespace ActiveDirectory
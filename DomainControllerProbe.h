@@ -0,0 +1,236 @@
+#ifndef DOMAINCONTROLLERPROBE_H
+#define DOMAINCONTROLLERPROBE_H
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QSqlDatabase>
+#include <QAtomicInt>
+#include <QSharedPointer>
+#include <QHash>
+#include <QMutex>
+#include <QDeadlineTimer>
+
+class QThreadPool;
+
+namespace ActiveDirectory {
+
+/*
+ * Shared cancellation flag of probes. A child token is cancelled together with its parent
+ * but can also be cancelled alone, i.e. a shutdown cancels everything started from the
+ * manager token while a finished forest cancels only its own remaining probes.
+ */
+class ProbeCancellationToken {
+public:
+    ProbeCancellationToken();
+
+    ProbeCancellationToken child() const;
+    void cancel();
+    bool isCancelled() const;
+
+private:
+    friend class DomainControllerProbeFuture;
+    struct State;
+
+    void markCancelled() const;
+
+    QSharedPointer<State> m_state;
+};
+
+/*
+ * Backend which checks if a domain controller is accessible. Implementations are called
+ * concurrently from thread pool threads so they must be thread safe.
+ */
+class DomainControllerProbe {
+public:
+    virtual ~DomainControllerProbe() {}
+
+    // Returns HRESULT, SUCCEEDED(hr) means the domain controller is accessible.
+    // 'cancellation' is cancelled when the caller is no longer interested in the result
+    // (deadline passed, other DC selected, shutdown), long running implementations should
+    // check it and return E_ABORT early.
+    virtual long probe(const QString& host, QString *dnsName, QString *errorMsg, const ProbeCancellationToken& cancellation) = 0;
+};
+
+/*
+ * Default backend, it does full ActiveDirectoryApi::isServerAccessible() check.
+ * Calls from a thread other than the owner of the database use a cloned connection.
+ */
+class ActiveDirectoryApiProbe : public DomainControllerProbe {
+public:
+    explicit ActiveDirectoryApiProbe(const QSqlDatabase& db);
+
+    long probe(const QString& host, QString *dnsName, QString *errorMsg, const ProbeCancellationToken& cancellation) override;
+
+private:
+    QSqlDatabase m_db;
+};
+
+/*
+ * Backend which does not touch the network, used to measure DC selection at scale and to
+ * exercise timeout and cancellation paths. Every host answers after its configured latency
+ * and fails with the configured probability.
+ */
+class SimulatedDomainControllerProbe : public DomainControllerProbe {
+public:
+    struct HostBehavior {
+        int latencyMs;
+        double failureRate;     // 0 - never fails, 1 - always fails
+
+        HostBehavior(int latencyMs = 0, double failureRate = 0) : latencyMs(latencyMs), failureRate(failureRate) {}
+    };
+
+    explicit SimulatedDomainControllerProbe(const HostBehavior& defaultBehavior = HostBehavior());
+
+    void setHostBehavior(const QString& host, const HostBehavior& behavior);
+    int probeCount() const;
+
+    long probe(const QString& host, QString *dnsName, QString *errorMsg, const ProbeCancellationToken& cancellation) override;
+
+private:
+    mutable QMutex m_mutex;
+    HostBehavior m_defaultBehavior;
+    QHash<QString, HostBehavior> m_behaviors;
+    QAtomicInt m_probeCount;
+};
+
+/*
+ * Cheap liveness check: TCP connect to the LDAP port. connectToHost() resolves 'host' like any
+ * connection would, but there is no bind, no query of the DC's own DNS name and no database
+ * access, so it tells only that something listens on the port.
+ */
+class TcpConnectProbe : public DomainControllerProbe {
+public:
+    explicit TcpConnectProbe(quint16 port = 389, int timeoutMs = 3000);
+
+    long probe(const QString& host, QString *dnsName, QString *errorMsg, const ProbeCancellationToken& cancellation) override;
+
+private:
+    quint16 m_port;
+    int m_timeoutMs;
+};
+
+enum DomainControllerProbeTier {
+    FullProbeTier,              // full check of every DC (default)
+    PingThenFullProbeTier,      // full check only of DCs which answer the ping
+    PingProbeTier               // ping only, full check only of DCs whose DNS name is not known yet
+};
+
+/*
+ * Runs the cheap 'ping' backend before (or instead of) the expensive 'full' one depending on tier.
+ * 'knownDnsNames' (host -> DNS name) are DNS names stored in forest configuration, the full check
+ * is needed to get one when missing.
+ */
+class TieredDomainControllerProbe : public DomainControllerProbe {
+public:
+    TieredDomainControllerProbe(QSharedPointer<DomainControllerProbe> ping, QSharedPointer<DomainControllerProbe> full,
+                                DomainControllerProbeTier tier, const QHash<QString, QString>& knownDnsNames = QHash<QString, QString>());
+
+    long probe(const QString& host, QString *dnsName, QString *errorMsg, const ProbeCancellationToken& cancellation) override;
+
+private:
+    QSharedPointer<DomainControllerProbe> m_ping;
+    QSharedPointer<DomainControllerProbe> m_full;
+    DomainControllerProbeTier m_tier;
+    QHash<QString, QString> m_knownDnsNames;
+};
+
+struct DomainControllerProbeResult {
+    enum Status {
+        PendingStatus,
+        FinishedStatus,     // backend answered, see hr
+        TimedOutStatus,     // deadline passed before backend answered
+        CancelledStatus
+    };
+
+    Status status;
+    QString host;
+    long hr;
+    QString dnsName;
+    QString errorMsg;
+    qint64 latencyMs;
+
+    DomainControllerProbeResult();
+    bool isFinished() const;
+    bool isAccessible() const;
+};
+
+/*
+ * Handle of a probe started by AsyncDomainControllerProbe. The probe is finished when the
+ * backend answers, its deadline passes or it is cancelled, whichever comes first.
+ * A probe which timed out is cancelled, so the backend may stop early.
+ * Every future has its own lock and condition, waitForAny() registers a waiter with each of them.
+ */
+class DomainControllerProbeFuture {
+public:
+    DomainControllerProbeFuture();
+
+    bool isValid() const;
+    bool isFinished() const;
+    // Returns false if 'until' expired before the probe finished
+    bool waitForFinished(QDeadlineTimer until = QDeadlineTimer(QDeadlineTimer::Forever)) const;
+    // Waits for the probe to finish
+    DomainControllerProbeResult result() const;
+    void cancel();
+
+    // Waits until any of futures finishes, returns its index or -1 if 'until' expired first
+    static int waitForAny(const QVector<DomainControllerProbeFuture>& futures,
+                          QDeadlineTimer until = QDeadlineTimer(QDeadlineTimer::Forever));
+
+private:
+    friend class AsyncDomainControllerProbe;
+    struct State;
+    struct Waiter;
+
+    static bool refreshLocked(State *state);
+    static void finish(const QSharedPointer<State>& state, long hr, const QString& dnsName, const QString& errorMsg);
+    static void notify(const QSharedPointer<State>& state);
+
+    QSharedPointer<State> m_state;
+};
+
+/*
+ * Runs probes of a DomainControllerProbe backend on a dedicated thread pool
+ */
+class AsyncDomainControllerProbe {
+public:
+    explicit AsyncDomainControllerProbe(QSharedPointer<DomainControllerProbe> probe);
+
+    DomainControllerProbeFuture start(const QString& host, QDeadlineTimer deadline,
+                                      const ProbeCancellationToken& cancellation = ProbeCancellationToken());
+    QVector<DomainControllerProbeFuture> startAll(const QStringList& hosts, QDeadlineTimer deadline,
+                                                  const ProbeCancellationToken& cancellation = ProbeCancellationToken());
+
+    // Separate pool so hung probes cannot starve QThreadPool::globalInstance() users
+    static QThreadPool *threadPool();
+
+private:
+    QSharedPointer<DomainControllerProbe> m_probe;
+};
+
+// Result of a single probe done by ParallelDomainControllerProber
+struct DomainControllerProbeOutcome {
+    bool isDone;        // false if still in flight or cancelled when the selection was made
+    long hr;
+    qint64 latencyMs;
+
+    DomainControllerProbeOutcome() : isDone(false), hr(0), latencyMs(0) {}
+};
+
+/*
+ * Probes all domain controllers of a forest at once with a shared deadline.
+ * If 'firstIsPrimary' is true the first host wins when it answers within 'primaryGraceMs',
+ * otherwise the first additional host to answer is used. Probes still in flight are cancelled.
+ * Returns index of the selected host or -1 if none is accessible before the deadline.
+ * 'outOutcomes' (optional) receives result of every probe finished before the selection.
+ */
+class ParallelDomainControllerProber {
+public:
+    static int probe(QSharedPointer<DomainControllerProbe> probe, const QStringList& hosts, bool firstIsPrimary,
+                     int deadlineMs, int primaryGraceMs, QString *outDnsName,
+                     QVector<DomainControllerProbeOutcome> *outOutcomes = nullptr,
+                     const ProbeCancellationToken& cancellation = ProbeCancellationToken());
+};
+
+} // namespace ActiveDirectory
+
+#endif // DOMAINCONTROLLERPROBE_H
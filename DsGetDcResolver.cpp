@@ -0,0 +1,86 @@
+#include "DsGetDcResolver.h"
+#include <QSet>
+#include <QsLog.h>
+#include <wtypes.h>
+#include <Winsock2.h>
+#include <dsgetdc.h>
+#include <windows.h>
+#include <Lm.h>
+
+namespace ActiveDirectory {
+
+namespace {
+
+inline const WCHAR *q2cwstr(const QString& str)
+{
+    return reinterpret_cast<const WCHAR *>(str.utf16());
+}
+
+QString pdcHost(const QString& domain)
+{
+    QString ret;
+    PDOMAIN_CONTROLLER_INFOW pdcInfo = NULL;
+    DWORD dwRet = DsGetDcNameW(NULL, q2cwstr(domain), NULL, NULL, DS_PDC_REQUIRED | DS_RETURN_DNS_NAME, &pdcInfo);
+    if (NO_ERROR == dwRet) {
+        // Name is returned as \\host
+        ret = QString::fromWCharArray(pdcInfo->DomainControllerName);
+        while (ret.startsWith('\\')) {
+            ret.remove(0, 1);
+        }
+        NetApiBufferFree(pdcInfo);
+    } else {
+        QLOG_WARN() << "Cannot find PDC of domain" << domain << "error:" << dwRet;
+    }
+    return ret;
+}
+
+} // namespace
+
+bool DsGetDcResolver::resolve(const QString& domain, QVector<DiscoveredDomainController> *out, QString *errorMsg)
+{
+    const QString pdc = pdcHost(domain);
+
+    HANDLE hGetDc;
+    DWORD dwRet = DsGetDcOpenW(q2cwstr(domain), DS_NOTIFY_AFTER_SITE_RECORDS, NULL, NULL, NULL, 0, &hGetDc);
+    if (ERROR_SUCCESS != dwRet) {
+        *errorMsg = QString("DsGetDcOpen failed with error: %1").arg(dwRet);
+        return false;
+    }
+
+    bool ret = true;
+    bool isSiteLocal = true;
+    QSet<QString> seen;
+    while (true) {
+        ULONG ulSocketCount;
+        LPSOCKET_ADDRESS rgSocketAddresses;
+        LPWSTR pszDnsHostName;
+
+        dwRet = DsGetDcNextW(hGetDc, &ulSocketCount, &rgSocketAddresses, &pszDnsHostName);
+        if (ERROR_SUCCESS == dwRet) {
+            QString host = QString::fromWCharArray(pszDnsHostName);
+            NetApiBufferFree(pszDnsHostName);
+            LocalFree(rgSocketAddresses);
+
+            // Site DCs are listed again among all DCs of the domain
+            if (!seen.contains(host.toLower())) {
+                seen.insert(host.toLower());
+                out->append(DiscoveredDomainController(host, isSiteLocal, host.compare(pdc, Qt::CaseInsensitive) == 0));
+            }
+        } else if (ERROR_NO_MORE_ITEMS == dwRet) {
+            break;
+        } else if (ERROR_FILEMARK_DETECTED == dwRet) {
+            // End of site-specific domain controllers
+            isSiteLocal = false;
+        } else {
+            *errorMsg = QString("DsGetDcNext failed with error: %1").arg(dwRet);
+            // What was found so far is still usable
+            ret = !out->isEmpty();
+            break;
+        }
+    }
+
+    DsGetDcCloseW(hGetDc);
+    return ret;
+}
+
+} // namespace ActiveDirectory
@@ -0,0 +1,19 @@
+#ifndef DSGETDCRESOLVER_H
+#define DSGETDCRESOLVER_H
+#include "DomainControllerDiscovery.h"
+
+namespace ActiveDirectory {
+
+/*
+ * Resolves domain controllers with DsGetDcOpen/DsGetDcNext. DS_NOTIFY_AFTER_SITE_RECORDS makes
+ * the enumeration return DCs of our site first, ERROR_FILEMARK_DETECTED marks the boundary.
+ * The PDC is looked up with DsGetDcName once per resolve.
+ */
+class DsGetDcResolver : public DomainControllerResolver {
+public:
+    bool resolve(const QString& domain, QVector<DiscoveredDomainController> *out, QString *errorMsg) override;
+};
+
+} // namespace ActiveDirectory
+
+#endif // DSGETDCRESOLVER_H
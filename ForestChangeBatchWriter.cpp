@@ -0,0 +1,329 @@
+#include "ForestChangeBatchWriter.h"
+#include <QHash>
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QVariant>
+#include <QsLog.h>
+#include "dao/ActiveDirectoryDao.h"
+#include "ForestSchema.h"
+#include "ForestDeletionJob.h"
+#include "ForestRescopeJob.h"
+#include "SyncProgressLedger.h"
+
+namespace ActiveDirectory {
+
+ForestChangeBatchWriter::ForestChangeBatchWriter(QSqlDatabase db) :
+    m_db(db),
+    m_changeCount(0),
+    m_rowsAffected(0),
+    m_isIncrementalRescope(false)
+{
+}
+
+void ForestChangeBatchWriter::setIncrementalRescope(bool on)
+{
+    m_isIncrementalRescope = on;
+}
+
+void ForestChangeBatchWriter::add(const ForestComparator::ForestWithChange& fc)
+{
+    QLOG_SUPPORT() << "Processing changes for forest" << fc.forest.objectGuid;
+    m_changeCount++;
+
+    if (hasChange(fc, ForestComparator::Added)) {
+        QLOG_SUPPORT() << "This is a new forest (added)";
+        m_addedForests.append(fc.forest);
+        // Its domain controllers are inserted by insertDomainControllers()
+    } else if (hasChange(fc, ForestComparator::Deleted)) {
+        QLOG_SUPPORT() << "This forest is deleted now";
+        m_deletedForests.append(fc.forest);
+    } else {
+        if (hasChange(fc, ForestComparator::CredentialsChanged)) {
+            QLOG_SUPPORT() << "Credentials changed for forest";
+            m_credentialsChangedForests.append(fc.forest);
+        }
+        if (hasChange(fc, ForestComparator::SyncGroupChanged)) {
+            QLOG_SUPPORT() << "Sync group changed for forest," << (m_isIncrementalRescope ? "rescope is pending" : "full sync is pending");
+            m_syncGroupChangedForests.append(fc.forest);
+        }
+    }
+
+    foreach (const auto& dcc, fc.domainControllerChanges) {
+        switch (dcc.change) {
+        case ForestComparator::DomainControllerWithChange::Added:
+            QLOG_SUPPORT() << "Domain controller added" << dcc.domainContoller.host << "is primary:" << dcc.domainContoller.isPrimary;
+            m_addedDomainControllers.append(qMakePair(fc.forest.objectGuid, dcc.domainContoller));
+            break;
+        case ForestComparator::DomainControllerWithChange::IsPrimaryChanged:
+            QLOG_SUPPORT() << "Domain controller changed" << dcc.domainContoller.host << "now primary:" << dcc.domainContoller.isPrimary;
+            m_isPrimaryChangedDomainControllers.append(qMakePair(fc.forest.objectGuid, dcc.domainContoller));
+            break;
+        case ForestComparator::DomainControllerWithChange::Deleted:
+            QLOG_SUPPORT() << "Domain controller deleted" << dcc.domainContoller.host << "was primary:" << dcc.domainContoller.isPrimary;
+            m_deletedDomainControllers.append(qMakePair(fc.forest.objectGuid, dcc.domainContoller));
+            break;
+        }
+    }
+}
+
+/*
+ * Order matters: forests are inserted before their domain controllers and
+ * domain controllers are deleted before new ones are inserted.
+ */
+bool ForestChangeBatchWriter::write()
+{
+    return insertForests() &&
+           deleteForests() &&
+           updateCredentials() &&
+           updateSyncGroups() &&
+           deleteDomainControllers() &&
+           updateIsPrimary() &&
+           insertDomainControllers();
+}
+
+int ForestChangeBatchWriter::changeCount() const
+{
+    return m_changeCount;
+}
+
+bool ForestChangeBatchWriter::hasDeletedForests() const
+{
+    return !m_deletedForests.isEmpty();
+}
+
+int ForestChangeBatchWriter::rowsAffected() const
+{
+    return m_rowsAffected;
+}
+
+bool ForestChangeBatchWriter::insertForests()
+{
+    foreach (const Forest& forest, m_addedForests) {
+        if (!ForestDao::insert(forest, m_db)) {
+            QLOG_ERROR() << "Cannot insert forest" << forest.objectGuid;
+            return false;
+        }
+        m_rowsAffected++;
+        // A forest deleted earlier and added back keeps its tombstone, it is not synced until
+        // ForestDeletionJob removed its old data
+    }
+    return true;
+}
+
+bool ForestChangeBatchWriter::deleteForests()
+{
+    if (m_deletedForests.isEmpty()) {
+        return true;
+    }
+
+    // Users, groups and group memberships are cleaned up later by ForestDeletionJob
+    // in small transactions, here the forest is only tombstoned
+    QStringList forestGuids;
+    foreach (const Forest& forest, m_deletedForests) {
+        if (!ForestDeletionJob::tombstone(forest.objectGuid, m_db)) {
+            return false;
+        }
+        forestGuids.append(forest.objectGuid);
+    }
+    if (!ForestRescopeJob::cancel(forestGuids, m_db) || !SyncProgressLedger::deleteOfForests(forestGuids, m_db)) {
+        return false;
+    }
+    // Forest rows go through ForestDao, deleting a few forests is rare
+    foreach (const QString& forestGuid, forestGuids) {
+        if (!ForestDao::delete_(ForestDao::ObjectGuidColumn, forestGuid, m_db)) {
+            QLOG_ERROR() << "Cannot delete forest" << forestGuid;
+            return false;
+        }
+        m_rowsAffected++;
+    }
+    return deleteIn(SYNC_CONTEXT_TABLE, SYNC_CONTEXT_FOREST_GUID_COLUMN, forestGuids);
+}
+
+bool ForestChangeBatchWriter::updateCredentials()
+{
+    if (m_credentialsChangedForests.isEmpty()) {
+        return true;
+    }
+
+    // Through ForestDao, it owns the stored format of credentials. ForestDao has no batch
+    // update, but credentials of only a few forests change per push.
+    foreach (const Forest& forest, m_credentialsChangedForests) {
+        if (!ForestDao::updateColumn(ForestDao::UserNameCoumn, forest.userName, forest, m_db) ||
+            !ForestDao::updateColumn(ForestDao::PasswordColumn, forest.password, forest, m_db)) {
+            QLOG_ERROR() << "Cannot update credentials of forest" << forest.objectGuid;
+            return false;
+        }
+        m_rowsAffected++;
+    }
+    return true;
+}
+
+bool ForestChangeBatchWriter::updateSyncGroups()
+{
+    if (m_syncGroupChangedForests.isEmpty()) {
+        return true;
+    }
+
+    QVariantList syncGroups, forestGuids;
+    QStringList forestGuidStrings;
+    foreach (const Forest& forest, m_syncGroupChangedForests) {
+        syncGroups.append(forest.syncGroup);
+        forestGuids.append(forest.objectGuid);
+        forestGuidStrings.append(forest.objectGuid);
+    }
+
+    // Rescope reads the old sync group, so it is scheduled before the update.
+    // Sync contexts are kept, only users and groups entering the scope are fetched.
+    if (m_isIncrementalRescope && !ForestRescopeJob::schedule(forestGuids, syncGroups, m_db)) {
+        return false;
+    }
+
+    foreach (const Forest& forest, m_syncGroupChangedForests) {
+        if (!ForestDao::updateColumn(ForestDao::SyncGroupColumn, forest.syncGroup, forest, m_db)) {
+            QLOG_ERROR() << "Cannot update sync group of forest" << forest.objectGuid;
+            return false;
+        }
+        m_rowsAffected++;
+    }
+    return m_isIncrementalRescope || deleteIn(SYNC_CONTEXT_TABLE, SYNC_CONTEXT_FOREST_GUID_COLUMN, forestGuidStrings);
+}
+
+bool ForestChangeBatchWriter::deleteDomainControllers()
+{
+    if (m_deletedDomainControllers.isEmpty()) {
+        return true;
+    }
+
+    QHash<QString, QStringList> hostsByForest;
+    QStringList forestGuids;
+    QStringList hosts;
+    foreach (const ForestDomainController& fdc, m_deletedDomainControllers) {
+        if (!hostsByForest.contains(fdc.first)) {
+            forestGuids.append(fdc.first);
+        }
+        hostsByForest[fdc.first].append(fdc.second.host);
+        hosts.append(fdc.second.host);
+    }
+
+    foreach (const QString& forestGuid, forestGuids) {
+        if (!deleteIn(DC_MEMBERSHIP_TABLE, DC_MEMBERSHIP_HOST_COLUMN, hostsByForest.value(forestGuid),
+                      DC_MEMBERSHIP_FOREST_GUID_COLUMN, forestGuid)) {
+            return false;
+        }
+    }
+    // Delete sync context of those dcs. Sync progress stays in SyncProgressLedger (keyed by
+    // invocationId): the DC which takes over resumes only if the ledger has its checkpoint or a
+    // covered observation of it, otherwise it still does a full sync
+    return deleteIn(SYNC_CONTEXT_TABLE, SYNC_CONTEXT_DC_HOST_COLUMN, hosts);
+}
+
+bool ForestChangeBatchWriter::updateIsPrimary()
+{
+    if (m_isPrimaryChangedDomainControllers.isEmpty()) {
+        return true;
+    }
+
+    QVariantList isPrimary, forestGuids, hosts;
+    foreach (const ForestDomainController& fdc, m_isPrimaryChangedDomainControllers) {
+        isPrimary.append(fdc.second.isPrimary ? 1 : 0);
+        forestGuids.append(fdc.first);
+        hosts.append(fdc.second.host);
+    }
+
+    QSqlQuery query(m_db);
+    query.prepare("UPDATE " DC_MEMBERSHIP_TABLE " SET " DC_MEMBERSHIP_IS_PRIMARY_COLUMN " = ?"
+                  " WHERE " DC_MEMBERSHIP_FOREST_GUID_COLUMN " = ? AND " DC_MEMBERSHIP_HOST_COLUMN " = ?");
+    query.addBindValue(isPrimary);
+    query.addBindValue(forestGuids);
+    query.addBindValue(hosts);
+    return exec(query, true);
+}
+
+bool ForestChangeBatchWriter::insertDomainControllers()
+{
+    const int columns = 4;
+    const int rowsPerStatement = MAX_BOUND_VALUES_PER_STATEMENT / columns;
+
+    // All chunks except the last one have the same size, so their statement is prepared once
+    QSqlQuery fullChunkQuery(m_db);
+    bool isFullChunkQueryPrepared = false;
+
+    for (int offset = 0; offset < m_addedDomainControllers.size(); offset += rowsPerStatement) {
+        int rows = qMin(rowsPerStatement, m_addedDomainControllers.size() - offset);
+
+        QSqlQuery partialChunkQuery(m_db);
+        QSqlQuery& query = (rows == rowsPerStatement) ? fullChunkQuery : partialChunkQuery;
+        if (&query != &fullChunkQuery || !isFullChunkQueryPrepared) {
+            QString sql = "INSERT INTO " DC_MEMBERSHIP_TABLE " (" DC_MEMBERSHIP_FOREST_GUID_COLUMN ", " DC_MEMBERSHIP_HOST_COLUMN ", "
+                          DC_MEMBERSHIP_IS_PRIMARY_COLUMN ", " DC_MEMBERSHIP_FULL_SERVER_NAME_COLUMN ") VALUES ";
+            for (int i = 0; i < rows; ++i) {
+                sql += (i == 0) ? "(?, ?, ?, ?)" : ", (?, ?, ?, ?)";
+            }
+            query.prepare(sql);
+            isFullChunkQueryPrepared = isFullChunkQueryPrepared || (&query == &fullChunkQuery);
+        }
+
+        for (int i = offset; i < offset + rows; ++i) {
+            const ForestDomainController& fdc = m_addedDomainControllers[i];
+            query.addBindValue(fdc.first);
+            query.addBindValue(fdc.second.host);
+            query.addBindValue(fdc.second.isPrimary ? 1 : 0);
+            query.addBindValue(fdc.second.dnsName);
+        }
+        if (!exec(query)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * DELETE FROM table WHERE column IN (values) [AND extraColumn = extraValue], split into
+ * statements which stay below the bound values limit
+ */
+bool ForestChangeBatchWriter::deleteIn(const QString& table, const QString& column, const QStringList& values,
+                                       const QString& extraColumn, const QVariant& extraValue)
+{
+    const int chunkSize = MAX_BOUND_VALUES_PER_STATEMENT;
+    for (int offset = 0; offset < values.size(); offset += chunkSize) {
+        int count = qMin(chunkSize, values.size() - offset);
+
+        QString placeholders;
+        placeholders.reserve(count * 3);
+        for (int i = 0; i < count; ++i) {
+            placeholders += (i == 0) ? "?" : ", ?";
+        }
+        QString sql = QString("DELETE FROM %1 WHERE %2 IN (%3)").arg(table, column, placeholders);
+        if (!extraColumn.isEmpty()) {
+            sql += QString(" AND %1 = ?").arg(extraColumn);
+        }
+
+        QSqlQuery query(m_db);
+        query.prepare(sql);
+        for (int i = offset; i < offset + count; ++i) {
+            query.addBindValue(values[i]);
+        }
+        if (!extraColumn.isEmpty()) {
+            query.addBindValue(extraValue);
+        }
+        if (!exec(query)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ForestChangeBatchWriter::exec(QSqlQuery& query, bool isBatch)
+{
+    bool ok = isBatch ? query.execBatch() : query.exec();
+    if (!ok) {
+        QLOG_ERROR() << "Cannot apply forest changes:" << query.lastError().text() << "query:" << query.lastQuery();
+        return false;
+    }
+    if (query.numRowsAffected() > 0) {
+        m_rowsAffected += query.numRowsAffected();
+    }
+    return true;
+}
+
+} // namespace ActiveDirectory
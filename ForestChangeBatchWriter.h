@@ -0,0 +1,64 @@
+#ifndef FORESTCHANGEBATCHWRITER_H
+#define FORESTCHANGEBATCHWRITER_H
+#include <QVector>
+#include <QPair>
+#include <QStringList>
+#include <QSqlDatabase>
+#include "AdForestComparator.h"
+
+class QSqlQuery;
+
+namespace ActiveDirectory {
+
+/*
+ * Applies forest configuration changes grouped by kind instead of one DAO call per change.
+ * DC membership updates reuse one prepared statement (execBatch), DC memberships are inserted
+ * with multi-row INSERTs and DC memberships/sync contexts are deleted with IN (...) lists.
+ * Forest rows (credentials, sync group, deletion) are written through ForestDao.
+ * write() does not open a transaction, call it inside DatabaseUtil::inTransaction().
+ */
+class ForestChangeBatchWriter {
+public:
+    explicit ForestChangeBatchWriter(QSqlDatabase db);
+
+    // Sync group change schedules ForestRescopeJob instead of deleting sync contexts (full sync)
+    void setIncrementalRescope(bool on);
+    void add(const ForestComparator::ForestWithChange& fc);
+    bool write();
+
+    int changeCount() const;
+    bool hasDeletedForests() const;
+    int rowsAffected() const;
+
+private:
+    bool insertForests();
+    bool deleteForests();
+    bool updateCredentials();
+    bool updateSyncGroups();
+    bool deleteDomainControllers();
+    bool updateIsPrimary();
+    bool insertDomainControllers();
+
+    bool deleteIn(const QString& table, const QString& column, const QStringList& values,
+                  const QString& extraColumn = QString(), const QVariant& extraValue = QVariant());
+    bool exec(QSqlQuery& query, bool isBatch = false);
+
+    typedef QPair<QString, DomainController> ForestDomainController;
+
+    QSqlDatabase m_db;
+    int m_changeCount;
+    int m_rowsAffected;
+    bool m_isIncrementalRescope;
+
+    QVector<Forest> m_addedForests;
+    QVector<Forest> m_deletedForests;
+    QVector<Forest> m_credentialsChangedForests;
+    QVector<Forest> m_syncGroupChangedForests;
+    QVector<ForestDomainController> m_addedDomainControllers;
+    QVector<ForestDomainController> m_isPrimaryChangedDomainControllers;
+    QVector<ForestDomainController> m_deletedDomainControllers;
+};
+
+} // namespace ActiveDirectory
+
+#endif // FORESTCHANGEBATCHWRITER_H
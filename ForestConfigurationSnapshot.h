@@ -0,0 +1,27 @@
+#ifndef FORESTCONFIGURATIONSNAPSHOT_H
+#define FORESTCONFIGURATIONSNAPSHOT_H
+#include <memory>
+#include <QVector>
+#include "qliqdirect/shared/ActiveDirectoryDataTypes.h"
+
+namespace ActiveDirectory {
+
+/*
+ * Immutable version of forest configuration. A new snapshot with the next generation number
+ * is published by every load(), saveForests() and reset(), existing snapshots never change.
+ */
+struct ForestConfigurationSnapshot {
+    quint64 generation;
+    QVector<Forest> forests;
+    QVector<quint64> contentHashes;     // ForestDiff::contentHash() of each forest
+
+    ForestConfigurationSnapshot() : generation(0) {}
+    ForestConfigurationSnapshot(quint64 generation, const QVector<Forest>& forests, const QVector<quint64>& contentHashes) :
+        generation(generation), forests(forests), contentHashes(contentHashes) {}
+};
+
+typedef std::shared_ptr<const ForestConfigurationSnapshot> ForestConfigurationSnapshotPtr;
+
+} // namespace ActiveDirectory
+
+#endif // FORESTCONFIGURATIONSNAPSHOT_H
@@ -0,0 +1,243 @@
+#include "ForestDeletionJob.h"
+#include <QTimer>
+#include <QDateTime>
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QVariant>
+#include <QsLog.h>
+#include "dao/ActiveDirectoryDao.h"
+#include "db/DatabaseUtil.h"
+#include "ThreadDatabase.h"
+#include "DatabaseWriter.h"
+
+#define FOREST_TOMBSTONE_TABLE "active_directory_forest_tombstone"
+#define DEFAULT_STAGE_INTERVAL_MS 50
+#define RETRY_INTERVAL_MS (30 * 1000)
+
+namespace ActiveDirectory {
+
+ForestDeletionJob::ForestDeletionJob(QObject *parent) :
+    QObject(parent),
+    m_stageIntervalMs(DEFAULT_STAGE_INTERVAL_MS),
+    m_isRunning(false)
+{
+}
+
+void ForestDeletionJob::setDatabase(const QSqlDatabase& db)
+{
+    m_db = db;
+}
+
+void ForestDeletionJob::setDatabaseWriter(QSharedPointer<DatabaseWriter> writer)
+{
+    m_databaseWriter = writer;
+}
+
+void ForestDeletionJob::setStageInterval(int ms)
+{
+    m_stageIntervalMs = qMax(0, ms);
+}
+
+bool ForestDeletionJob::isRunning() const
+{
+    return m_isRunning;
+}
+
+bool ForestDeletionJob::createTableIfNotExists(QSqlDatabase db)
+{
+    QSqlQuery query(db);
+    bool ret = query.exec("CREATE TABLE IF NOT EXISTS " FOREST_TOMBSTONE_TABLE " ("
+                          " forest_guid TEXT PRIMARY KEY,"
+                          " stage INTEGER NOT NULL,"
+                          " rows_done INTEGER NOT NULL,"     // unused since stages run whole
+                          " deleted_at INTEGER NOT NULL)");
+    if (!ret) {
+        QLOG_ERROR() << "Cannot create table" << FOREST_TOMBSTONE_TABLE << query.lastError().text();
+    }
+    return ret;
+}
+
+bool ForestDeletionJob::tombstone(const QString& forestGuid, QSqlDatabase db)
+{
+    if (!createTableIfNotExists(db)) {
+        return false;
+    }
+
+    // Deleting the same forest again restarts its cascade, all stages are idempotent
+    QSqlQuery query(db);
+    query.prepare("INSERT OR REPLACE INTO " FOREST_TOMBSTONE_TABLE " (forest_guid, stage, rows_done, deleted_at) VALUES (?, ?, 0, ?)");
+    query.addBindValue(forestGuid);
+    query.addBindValue(static_cast<int>(MarkUsersDeletedStage));
+    query.addBindValue(QDateTime::currentMSecsSinceEpoch());
+    bool ret = query.exec();
+    if (!ret) {
+        QLOG_ERROR() << "Cannot write tombstone of forest" << forestGuid << query.lastError().text();
+    }
+    return ret;
+}
+
+bool ForestDeletionJob::removeTombstone(const QString& forestGuid, QSqlDatabase db)
+{
+    if (!createTableIfNotExists(db)) {
+        return false;
+    }
+
+    QSqlQuery query(db);
+    query.prepare("DELETE FROM " FOREST_TOMBSTONE_TABLE " WHERE forest_guid = ?");
+    query.addBindValue(forestGuid);
+    bool ret = query.exec();
+    if (!ret) {
+        QLOG_ERROR() << "Cannot remove tombstone of forest" << forestGuid << query.lastError().text();
+    }
+    return ret;
+}
+
+int ForestDeletionJob::pendingCount(QSqlDatabase db)
+{
+    QSqlQuery query(db);
+    if (query.exec("SELECT COUNT(*) FROM " FOREST_TOMBSTONE_TABLE) && query.next()) {
+        return query.value(0).toInt();
+    }
+    return 0;
+}
+
+QStringList ForestDeletionJob::pendingForestGuids(QSqlDatabase db)
+{
+    QStringList forestGuids;
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    // No table yet means no tombstone
+    if (query.exec("SELECT forest_guid FROM " FOREST_TOMBSTONE_TABLE)) {
+        while (query.next()) {
+            forestGuids.append(query.value(0).toString());
+        }
+    }
+    return forestGuids;
+}
+
+void ForestDeletionJob::start()
+{
+    if (m_isRunning) {
+        return;
+    }
+    m_isRunning = true;
+    scheduleNextStage(0);
+}
+
+void ForestDeletionJob::stop()
+{
+    m_isRunning = false;
+}
+
+void ForestDeletionJob::scheduleNextStage(int ms)
+{
+    QTimer::singleShot(ms, this, SLOT(processStage()));
+}
+
+void ForestDeletionJob::processStage()
+{
+    if (!m_isRunning) {
+        return;
+    }
+
+    QSqlDatabase db = databaseForCurrentThread(m_db);
+    bool isTableCreated = m_databaseWriter ? m_databaseWriter->write("create forest tombstone table", createTableIfNotExists)
+                                           : createTableIfNotExists(db);
+    if (!isTableCreated) {
+        m_isRunning = false;
+        return;
+    }
+
+    QSqlQuery query(db);
+    if (!query.exec("SELECT forest_guid, stage FROM " FOREST_TOMBSTONE_TABLE " ORDER BY deleted_at LIMIT 1")) {
+        QLOG_ERROR() << "Cannot read forest tombstones:" << query.lastError().text();
+        scheduleNextStage(RETRY_INTERVAL_MS);
+        return;
+    }
+    if (!query.next()) {
+        QLOG_SUPPORT() << "No more deleted forests to clean up";
+        m_isRunning = false;
+        return;
+    }
+
+    const QString forestGuid = query.value(0).toString();
+    const int stage = query.value(1).toInt();
+    query.finish();
+
+    bool isTombstoneGone = false;
+    auto deleteStage = [&](QSqlDatabase db) -> bool {
+        // Forest may have been deleted again (stage reset) since the tombstone was read
+        QSqlQuery check(db);
+        check.prepare("SELECT 1 FROM " FOREST_TOMBSTONE_TABLE " WHERE forest_guid = ? AND stage = ?");
+        check.addBindValue(forestGuid);
+        check.addBindValue(stage);
+        if (!check.exec()) {
+            return false;
+        }
+        if (!check.next()) {
+            isTombstoneGone = true;
+            return true;
+        }
+        check.finish();
+
+        if (!runStage(forestGuid, stage, db)) {
+            return false;
+        }
+        if (stage + 1 >= DoneStage) {
+            return removeTombstone(forestGuid, db);
+        }
+
+        QSqlQuery update(db);
+        update.prepare("UPDATE " FOREST_TOMBSTONE_TABLE " SET stage = ? WHERE forest_guid = ?");
+        update.addBindValue(stage + 1);
+        update.addBindValue(forestGuid);
+        return update.exec();
+    };
+    // write() waits for the operation, so it may use the locals by reference
+    bool ok = m_databaseWriter ? m_databaseWriter->write("delete forest data stage", deleteStage)
+                               : DatabaseUtil::inTransaction(db, "delete forest data stage", deleteStage);
+
+    if (!ok) {
+        QLOG_ERROR() << "Cannot delete data of forest" << forestGuid << "stage" << stage << ", will retry later";
+        scheduleNextStage(RETRY_INTERVAL_MS);
+        return;
+    }
+    if (isTombstoneGone) {
+        scheduleNextStage(0);
+        return;
+    }
+
+    emit progress(forestGuid, stage + 1);
+    if (stage + 1 >= DoneStage) {
+        QLOG_SUPPORT() << "Deleted data of forest" << forestGuid;
+        emit finished(forestGuid);
+    }
+    scheduleNextStage(m_stageIntervalMs);
+}
+
+bool ForestDeletionJob::runStage(const QString& forestGuid, int stage, QSqlDatabase db)
+{
+    bool ret = true;
+    switch (stage) {
+    case MarkUsersDeletedStage:
+        ret = ActiveDirectoryUserDao::markDeletedAllOfForest(forestGuid, db);
+        break;
+    case DeleteMainGroupsStage:
+        ret = ActiveDirectoryGroupDao::deleteMainGroupsOfForest(forestGuid, db);
+        break;
+    case MarkGroupsDeletedStage:
+        ret = ActiveDirectoryGroupDao::markDeletedAllOfForest(forestGuid, db);
+        break;
+    case DeleteGroupMembershipsStage:
+        ret = ForestGroupMembershipDao::deleteOfForest(forestGuid, db);
+        break;
+    default:
+        break;
+    }
+    if (!ret) {
+        QLOG_ERROR() << "Cannot run stage" << stage << "of data deletion of forest" << forestGuid;
+    }
+    return ret;
+}
+
+} // namespace ActiveDirectory
@@ -0,0 +1,75 @@
+#ifndef FORESTDELETIONJOB_H
+#define FORESTDELETIONJOB_H
+#include <QObject>
+#include <QSqlDatabase>
+#include <QSharedPointer>
+#include <QStringList>
+
+namespace ActiveDirectory {
+
+class DatabaseWriter;
+
+/*
+ * Deletes data of deleted forests in the background. When a forest is deleted from configuration
+ * only its row and sync contexts are removed and a tombstone is written in the same transaction.
+ * This job then runs the cascade of the DAOs (mark users deleted, delete main groups, mark groups
+ * deleted, delete group memberships) one stage per transaction, outside of the config push.
+ * The stage is stored in the tombstone, so the job resumes where it stopped after a restart.
+ * Every stage is idempotent.
+ * A forest added again keeps its tombstone: it is not synced until the job finishes it (see
+ * DomainControllerManager::isDeletionPending()), so the cascade never touches new data.
+ * With a DatabaseWriter set the stages are written on its thread, otherwise on the job's one.
+ */
+class ForestDeletionJob : public QObject
+{
+    Q_OBJECT
+public:
+    enum Stage {
+        MarkUsersDeletedStage = 0,
+        DeleteMainGroupsStage,
+        MarkGroupsDeletedStage,
+        DeleteGroupMembershipsStage,
+        DoneStage
+    };
+
+    explicit ForestDeletionJob(QObject *parent = nullptr);
+
+    void setDatabase(const QSqlDatabase& db);
+    void setDatabaseWriter(QSharedPointer<DatabaseWriter> writer);
+    // Pause between stages so other writers can get the database
+    void setStageInterval(int ms);
+    bool isRunning() const;
+
+    // Call inside the transaction which deletes the forest
+    static bool tombstone(const QString& forestGuid, QSqlDatabase db);
+    static bool removeTombstone(const QString& forestGuid, QSqlDatabase db);
+    static int pendingCount(QSqlDatabase db);
+    static QStringList pendingForestGuids(QSqlDatabase db);
+
+public slots:
+    // Resumes processing of pending tombstones, does nothing if already running
+    void start();
+    void stop();
+
+signals:
+    // 'stage' is the next stage to run
+    void progress(const QString& forestGuid, int stage);
+    void finished(const QString& forestGuid);
+
+private slots:
+    void processStage();
+
+private:
+    static bool createTableIfNotExists(QSqlDatabase db);
+    static bool runStage(const QString& forestGuid, int stage, QSqlDatabase db);
+    void scheduleNextStage(int ms);
+
+    QSqlDatabase m_db;
+    QSharedPointer<DatabaseWriter> m_databaseWriter;
+    int m_stageIntervalMs;
+    bool m_isRunning;
+};
+
+} // namespace ActiveDirectory
+
+#endif // FORESTDELETIONJOB_H
@@ -0,0 +1,151 @@
+#include "ForestDiff.h"
+#include <QHash>
+#include <algorithm>
+#include <QsLog.h>
+#include "ObjectGuid.h"
+
+namespace ActiveDirectory {
+
+namespace {
+
+// FNV-1a 64 bit over the serialized fields, every field is prefixed by its length
+// so that moving characters from one field to the next changes the hash
+class ContentHasher {
+public:
+    ContentHasher() : m_hash(Q_UINT64_C(0xcbf29ce484222325)) {}
+
+    void add(const QString& str)
+    {
+        add(static_cast<quint64>(str.size()));
+        addBytes(reinterpret_cast<const uchar *>(str.constData()), str.size() * static_cast<int>(sizeof(QChar)));
+    }
+
+    void add(quint64 value)
+    {
+        uchar bytes[sizeof(value)];
+        for (uint i = 0; i < sizeof(value); ++i) {
+            bytes[i] = static_cast<uchar>(value >> (i * 8));
+        }
+        addBytes(bytes, sizeof(value));
+    }
+
+    quint64 result() const
+    {
+        return m_hash;
+    }
+
+private:
+    void addBytes(const uchar *bytes, int size)
+    {
+        for (int i = 0; i < size; ++i) {
+            m_hash ^= bytes[i];
+            m_hash *= Q_UINT64_C(0x100000001b3);
+        }
+    }
+
+    quint64 m_hash;
+};
+
+} // anonymous namespace
+
+quint64 ForestDiff::contentHash(const Forest& forest)
+{
+    ContentHasher hasher;
+    hasher.add(forest.objectGuid);
+    hasher.add(forest.userName);
+    hasher.add(forest.password);
+    hasher.add(forest.syncGroup);
+
+    // DCs are matched by host, so their order does not matter: hash each one and add them sorted
+    QVector<quint64> dcHashes;
+    dcHashes.reserve(forest.domainControllers.size());
+    foreach (const DomainController& dc, forest.domainControllers) {
+        ContentHasher dcHasher;
+        // dnsName is learned locally by probing, ForestComparator does not look at it
+        dcHasher.add(dc.host);
+        dcHasher.add(static_cast<quint64>(dc.isPrimary ? 1 : 0));
+        dcHashes.append(dcHasher.result());
+    }
+    std::sort(dcHashes.begin(), dcHashes.end());
+    hasher.add(static_cast<quint64>(dcHashes.size()));
+    foreach (quint64 dcHash, dcHashes) {
+        hasher.add(dcHash);
+    }
+    return hasher.result();
+}
+
+QVector<quint64> ForestDiff::contentHashes(const QVector<Forest>& forests)
+{
+    QVector<quint64> ret;
+    ret.reserve(forests.size());
+    foreach (const Forest& forest, forests) {
+        ret.append(contentHash(forest));
+    }
+    return ret;
+}
+
+bool ForestDiff::compare(const QVector<Forest>& oldForests, const QVector<quint64>& oldHashes,
+                         const QVector<Forest>& newForests, QVector<ForestComparator::ForestWithChange> *changes,
+                         QVector<quint64> *outNewHashes)
+{
+    QVector<quint64> newHashes = contentHashes(newForests);
+    if (outNewHashes) {
+        *outNewHashes = newHashes;
+    }
+    if (oldHashes.size() != oldForests.size()) {
+        QLOG_ERROR() << "Forest content hashes are out of date, using full comparison";
+        return ForestComparator::compare(oldForests, newForests, changes);
+    }
+
+    // Binary guids hash and compare as integers, a forest whose guid is not a guid is left to ForestComparator
+    QHash<ObjectGuid, int> oldIndexByGuid;
+    oldIndexByGuid.reserve(oldForests.size());
+    for (int i = 0; i < oldForests.size(); ++i) {
+        ObjectGuid guid = ObjectGuid::fromString(oldForests[i].objectGuid);
+        if (guid.isNull()) {
+            QLOG_ERROR() << "Forest guid" << oldForests[i].objectGuid << "is not a guid, using full comparison";
+            return ForestComparator::compare(oldForests, newForests, changes);
+        }
+        oldIndexByGuid.insert(guid, i);
+    }
+
+    QVector<bool> isOldMatched(oldForests.size(), false);
+    QVector<Forest> oldChanged;
+    QVector<Forest> newChanged;
+    for (int i = 0; i < newForests.size(); ++i) {
+        ObjectGuid guid = ObjectGuid::fromString(newForests[i].objectGuid);
+        if (guid.isNull()) {
+            QLOG_ERROR() << "Forest guid" << newForests[i].objectGuid << "is not a guid, using full comparison";
+            return ForestComparator::compare(oldForests, newForests, changes);
+        }
+        int oldIndex = oldIndexByGuid.value(guid, -1);
+        if (oldIndex == -1) {
+            newChanged.append(newForests[i]);
+            continue;
+        }
+        if (isOldMatched[oldIndex]) {
+            // Duplicated guid, let ForestComparator handle it the way it always did
+            QLOG_ERROR() << "Duplicated forest guid" << newForests[i].objectGuid << ", using full comparison";
+            return ForestComparator::compare(oldForests, newForests, changes);
+        }
+        isOldMatched[oldIndex] = true;
+        if (oldHashes[oldIndex] != newHashes[i]) {
+            oldChanged.append(oldForests[oldIndex]);
+            newChanged.append(newForests[i]);
+        }
+    }
+    for (int i = 0; i < oldForests.size(); ++i) {
+        if (!isOldMatched[i]) {
+            oldChanged.append(oldForests[i]);
+        }
+    }
+
+    if (oldChanged.isEmpty() && newChanged.isEmpty()) {
+        return false;
+    }
+    QLOG_SUPPORT() << "Comparing" << newChanged.size() << "new/changed and" << oldChanged.size() << "old/changed of"
+                   << newForests.size() << "forests";
+    return ForestComparator::compare(oldChanged, newChanged, changes);
+}
+
+} // namespace ActiveDirectory
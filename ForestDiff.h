@@ -0,0 +1,31 @@
+#ifndef FORESTDIFF_H
+#define FORESTDIFF_H
+#include <QVector>
+#include "qliqdirect/shared/ActiveDirectoryDataTypes.h"
+#include "AdForestComparator.h"
+
+namespace ActiveDirectory {
+
+/*
+ * Linear time front end of ForestComparator::compare(). Forests are matched by binary objectGuid
+ * through a hash index and a 64 bit content hash per forest detects unchanged forests without
+ * deep comparison. Only added, deleted and changed forests are passed to ForestComparator,
+ * so for small churn the deep comparison runs on a handful of forests.
+ */
+class ForestDiff {
+public:
+    // FNV-1a hash of the forest fields ForestComparator looks at (guid, credentials, sync group and
+    // host and primary flag of each DC), domain controller order does not matter
+    static quint64 contentHash(const Forest& forest);
+    static QVector<quint64> contentHashes(const QVector<Forest>& forests);
+
+    // Returns true if there is any change, like ForestComparator::compare().
+    // 'oldHashes' must be contentHashes(oldForests), 'outNewHashes' (optional) receives contentHashes(newForests)
+    static bool compare(const QVector<Forest>& oldForests, const QVector<quint64>& oldHashes,
+                        const QVector<Forest>& newForests, QVector<ForestComparator::ForestWithChange> *changes,
+                        QVector<quint64> *outNewHashes = nullptr);
+};
+
+} // namespace ActiveDirectory
+
+#endif // FORESTDIFF_H
@@ -0,0 +1,164 @@
+#include "ForestMetrics.h"
+#include <QSaveFile>
+#include <QTextStream>
+#include <QStringList>
+#include <QsLog.h>
+
+namespace ActiveDirectory {
+
+QAtomicInt ForestMetrics::s_isEnabled(0);
+
+namespace {
+
+const double BUCKET_BOUNDS_MS[] = { 5, 10, 25, 50, 100, 250, 500, 1000, 2500, 5000, 10000, 30000, 60000 };
+const int BUCKET_COUNT = sizeof(BUCKET_BOUNDS_MS) / sizeof(BUCKET_BOUNDS_MS[0]);
+
+QString withLabels(const QString& name, const QString& labels, const QString& extraLabel = QString())
+{
+    QStringList all;
+    if (!labels.isEmpty()) {
+        all.append(labels);
+    }
+    if (!extraLabel.isEmpty()) {
+        all.append(extraLabel);
+    }
+    return all.isEmpty() ? name : QString("%1{%2}").arg(name, all.join(","));
+}
+
+} // anonymous namespace
+
+ForestMetrics::Histogram::Histogram() :
+    bucketCounts(BUCKET_COUNT + 1, 0),  // last one is +Inf
+    count(0),
+    sum(0)
+{
+}
+
+ForestMetrics::ForestMetrics()
+{
+}
+
+ForestMetrics *ForestMetrics::instance()
+{
+    static ForestMetrics metrics;
+    return &metrics;
+}
+
+void ForestMetrics::setEnabled(bool on)
+{
+    s_isEnabled.store(on ? 1 : 0);
+}
+
+void ForestMetrics::observe(const char *name, const QString& labels, double valueMs)
+{
+    if (!isEnabled()) {
+        return;
+    }
+
+    int bucket = 0;
+    while (bucket < BUCKET_COUNT && valueMs > BUCKET_BOUNDS_MS[bucket]) {
+        ++bucket;
+    }
+
+    QMutexLocker locker(&m_mutex);
+    Histogram& histogram = m_histograms[QLatin1String(name)][labels];
+    histogram.bucketCounts[bucket]++;
+    histogram.count++;
+    histogram.sum += valueMs;
+}
+
+void ForestMetrics::increment(const char *name, const QString& labels, qint64 by)
+{
+    if (!isEnabled()) {
+        return;
+    }
+
+    QMutexLocker locker(&m_mutex);
+    m_counters[QLatin1String(name)][labels] += by;
+}
+
+qint64 ForestMetrics::counter(const char *name, const QString& labels) const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_counters.value(QLatin1String(name)).value(labels, 0);
+}
+
+ForestMetrics::Histogram ForestMetrics::histogram(const char *name, const QString& labels) const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_histograms.value(QLatin1String(name)).value(labels);
+}
+
+QVector<double> ForestMetrics::bucketBounds()
+{
+    QVector<double> ret;
+    for (int i = 0; i < BUCKET_COUNT; ++i) {
+        ret.append(BUCKET_BOUNDS_MS[i]);
+    }
+    return ret;
+}
+
+QString ForestMetrics::toPrometheusText() const
+{
+    QString text;
+    QTextStream out(&text);
+
+    QMutexLocker locker(&m_mutex);
+    for (auto it = m_counters.constBegin(); it != m_counters.constEnd(); ++it) {
+        out << "# TYPE " << it.key() << " counter\n";
+        for (auto lit = it.value().constBegin(); lit != it.value().constEnd(); ++lit) {
+            out << withLabels(it.key(), lit.key()) << " " << lit.value() << "\n";
+        }
+    }
+    for (auto it = m_histograms.constBegin(); it != m_histograms.constEnd(); ++it) {
+        out << "# TYPE " << it.key() << " histogram\n";
+        for (auto lit = it.value().constBegin(); lit != it.value().constEnd(); ++lit) {
+            const Histogram& histogram = lit.value();
+            qint64 cumulative = 0;
+            for (int i = 0; i <= BUCKET_COUNT; ++i) {
+                cumulative += histogram.bucketCounts[i];
+                QString le = (i < BUCKET_COUNT) ? QString::number(BUCKET_BOUNDS_MS[i]) : QString("+Inf");
+                out << withLabels(it.key() + "_bucket", lit.key(), QString("le=\"%1\"").arg(le)) << " " << cumulative << "\n";
+            }
+            out << withLabels(it.key() + "_sum", lit.key()) << " " << histogram.sum << "\n";
+            out << withLabels(it.key() + "_count", lit.key()) << " " << histogram.count << "\n";
+        }
+    }
+    out.flush();
+    return text;
+}
+
+/*
+ * File is replaced atomically, so a scraper never reads half written metrics.
+ * Not opened in text mode, the exposition format wants \n line endings on Windows too.
+ */
+bool ForestMetrics::writePrometheusFile(const QString& path) const
+{
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        QLOG_ERROR() << "Cannot open metrics file" << path << file.errorString();
+        return false;
+    }
+    file.write(toPrometheusText().toUtf8());
+    if (!file.commit()) {
+        QLOG_ERROR() << "Cannot write metrics file" << path << file.errorString();
+        return false;
+    }
+    return true;
+}
+
+void ForestMetrics::clear()
+{
+    QMutexLocker locker(&m_mutex);
+    m_counters.clear();
+    m_histograms.clear();
+}
+
+QString ForestMetrics::label(const char *name, const QString& value)
+{
+    QString escaped = value;
+    escaped.replace("\\", "\\\\").replace("\"", "\\\"").replace("\n", "\\n");
+    return QString("%1=\"%2\"").arg(QLatin1String(name), escaped);
+}
+
+} // namespace ActiveDirectory
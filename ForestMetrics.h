@@ -0,0 +1,100 @@
+#ifndef FORESTMETRICS_H
+#define FORESTMETRICS_H
+#include <QHash>
+#include <QVector>
+#include <QMutex>
+#include <QAtomicInt>
+#include <QElapsedTimer>
+
+namespace ActiveDirectory {
+
+/*
+ * Counters and latency histograms of DC selection and forest configuration writes.
+ * Disabled by default; when disabled every record call returns after one relaxed atomic load.
+ * Metrics can be read through counter()/histogram() or dumped in Prometheus text format.
+ */
+class ForestMetrics {
+public:
+    struct Histogram {
+        QVector<qint64> bucketCounts;   // cumulative is computed on export, these are per bucket
+        qint64 count;
+        double sum;
+
+        Histogram();
+    };
+
+    static ForestMetrics *instance();
+
+    static inline bool isEnabled()
+    {
+        return s_isEnabled.load() != 0;
+    }
+    static void setEnabled(bool on);
+
+    // 'labels' in Prometheus form without braces, i.e. host="dc1",result="ok"
+    void observe(const char *name, const QString& labels, double valueMs);
+    void increment(const char *name, const QString& labels, qint64 by = 1);
+
+    qint64 counter(const char *name, const QString& labels = QString()) const;
+    Histogram histogram(const char *name, const QString& labels = QString()) const;
+    static QVector<double> bucketBounds();
+
+    QString toPrometheusText() const;
+    bool writePrometheusFile(const QString& path) const;
+    void clear();
+
+    static QString label(const char *name, const QString& value);
+
+private:
+    ForestMetrics();
+
+    static QAtomicInt s_isEnabled;
+
+    mutable QMutex m_mutex;
+    // name -> labels -> value
+    QHash<QString, QHash<QString, qint64> > m_counters;
+    QHash<QString, QHash<QString, Histogram> > m_histograms;
+};
+
+/*
+ * Measures time from construction to observe() only when metrics are enabled
+ */
+class ForestMetricsTimer {
+public:
+    ForestMetricsTimer() :
+        m_isEnabled(ForestMetrics::isEnabled())
+    {
+        if (m_isEnabled) {
+            m_timer.start();
+        }
+    }
+
+    bool isEnabled() const
+    {
+        return m_isEnabled;
+    }
+
+    void observe(const char *name, const QString& labels = QString())
+    {
+        if (m_isEnabled) {
+            ForestMetrics::instance()->observe(name, labels, m_timer.nsecsElapsed() / 1000000.0);
+        }
+    }
+
+private:
+    bool m_isEnabled;
+    QElapsedTimer m_timer;
+};
+
+} // namespace ActiveDirectory
+
+// Metric names
+#define METRIC_DC_PROBE_DURATION "ad_dc_probe_duration_ms"
+#define METRIC_DC_PROBE_TOTAL "ad_dc_probe_total"
+#define METRIC_NEXT_FOREST_DURATION "ad_next_forest_duration_ms"
+#define METRIC_CONFIG_TRANSACTION_DURATION "ad_forest_config_transaction_duration_ms"
+#define METRIC_CONFIG_TRANSACTION_TOTAL "ad_forest_config_transaction_total"
+#define METRIC_CONFIG_ROWS_AFFECTED_TOTAL "ad_forest_config_rows_affected_total"
+#define METRIC_CONFIG_LOAD_DURATION "ad_forest_config_load_duration_ms"
+
+#endif // FORESTMETRICS_H
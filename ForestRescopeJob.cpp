@@ -0,0 +1,236 @@
+#include "ForestRescopeJob.h"
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QVariant>
+#include <QsLog.h>
+#include "db/DatabaseUtil.h"
+#include "ForestSchema.h"
+#include "ThreadDatabase.h"
+
+#define FOREST_RESCOPE_TABLE "active_directory_forest_rescope"
+
+namespace ActiveDirectory {
+
+ForestRescopeJob::ForestRescopeJob(QSharedPointer<GroupMembershipSource> source, const QSqlDatabase& db) :
+    m_source(source),
+    m_db(db)
+{
+}
+
+bool ForestRescopeJob::createTableIfNotExists(QSqlDatabase db)
+{
+    QSqlQuery query(db);
+    bool ret = query.exec("CREATE TABLE IF NOT EXISTS " FOREST_RESCOPE_TABLE " ("
+                          " forest_guid TEXT PRIMARY KEY,"
+                          " old_sync_group TEXT NOT NULL,"
+                          " new_sync_group TEXT NOT NULL,"
+                          " created_at INTEGER NOT NULL)");
+    if (!ret) {
+        QLOG_ERROR() << "Cannot create table" << FOREST_RESCOPE_TABLE << query.lastError().text();
+    }
+    return ret;
+}
+
+bool ForestRescopeJob::schedule(const QVariantList& forestGuids, const QVariantList& newSyncGroups, QSqlDatabase db)
+{
+    if (forestGuids.isEmpty()) {
+        return true;
+    }
+    if (!createTableIfNotExists(db)) {
+        return false;
+    }
+
+    // Old sync group is read from the forest row, so this must run before it is updated
+    QVariantList createdAt;
+    for (int i = 0; i < forestGuids.size(); ++i) {
+        createdAt.append(QDateTime::currentMSecsSinceEpoch());
+    }
+    QSqlQuery insert(db);
+    insert.prepare("INSERT OR IGNORE INTO " FOREST_RESCOPE_TABLE " (forest_guid, old_sync_group, new_sync_group, created_at)"
+                   " SELECT " FOREST_OBJECT_GUID_COLUMN ", " FOREST_SYNC_GROUP_COLUMN ", ?, ? FROM " FOREST_TABLE
+                   " WHERE " FOREST_OBJECT_GUID_COLUMN " = ?");
+    insert.addBindValue(newSyncGroups);
+    insert.addBindValue(createdAt);
+    insert.addBindValue(forestGuids);
+    if (!insert.execBatch()) {
+        QLOG_ERROR() << "Cannot schedule rescope of forests:" << insert.lastError().text();
+        return false;
+    }
+
+    QSqlQuery update(db);
+    update.prepare("UPDATE " FOREST_RESCOPE_TABLE " SET new_sync_group = ? WHERE forest_guid = ?");
+    update.addBindValue(newSyncGroups);
+    update.addBindValue(forestGuids);
+    if (!update.execBatch()) {
+        QLOG_ERROR() << "Cannot schedule rescope of forests:" << update.lastError().text();
+        return false;
+    }
+    return true;
+}
+
+bool ForestRescopeJob::cancel(const QStringList& forestGuids, QSqlDatabase db)
+{
+    if (forestGuids.isEmpty()) {
+        return true;
+    }
+    if (!createTableIfNotExists(db)) {
+        return false;
+    }
+
+    QVariantList values;
+    foreach (const QString& forestGuid, forestGuids) {
+        values.append(forestGuid);
+    }
+    QSqlQuery query(db);
+    query.prepare("DELETE FROM " FOREST_RESCOPE_TABLE " WHERE forest_guid = ?");
+    query.addBindValue(values);
+    bool ret = query.execBatch();
+    if (!ret) {
+        QLOG_ERROR() << "Cannot cancel rescope of forests:" << query.lastError().text();
+    }
+    return ret;
+}
+
+QVector<ForestRescope> ForestRescopeJob::pending(QSqlDatabase db)
+{
+    QVector<ForestRescope> ret;
+    if (!createTableIfNotExists(db)) {
+        return ret;
+    }
+
+    QSqlQuery query(db);
+    if (!query.exec("SELECT forest_guid, old_sync_group, new_sync_group, created_at FROM " FOREST_RESCOPE_TABLE " ORDER BY created_at")) {
+        QLOG_ERROR() << "Cannot read pending forest rescopes:" << query.lastError().text();
+        return ret;
+    }
+    while (query.next()) {
+        ForestRescope rescope;
+        rescope.forestGuid = query.value(0).toString();
+        rescope.oldSyncGroup = query.value(1).toString();
+        rescope.newSyncGroup = query.value(2).toString();
+        rescope.createdAt = QDateTime::fromMSecsSinceEpoch(query.value(3).toLongLong());
+        ret.append(rescope);
+    }
+    return ret;
+}
+
+ForestRescope ForestRescopeJob::pendingOf(const QString& forestGuid, QSqlDatabase db)
+{
+    foreach (const ForestRescope& rescope, pending(db)) {
+        if (rescope.forestGuid == forestGuid) {
+            return rescope;
+        }
+    }
+    return ForestRescope();
+}
+
+void ForestRescopeJob::delta(const QSet<QString>& oldMembers, const QSet<QString>& newMembers,
+                             QStringList *entering, QStringList *leaving)
+{
+    foreach (const QString& guid, newMembers) {
+        if (!oldMembers.contains(guid)) {
+            entering->append(guid);
+        }
+    }
+    foreach (const QString& guid, oldMembers) {
+        if (!newMembers.contains(guid)) {
+            leaving->append(guid);
+        }
+    }
+}
+
+bool ForestRescopeJob::run(const Forest& forest, const DomainController& dc, FetchFunction fetch)
+{
+    QSqlDatabase db = databaseForCurrentThread(m_db);
+    ForestRescope rescope = pendingOf(forest.objectGuid, db);
+    if (rescope.forestGuid.isEmpty()) {
+        return true;
+    }
+    QLOG_SUPPORT() << "Rescoping forest" << forest.objectGuid << "from sync group" << rescope.oldSyncGroup << "to" << rescope.newSyncGroup;
+
+    QSet<QString> oldUsers, oldGroups, newUsers, newGroups;
+    QString errorMsg;
+    if (!m_source->scopeMembers(forest, dc, rescope.oldSyncGroup, &oldUsers, &oldGroups, &errorMsg)) {
+        QLOG_ERROR() << "Cannot read members of old sync group" << rescope.oldSyncGroup << errorMsg << ", falling back to full sync";
+        return fallBackToFullSync(rescope);
+    }
+    if (!m_source->scopeMembers(forest, dc, rescope.newSyncGroup, &newUsers, &newGroups, &errorMsg)) {
+        QLOG_ERROR() << "Cannot read members of new sync group" << rescope.newSyncGroup << errorMsg << ", will retry";
+        return false;
+    }
+
+    QStringList enteringUsers, leavingUsers, enteringGroups, leavingGroups;
+    delta(oldUsers, newUsers, &enteringUsers, &leavingUsers);
+    delta(oldGroups, newGroups, &enteringGroups, &leavingGroups);
+    QLOG_SUPPORT() << "Users entering scope:" << enteringUsers.size() << "leaving:" << leavingUsers.size()
+                   << "groups entering:" << enteringGroups.size() << "leaving:" << leavingGroups.size();
+
+    if ((!enteringUsers.isEmpty() || !enteringGroups.isEmpty()) && !fetch(forest, dc, enteringUsers, enteringGroups)) {
+        QLOG_ERROR() << "Cannot fetch users and groups entering scope of forest" << forest.objectGuid << ", will retry";
+        return false;
+    }
+
+    return DatabaseUtil::inTransaction(db, "rescope AD forest", [&](QSqlDatabase db) -> bool {
+        if (!markDeleted(AD_USER_TABLE, AD_USER_FOREST_GUID_COLUMN, AD_USER_OBJECT_GUID_COLUMN, AD_USER_IS_DELETED_COLUMN,
+                         forest.objectGuid, leavingUsers, db) ||
+            !markDeleted(AD_GROUP_TABLE, AD_GROUP_FOREST_GUID_COLUMN, AD_GROUP_OBJECT_GUID_COLUMN, AD_GROUP_IS_DELETED_COLUMN,
+                         forest.objectGuid, leavingGroups, db)) {
+            return false;
+        }
+
+        // Sync group may have changed again meanwhile, then continue from the scope applied now
+        QSqlQuery query(db);
+        query.prepare("UPDATE " FOREST_RESCOPE_TABLE " SET old_sync_group = ? WHERE forest_guid = ? AND new_sync_group != ?");
+        query.addBindValue(rescope.newSyncGroup);
+        query.addBindValue(rescope.forestGuid);
+        query.addBindValue(rescope.newSyncGroup);
+        QSqlQuery done(db);
+        done.prepare("DELETE FROM " FOREST_RESCOPE_TABLE " WHERE forest_guid = ? AND new_sync_group = ?");
+        done.addBindValue(rescope.forestGuid);
+        done.addBindValue(rescope.newSyncGroup);
+        return query.exec() && done.exec();
+    });
+}
+
+/*
+ * Same as without incremental rescope: sync contexts are deleted, so next sync is a full one
+ */
+bool ForestRescopeJob::fallBackToFullSync(const ForestRescope& rescope)
+{
+    QSqlDatabase db = databaseForCurrentThread(m_db);
+    return DatabaseUtil::inTransaction(db, "rescope AD forest with full sync", [&rescope](QSqlDatabase db) -> bool {
+        QSqlQuery deleteSyncContexts(db);
+        deleteSyncContexts.prepare("DELETE FROM " SYNC_CONTEXT_TABLE " WHERE " SYNC_CONTEXT_FOREST_GUID_COLUMN " = ?");
+        deleteSyncContexts.addBindValue(rescope.forestGuid);
+        return deleteSyncContexts.exec() && cancel(QStringList() << rescope.forestGuid, db);
+    });
+}
+
+bool ForestRescopeJob::markDeleted(const QString& table, const QString& forestGuidColumn, const QString& objectGuidColumn,
+                                   const QString& isDeletedColumn, const QString& forestGuid, const QStringList& objectGuids,
+                                   QSqlDatabase db)
+{
+    const int chunkSize = MAX_BOUND_VALUES_PER_STATEMENT - 1;
+    for (int offset = 0; offset < objectGuids.size(); offset += chunkSize) {
+        int count = qMin(chunkSize, objectGuids.size() - offset);
+
+        QString placeholders;
+        for (int i = 0; i < count; ++i) {
+            placeholders += (i == 0) ? "?" : ", ?";
+        }
+        QSqlQuery query(db);
+        query.prepare(QString("UPDATE %1 SET %2 = 1 WHERE %3 = ? AND %4 IN (%5)")
+                      .arg(table, isDeletedColumn, forestGuidColumn, objectGuidColumn, placeholders));
+        query.addBindValue(forestGuid);
+        for (int i = offset; i < offset + count; ++i) {
+            query.addBindValue(objectGuids[i]);
+        }
+        if (!query.exec()) {
+            QLOG_ERROR() << "Cannot mark" << table << "rows deleted:" << query.lastError().text();
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace ActiveDirectory
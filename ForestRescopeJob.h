@@ -0,0 +1,74 @@
+#ifndef FORESTRESCOPEJOB_H
+#define FORESTRESCOPEJOB_H
+#include <functional>
+#include <QSet>
+#include <QStringList>
+#include <QVariantList>
+#include <QDateTime>
+#include <QSqlDatabase>
+#include <QSharedPointer>
+#include "qliqdirect/shared/ActiveDirectoryDataTypes.h"
+
+namespace ActiveDirectory {
+
+struct ForestRescope {
+    QString forestGuid;
+    QString oldSyncGroup;       // scope of the data synced so far
+    QString newSyncGroup;
+    QDateTime createdAt;
+};
+
+/*
+ * Reads which users and groups are in scope of a sync group, implemented by the sync engine
+ * on top of ActiveDirectoryApi
+ */
+class GroupMembershipSource {
+public:
+    virtual ~GroupMembershipSource() {}
+
+    virtual bool scopeMembers(const Forest& forest, const DomainController& dc, const QString& syncGroup,
+                              QSet<QString> *userGuids, QSet<QString> *groupGuids, QString *errorMsg) = 0;
+};
+
+/*
+ * Changes scope of a forest after its sync group changed without a full resync.
+ * When incremental rescope is on, ForestChangeBatchWriter keeps sync contexts of the forest
+ * and schedules a rescope instead (in the same transaction). run() then fetches only users and
+ * groups entering the scope and marks those leaving it deleted. If the old scope cannot be
+ * read (i.e. old group was deleted in AD) it falls back to a full resync of the forest.
+ */
+class ForestRescopeJob {
+public:
+    // Fetches (syncs) given users and groups, returns false on failure
+    typedef std::function<bool (const Forest& forest, const DomainController& dc,
+                                const QStringList& userGuids, const QStringList& groupGuids)> FetchFunction;
+
+    ForestRescopeJob(QSharedPointer<GroupMembershipSource> source, const QSqlDatabase& db);
+
+    // Returns false if the rescope should be retried later
+    bool run(const Forest& forest, const DomainController& dc, FetchFunction fetch);
+
+    // Must be called inside the transaction which changes the sync groups.
+    // A rescope already pending keeps its old sync group, it is what was synced.
+    static bool schedule(const QVariantList& forestGuids, const QVariantList& newSyncGroups, QSqlDatabase db);
+    static bool cancel(const QStringList& forestGuids, QSqlDatabase db);
+    static QVector<ForestRescope> pending(QSqlDatabase db);
+    static ForestRescope pendingOf(const QString& forestGuid, QSqlDatabase db);
+
+    static void delta(const QSet<QString>& oldMembers, const QSet<QString>& newMembers,
+                      QStringList *entering, QStringList *leaving);
+
+private:
+    static bool createTableIfNotExists(QSqlDatabase db);
+    bool fallBackToFullSync(const ForestRescope& rescope);
+    static bool markDeleted(const QString& table, const QString& forestGuidColumn, const QString& objectGuidColumn,
+                            const QString& isDeletedColumn, const QString& forestGuid, const QStringList& objectGuids,
+                            QSqlDatabase db);
+
+    QSharedPointer<GroupMembershipSource> m_source;
+    QSqlDatabase m_db;
+};
+
+} // namespace ActiveDirectory
+
+#endif // FORESTRESCOPEJOB_H
@@ -0,0 +1,42 @@
+#ifndef FORESTSCHEMA_H
+#define FORESTSCHEMA_H
+
+/*
+ * Table and column names used by set based queries. They must match ForestDao,
+ * ForestDomainControllerMembershipDao, SyncContextDao, ActiveDirectoryUserDao,
+ * ActiveDirectoryGroupDao and ForestGroupMembershipDao.
+ */
+
+#define FOREST_TABLE "active_directory_forest"
+#define FOREST_OBJECT_GUID_COLUMN "object_guid"
+#define FOREST_USER_NAME_COLUMN "user_name"
+#define FOREST_PASSWORD_COLUMN "password"
+#define FOREST_SYNC_GROUP_COLUMN "sync_group"
+
+#define DC_MEMBERSHIP_TABLE "active_directory_forest_dc_membership"
+#define DC_MEMBERSHIP_FOREST_GUID_COLUMN "forest_guid"
+#define DC_MEMBERSHIP_HOST_COLUMN "host"
+#define DC_MEMBERSHIP_IS_PRIMARY_COLUMN "is_primary"
+#define DC_MEMBERSHIP_FULL_SERVER_NAME_COLUMN "full_server_name"
+
+#define SYNC_CONTEXT_TABLE "active_directory_sync_context"
+#define SYNC_CONTEXT_FOREST_GUID_COLUMN "forest_guid"
+#define SYNC_CONTEXT_DC_HOST_COLUMN "domain_controller_host"
+
+#define AD_USER_TABLE "active_directory_user"
+#define AD_USER_FOREST_GUID_COLUMN "forest_guid"
+#define AD_USER_IS_DELETED_COLUMN "is_deleted"
+#define AD_USER_OBJECT_GUID_COLUMN "object_guid"
+
+#define AD_GROUP_TABLE "active_directory_group"
+#define AD_GROUP_FOREST_GUID_COLUMN "forest_guid"
+#define AD_GROUP_IS_DELETED_COLUMN "is_deleted"
+#define AD_GROUP_OBJECT_GUID_COLUMN "object_guid"
+
+#define FOREST_GROUP_MEMBERSHIP_TABLE "active_directory_forest_group_membership"
+#define FOREST_GROUP_MEMBERSHIP_FOREST_GUID_COLUMN "forest_guid"
+
+// SQLite default SQLITE_MAX_VARIABLE_NUMBER is 999
+#define MAX_BOUND_VALUES_PER_STATEMENT 900
+
+#endif // FORESTSCHEMA_H
@@ -0,0 +1,120 @@
+#include "ForestSchemaMigration.h"
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QVariant>
+#include <QsLog.h>
+#include "db/DatabaseUtil.h"
+#include "ForestSchema.h"
+
+#define SCHEMA_VERSION_TABLE "active_directory_schema_version"
+
+namespace ActiveDirectory {
+
+bool ForestSchemaMigration::isCurrent(QSqlDatabase db)
+{
+    return version(db) >= CurrentVersion;
+}
+
+bool ForestSchemaMigration::run(QSqlDatabase db)
+{
+    return DatabaseUtil::inTransaction(db, "migrate AD forest schema", [](QSqlDatabase db) -> bool {
+        return runWithoutTransaction(db);
+    });
+}
+
+bool ForestSchemaMigration::runWithoutTransaction(QSqlDatabase db)
+{
+    QSqlQuery query(db);
+    if (!query.exec("CREATE TABLE IF NOT EXISTS " SCHEMA_VERSION_TABLE " ("
+                    " id INTEGER PRIMARY KEY CHECK (id = 1),"
+                    " version INTEGER NOT NULL)")) {
+        QLOG_ERROR() << "Cannot create AD schema version table:" << query.lastError().text();
+        return false;
+    }
+
+    int from = version(db);
+    if (from < 1) {
+        if (!dropBinaryKeys(db) || !setVersion(1, db)) {
+            return false;
+        }
+    }
+    if (from < CurrentVersion) {
+        QLOG_SUPPORT() << "Migrated AD forest schema from version" << from << "to" << CurrentVersion;
+    }
+    return true;
+}
+
+/*
+ * 0 if the version was never stored
+ */
+int ForestSchemaMigration::version(QSqlDatabase db)
+{
+    QSqlQuery query(db);
+    if (!query.exec("SELECT version FROM " SCHEMA_VERSION_TABLE " WHERE id = 1") || !query.next()) {
+        return 0;
+    }
+    return query.value(0).toInt();
+}
+
+bool ForestSchemaMigration::setVersion(int version, QSqlDatabase db)
+{
+    QSqlQuery query(db);
+    query.prepare("INSERT OR REPLACE INTO " SCHEMA_VERSION_TABLE " (id, version) VALUES (1, ?)");
+    query.addBindValue(version);
+    bool ret = query.exec();
+    if (!ret) {
+        QLOG_ERROR() << "Cannot store AD schema version" << version << query.lastError().text();
+    }
+    return ret;
+}
+
+bool ForestSchemaMigration::hasColumn(const QString& table, const QString& column, QSqlDatabase db)
+{
+    QSqlQuery query(db);
+    if (!query.exec(QString("PRAGMA table_info(%1)").arg(table))) {
+        QLOG_ERROR() << "Cannot read columns of" << table << query.lastError().text();
+        return false;
+    }
+    while (query.next()) {
+        if (query.value(1).toString() == column) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * SQLite before 3.35 cannot drop columns, there the column stays. It is nullable and
+ * nothing reads or writes it, so the version is stored anyway.
+ */
+bool ForestSchemaMigration::dropColumnIfExists(const QString& table, const QString& column, QSqlDatabase db)
+{
+    if (!hasColumn(table, column, db)) {
+        return true;
+    }
+    QSqlQuery query(db);
+    if (!query.exec(QString("ALTER TABLE %1 DROP COLUMN %2").arg(table, column))) {
+        QLOG_SUPPORT() << "Cannot drop unused column" << column << "of" << table << query.lastError().text();
+    }
+    return true;
+}
+
+/*
+ * Indexes go first, a column in an index cannot be dropped
+ */
+bool ForestSchemaMigration::dropBinaryKeys(QSqlDatabase db)
+{
+    QSqlQuery query(db);
+    bool ret = query.exec("DROP INDEX IF EXISTS " FOREST_TABLE "_object_guid_bin_idx") &&
+               query.exec("DROP INDEX IF EXISTS " DC_MEMBERSHIP_TABLE "_key_idx") &&
+               query.exec("DROP TABLE IF EXISTS active_directory_host");
+    if (!ret) {
+        QLOG_ERROR() << "Cannot drop binary forest keys:" << query.lastError().text();
+        return false;
+    }
+    return dropColumnIfExists(FOREST_TABLE, "object_guid_bin", db) &&
+           dropColumnIfExists(DC_MEMBERSHIP_TABLE, "forest_guid_bin", db) &&
+           dropColumnIfExists(DC_MEMBERSHIP_TABLE, "host_id", db);
+}
+
+} // namespace ActiveDirectory
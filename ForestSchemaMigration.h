@@ -0,0 +1,35 @@
+#ifndef FORESTSCHEMAMIGRATION_H
+#define FORESTSCHEMAMIGRATION_H
+#include <QString>
+#include <QSqlDatabase>
+
+namespace ActiveDirectory {
+
+/*
+ * Versioned changes of the forest tables which are not owned by a DAO. The version is
+ * stored in active_directory_schema_version, a step runs once when the stored version is
+ * older than it.
+ * Version 1 removes the binary forest keys and the active_directory_host table: no reader
+ * used them, ObjectGuid and HostId are built in memory from the text keys.
+ * runWithoutTransaction() is for callers already in a transaction (DatabaseWriter).
+ */
+class ForestSchemaMigration {
+public:
+    enum { CurrentVersion = 1 };
+
+    // Cheap read, true if no step has to run
+    static bool isCurrent(QSqlDatabase db);
+    static bool run(QSqlDatabase db);
+    static bool runWithoutTransaction(QSqlDatabase db);
+
+private:
+    static int version(QSqlDatabase db);
+    static bool setVersion(int version, QSqlDatabase db);
+    static bool hasColumn(const QString& table, const QString& column, QSqlDatabase db);
+    static bool dropColumnIfExists(const QString& table, const QString& column, QSqlDatabase db);
+    static bool dropBinaryKeys(QSqlDatabase db);
+};
+
+} // namespace ActiveDirectory
+
+#endif // FORESTSCHEMAMIGRATION_H
@@ -0,0 +1,204 @@
+#include "ForestSnapshotFile.h"
+#include <QFile>
+#include <QSaveFile>
+#include <QDataStream>
+#include <QHash>
+#include <QRandomGenerator>
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QVariant>
+#include <QsLog.h>
+#include "dao/ActiveDirectoryDao.h"
+#include "ForestSchema.h"
+#include "ForestDiff.h"
+
+#define FOREST_STAMP_TABLE "active_directory_forest_config_stamp"
+#define SNAPSHOT_MAGIC 0x41444653       // "ADFS"
+// Increment when the layout below changes
+#define SNAPSHOT_FORMAT_VERSION 1
+// Smallest records (empty strings): guid, userName, syncGroup, hash, DC count / host, isPrimary, dnsName
+#define MIN_FOREST_RECORD_SIZE (3 * 4 + 8 + 4)
+#define MIN_DC_RECORD_SIZE (4 + 1 + 4)
+
+namespace ActiveDirectory {
+
+namespace {
+
+bool createStampTrigger(QSqlQuery& query, const char *table, const char *operation)
+{
+    QString sql = QString("CREATE TRIGGER IF NOT EXISTS %1_%2_stamp AFTER %3 ON %1 BEGIN"
+                          " UPDATE " FOREST_STAMP_TABLE " SET counter = counter + 1; END")
+            .arg(QLatin1String(table), QString(operation).toLower(), QLatin1String(operation));
+    return query.exec(sql);
+}
+
+} // anonymous namespace
+
+bool ForestSnapshotFile::createStampIfNotExists(QSqlDatabase db)
+{
+    QSqlQuery query(db);
+    bool ret = query.exec("CREATE TABLE IF NOT EXISTS " FOREST_STAMP_TABLE " ("
+                          " id INTEGER PRIMARY KEY CHECK (id = 1),"
+                          " epoch INTEGER NOT NULL,"
+                          " counter INTEGER NOT NULL)");
+    if (ret) {
+        query.prepare("INSERT OR IGNORE INTO " FOREST_STAMP_TABLE " (id, epoch, counter) VALUES (1, ?, 0)");
+        query.addBindValue(static_cast<qint64>(QRandomGenerator::global()->generate64()));
+        ret = query.exec();
+    }
+    ret = ret &&
+          createStampTrigger(query, FOREST_TABLE, "INSERT") &&
+          createStampTrigger(query, FOREST_TABLE, "UPDATE") &&
+          createStampTrigger(query, FOREST_TABLE, "DELETE") &&
+          createStampTrigger(query, DC_MEMBERSHIP_TABLE, "INSERT") &&
+          createStampTrigger(query, DC_MEMBERSHIP_TABLE, "UPDATE") &&
+          createStampTrigger(query, DC_MEMBERSHIP_TABLE, "DELETE");
+    if (!ret) {
+        QLOG_ERROR() << "Cannot create forest configuration stamp:" << query.lastError().text();
+    }
+    return ret;
+}
+
+bool ForestSnapshotFile::readStamp(QSqlDatabase db, ForestConfigurationStamp *outStamp)
+{
+    QSqlQuery query(db);
+    if (!query.exec("SELECT epoch, counter FROM " FOREST_STAMP_TABLE " WHERE id = 1") || !query.next()) {
+        QLOG_ERROR() << "Cannot read forest configuration stamp:" << query.lastError().text();
+        return false;
+    }
+    outStamp->epoch = query.value(0).toLongLong();
+    outStamp->counter = query.value(1).toLongLong();
+    return true;
+}
+
+bool ForestSnapshotFile::write(const QString& path, const ForestConfigurationStamp& stamp, const QVector<Forest>& forests,
+                               const QVector<quint64>& contentHashes)
+{
+    if (!stamp.isValid() || contentHashes.size() != forests.size()) {
+        return false;
+    }
+
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        QLOG_ERROR() << "Cannot open forest configuration snapshot" << path << file.errorString();
+        return false;
+    }
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_9);
+    out << quint32(SNAPSHOT_MAGIC) << quint32(SNAPSHOT_FORMAT_VERSION) << stamp.epoch << stamp.counter << qint32(forests.size());
+    for (int i = 0; i < forests.size(); ++i) {
+        const Forest& forest = forests[i];
+        out << forest.objectGuid << forest.userName << forest.syncGroup << contentHashes[i] << qint32(forest.domainControllers.size());
+        foreach (const DomainController& dc, forest.domainControllers) {
+            out << dc.host << dc.isPrimary << dc.dnsName;
+        }
+    }
+
+    if (out.status() != QDataStream::Ok || !file.commit()) {
+        QLOG_ERROR() << "Cannot write forest configuration snapshot" << path << file.errorString();
+        return false;
+    }
+    return true;
+}
+
+bool ForestSnapshotFile::read(const QString& path, const ForestConfigurationStamp& stamp, QSqlDatabase db,
+                              QVector<Forest> *outForests, QVector<quint64> *outContentHashes)
+{
+    QFile file(path);
+    if (!stamp.isValid() || !file.exists()) {
+        return false;
+    }
+    if (!file.open(QIODevice::ReadOnly)) {
+        QLOG_ERROR() << "Cannot open forest configuration snapshot" << path << file.errorString();
+        return false;
+    }
+    uchar *data = file.map(0, file.size());
+    if (!data) {
+        QLOG_ERROR() << "Cannot map forest configuration snapshot" << path << file.errorString();
+        return false;
+    }
+
+    // No copy of the file, the stream reads the mapped pages
+    QByteArray bytes = QByteArray::fromRawData(reinterpret_cast<const char *>(data), static_cast<int>(file.size()));
+    QDataStream in(bytes);
+    in.setVersion(QDataStream::Qt_5_9);
+
+    quint32 magic = 0, version = 0;
+    ForestConfigurationStamp fileStamp;
+    qint32 count = 0;
+    in >> magic >> version >> fileStamp.epoch >> fileStamp.counter >> count;
+    if (in.status() != QDataStream::Ok || magic != SNAPSHOT_MAGIC || version != SNAPSHOT_FORMAT_VERSION) {
+        QLOG_SUPPORT() << "Forest configuration snapshot" << path << "is of other format, ignoring it";
+        file.unmap(data);
+        return false;
+    }
+    if (fileStamp != stamp) {
+        QLOG_SUPPORT() << "Forest configuration snapshot is out of date, stamp" << fileStamp.counter << "database" << stamp.counter;
+        file.unmap(data);
+        return false;
+    }
+    // Counts are checked against what is left of the file before anything is reserved for them
+    if (count < 0 || count > in.device()->bytesAvailable() / MIN_FOREST_RECORD_SIZE) {
+        QLOG_ERROR() << "Forest configuration snapshot" << path << "has invalid forest count" << count << ", ignoring it";
+        file.unmap(data);
+        return false;
+    }
+
+    QVector<Forest> forests;
+    QVector<quint64> contentHashes;
+    forests.reserve(count);
+    contentHashes.reserve(count);
+    bool isCountValid = true;
+    for (qint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+        Forest forest;
+        quint64 contentHash = 0;
+        qint32 dcCount = 0;
+        in >> forest.objectGuid >> forest.userName >> forest.syncGroup >> contentHash >> dcCount;
+        if (dcCount < 0 || dcCount > in.device()->bytesAvailable() / MIN_DC_RECORD_SIZE) {
+            isCountValid = false;
+            break;
+        }
+        forest.domainControllers.reserve(dcCount);
+        for (qint32 j = 0; j < dcCount && in.status() == QDataStream::Ok; ++j) {
+            DomainController dc;
+            in >> dc.host >> dc.isPrimary >> dc.dnsName;
+            forest.domainControllers.append(dc);
+        }
+        forests.append(forest);
+        contentHashes.append(contentHash);
+    }
+    bool isComplete = (in.status() == QDataStream::Ok);
+    file.unmap(data);
+    if (!isCountValid) {
+        QLOG_ERROR() << "Forest configuration snapshot" << path << "has invalid domain controller count, ignoring it";
+        return false;
+    }
+    if (!isComplete) {
+        QLOG_ERROR() << "Forest configuration snapshot" << path << "is truncated, ignoring it";
+        return false;
+    }
+
+    // Passwords live only in the database, read through ForestDao as it owns their stored format.
+    // A forest it cannot read gets no password and fails the hash check below.
+    QHash<QString, QString> passwords;
+    foreach (const Forest& forest, ForestDao::selectAll(db)) {
+        passwords.insert(forest.objectGuid, forest.password);
+    }
+
+    // Content hash covers every forest setting, a forest restored differently from what was
+    // saved (i.e. a setting this file does not have) rejects the whole snapshot
+    for (int i = 0; i < forests.size(); ++i) {
+        forests[i].password = passwords.value(forests[i].objectGuid);
+        if (ForestDiff::contentHash(forests[i]) != contentHashes[i]) {
+            QLOG_ERROR() << "Forest" << forests[i].objectGuid << "from configuration snapshot does not match its hash, ignoring the snapshot";
+            return false;
+        }
+    }
+
+    *outForests = forests;
+    *outContentHashes = contentHashes;
+    return true;
+}
+
+} // namespace ActiveDirectory
@@ -0,0 +1,47 @@
+#ifndef FORESTSNAPSHOTFILE_H
+#define FORESTSNAPSHOTFILE_H
+#include <QVector>
+#include <QString>
+#include <QSqlDatabase>
+#include "qliqdirect/shared/ActiveDirectoryDataTypes.h"
+
+namespace ActiveDirectory {
+
+/*
+ * Stamp of forest configuration stored in the database. Triggers on the forest and DC membership
+ * tables increment 'counter' on every change, 'epoch' is random per database, so a snapshot
+ * taken from another (or recreated) database never matches.
+ */
+struct ForestConfigurationStamp {
+    qint64 epoch;
+    qint64 counter;
+
+    ForestConfigurationStamp() : epoch(0), counter(-1) {}
+    bool isValid() const { return counter >= 0; }
+    bool operator==(const ForestConfigurationStamp& other) const { return epoch == other.epoch && counter == other.counter; }
+    bool operator!=(const ForestConfigurationStamp& other) const { return !(*this == other); }
+};
+
+/*
+ * Versioned binary copy of the loaded forest configuration (forests with DCs sorted by primary
+ * and their ForestDiff content hashes), so startup does not need the load queries.
+ * The file is memory mapped on read and used only if its stamp matches the database.
+ * Passwords are not written to the file, read() takes them from the database (ForestDao).
+ */
+class ForestSnapshotFile {
+public:
+    // Stamp table and its triggers, call before readStamp()
+    static bool createStampIfNotExists(QSqlDatabase db);
+    static bool readStamp(QSqlDatabase db, ForestConfigurationStamp *outStamp);
+
+    // Replaces the file atomically
+    static bool write(const QString& path, const ForestConfigurationStamp& stamp, const QVector<Forest>& forests,
+                      const QVector<quint64>& contentHashes);
+    // Returns false if the file is missing, of other format version, corrupted or its stamp is not 'stamp'
+    static bool read(const QString& path, const ForestConfigurationStamp& stamp, QSqlDatabase db,
+                     QVector<Forest> *outForests, QVector<quint64> *outContentHashes);
+};
+
+} // namespace ActiveDirectory
+
+#endif // FORESTSNAPSHOTFILE_H
@@ -0,0 +1,203 @@
+#include "ForestSyncScheduler.h"
+#include <QRunnable>
+#include <QThreadPool>
+#include <QElapsedTimer>
+#include <QsLog.h>
+#include "ActiveDirectoryDomainControllerManager.h"
+#include "ThreadDatabase.h"
+
+namespace ActiveDirectory {
+
+struct ForestSyncScheduler::Cycle {
+    const QVector<Forest> *forests;
+    const SyncFunction *sync;
+    QElapsedTimer timer;
+
+    QMutex mutex;
+    QVector<QList<int> > queues;    // forest indexes pending per worker
+    ForestSyncCycleStats stats;
+};
+
+namespace {
+
+class WorkerTask : public QRunnable {
+public:
+    WorkerTask(std::function<void ()> work) :
+        m_work(work)
+    {
+    }
+
+    void run() override
+    {
+        m_work();
+    }
+
+private:
+    std::function<void ()> m_work;
+};
+
+} // anonymous namespace
+
+ForestSyncScheduler::ForestSyncScheduler(DomainControllerManager *manager, int workerCount) :
+    m_manager(manager),
+    m_workerCount(qMax(1, workerCount))
+{
+}
+
+void ForestSyncScheduler::setDatabase(const QSqlDatabase& db)
+{
+    m_db = db;
+}
+
+void ForestSyncScheduler::setWorkerCount(int workerCount)
+{
+    m_workerCount = qMax(1, workerCount);
+}
+
+int ForestSyncScheduler::workerCount() const
+{
+    return m_workerCount;
+}
+
+void ForestSyncScheduler::setInaccessibleForestHandler(const InaccessibleFunction& handler)
+{
+    m_inaccessibleForestHandler = handler;
+}
+
+ForestSyncCycleStats ForestSyncScheduler::runCycle(const QVector<Forest>& forests, const SyncFunction& sync)
+{
+    int workers = qMin(m_workerCount, qMax(1, forests.size()));
+
+    Cycle cycle;
+    cycle.forests = &forests;
+    cycle.sync = &sync;
+    cycle.queues.resize(workers);
+    cycle.stats.workers.resize(workers);
+    for (int i = 0; i < forests.size(); ++i) {
+        cycle.queues[i % workers].append(i);
+    }
+
+    QLOG_SUPPORT() << "Starting sync cycle of" << forests.size() << "forests on" << workers << "workers";
+    cycle.timer.start();
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(workers);
+    for (int worker = 0; worker < workers; ++worker) {
+        pool.start(new WorkerTask([this, &cycle, worker]() {
+            work(&cycle, worker);
+        }));
+    }
+    pool.waitForDone();
+
+    ForestSyncCycleStats& stats = cycle.stats;
+    stats.cycleTimeMs = cycle.timer.elapsed();
+    for (int worker = 0; worker < workers; ++worker) {
+        ForestSyncWorkerStats& ws = stats.workers[worker];
+        ws.utilization = stats.cycleTimeMs > 0 ? static_cast<double>(ws.busyMs) / stats.cycleTimeMs : 0;
+        QLOG_SUPPORT() << "Sync worker" << worker << "processed" << ws.forests << "forests (" << ws.stolen << "stolen), utilization"
+                       << QString::number(ws.utilization * 100, 'f', 1) << "%";
+    }
+    QLOG_SUPPORT() << "Sync cycle finished in" << stats.cycleTimeMs << "ms, succeeded:" << stats.succeeded << "failed:" << stats.failed
+                   << "inaccessible:" << stats.inaccessible << "skipped:" << stats.skipped;
+    return stats;
+}
+
+void ForestSyncScheduler::work(Cycle *cycle, int worker)
+{
+    QSqlDatabase db = databaseForCurrentThread(m_db);
+
+    int forestIndex;
+    bool isStolen;
+    while (takeForest(cycle, worker, &forestIndex, &isStolen)) {
+        Forest forest = cycle->forests->at(forestIndex);
+
+        if (m_manager->isDeletionPending(forest.objectGuid)) {
+            QLOG_SUPPORT() << "Forest" << forest.objectGuid << "is skipped, data of its previous configuration is being deleted";
+            QMutexLocker cycleLocker(&cycle->mutex);
+            cycle->stats.skipped++;
+            continue;
+        }
+
+        {
+            QMutexLocker locker(&m_inProgressMutex);
+            if (m_inProgress.contains(forest.objectGuid)) {
+                locker.unlock();
+                QLOG_SUPPORT() << "Forest" << forest.objectGuid << "is already being synced, skipping";
+                QMutexLocker cycleLocker(&cycle->mutex);
+                cycle->stats.skipped++;
+                continue;
+            }
+            m_inProgress.insert(forest.objectGuid);
+        }
+
+        QElapsedTimer timer;
+        timer.start();
+
+        bool isAccessible = false;
+        bool ok = false;
+        DomainController dc;
+        if (m_manager->selectDomainController(&forest, &dc)) {
+            isAccessible = true;
+            ok = (*cycle->sync)(forest, dc, db);
+        } else {
+            QLOG_ERROR() << "No accessible domain controller for forest" << forest.objectGuid;
+            if (m_inaccessibleForestHandler) {
+                m_inaccessibleForestHandler(forest);
+            }
+        }
+
+        {
+            QMutexLocker locker(&m_inProgressMutex);
+            m_inProgress.remove(forest.objectGuid);
+        }
+
+        QMutexLocker locker(&cycle->mutex);
+        ForestSyncWorkerStats& ws = cycle->stats.workers[worker];
+        ws.busyMs += timer.elapsed();
+        ws.forests++;
+        if (isStolen) {
+            ws.stolen++;
+        }
+        if (!isAccessible) {
+            cycle->stats.inaccessible++;
+        } else if (ok) {
+            cycle->stats.succeeded++;
+        } else {
+            cycle->stats.failed++;
+        }
+    }
+
+    if (db.connectionName() != m_db.connectionName()) {
+        db = QSqlDatabase();
+        removeDatabaseForCurrentThread(m_db);
+    }
+}
+
+/*
+ * Take next forest from own queue (front), or steal from the back of the longest other queue
+ */
+bool ForestSyncScheduler::takeForest(Cycle *cycle, int worker, int *outForestIndex, bool *outIsStolen)
+{
+    QMutexLocker locker(&cycle->mutex);
+    QList<int>& own = cycle->queues[worker];
+    if (!own.isEmpty()) {
+        *outForestIndex = own.takeFirst();
+        *outIsStolen = false;
+        return true;
+    }
+
+    int victim = -1;
+    for (int i = 0; i < cycle->queues.size(); ++i) {
+        if (i != worker && !cycle->queues[i].isEmpty() && (victim == -1 || cycle->queues[i].size() > cycle->queues[victim].size())) {
+            victim = i;
+        }
+    }
+    if (victim == -1) {
+        return false;
+    }
+    *outForestIndex = cycle->queues[victim].takeLast();
+    *outIsStolen = true;
+    return true;
+}
+
+} // namespace ActiveDirectory
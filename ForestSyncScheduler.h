@@ -0,0 +1,74 @@
+#ifndef FORESTSYNCSCHEDULER_H
+#define FORESTSYNCSCHEDULER_H
+#include <functional>
+#include <QVector>
+#include <QSet>
+#include <QMutex>
+#include <QSqlDatabase>
+#include "qliqdirect/shared/ActiveDirectoryDataTypes.h"
+
+namespace ActiveDirectory {
+
+class DomainControllerManager;
+
+struct ForestSyncWorkerStats {
+    int forests;        // forests processed by this worker
+    int stolen;         // of them taken from queues of other workers
+    qint64 busyMs;
+    double utilization; // busyMs / cycle time
+
+    ForestSyncWorkerStats() : forests(0), stolen(0), busyMs(0), utilization(0) {}
+};
+
+struct ForestSyncCycleStats {
+    qint64 cycleTimeMs;
+    int succeeded;
+    int failed;         // sync function returned false
+    int inaccessible;   // no accessible domain controller
+    int skipped;        // forest already being synced by another cycle
+    QVector<ForestSyncWorkerStats> workers;
+
+    ForestSyncCycleStats() : cycleTimeMs(0), succeeded(0), failed(0), inaccessible(0), skipped(0) {}
+};
+
+/*
+ * Processes all forests of a sync cycle on N worker threads, an alternative to iterating
+ * DomainControllerManager::nextForest() from a single thread. Forests are distributed round robin
+ * to per-worker queues, idle workers steal pending forests from the back of the longest queue.
+ * A forest is never synced by two workers at once, even across concurrent runCycle() calls.
+ * Every worker uses its own QSqlDatabase connection cloned from the one given in setDatabase().
+ */
+class ForestSyncScheduler {
+public:
+    typedef std::function<bool (const Forest& forest, const DomainController& dc, QSqlDatabase db)> SyncFunction;
+    // Called on the worker thread for a forest without accessible domain controller, i.e. to alert the admin
+    typedef std::function<void (const Forest& forest)> InaccessibleFunction;
+
+    ForestSyncScheduler(DomainControllerManager *manager, int workerCount);
+
+    void setDatabase(const QSqlDatabase& db);
+    void setWorkerCount(int workerCount);
+    int workerCount() const;
+    void setInaccessibleForestHandler(const InaccessibleFunction& handler);
+
+    // Blocks until all forests are processed
+    ForestSyncCycleStats runCycle(const QVector<Forest>& forests, const SyncFunction& sync);
+
+private:
+    struct Cycle;
+
+    void work(Cycle *cycle, int worker);
+    bool takeForest(Cycle *cycle, int worker, int *outForestIndex, bool *outIsStolen);
+
+    DomainControllerManager *m_manager;
+    QSqlDatabase m_db;
+    int m_workerCount;
+    InaccessibleFunction m_inaccessibleForestHandler;
+
+    QMutex m_inProgressMutex;
+    QSet<QString> m_inProgress;     // objectGuid of forests being synced
+};
+
+} // namespace ActiveDirectory
+
+#endif // FORESTSYNCSCHEDULER_H
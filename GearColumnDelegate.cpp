@@ -0,0 +1,40 @@
+#include "GearColumnDelegate.h"
+#include <QPainter>
+#include <QPixmap>
+#include <QApplication>
+#include <QStyle>
+
+GearColumnDelegate::GearColumnDelegate(QObject *parent) :
+    QStyledItemDelegate(parent)
+{
+}
+
+void GearColumnDelegate::paint(QPainter *painter, const QStyleOptionViewItem& option, const QModelIndex& index) const
+{
+    // Background and selection as for other cells, then the icon instead of text
+    QStyleOptionViewItem opt = option;
+    initStyleOption(&opt, index);
+    opt.text.clear();
+    const QWidget *widget = opt.widget;
+    QStyle *style = widget ? widget->style() : QApplication::style();
+    style->drawControl(QStyle::CE_ItemViewItem, &opt, painter, widget);
+
+    QPixmap pixmap = gearPixmap();
+    if (!pixmap.isNull()) {
+        QRect target(QPoint(0, 0), pixmap.size() / pixmap.devicePixelRatio());
+        target.moveCenter(option.rect.center());
+        painter->drawPixmap(target, pixmap);
+    }
+}
+
+QSize GearColumnDelegate::sizeHint(const QStyleOptionViewItem& option, const QModelIndex& index) const
+{
+    QSize size = QStyledItemDelegate::sizeHint(option, index);
+    return size.expandedTo(gearPixmap().size());
+}
+
+QPixmap GearColumnDelegate::gearPixmap()
+{
+    static const QPixmap pixmap(":gfx/toolbar-icons/normal/Settings-24.png");
+    return pixmap;
+}
@@ -0,0 +1,22 @@
+#ifndef GEARCOLUMNDELEGATE_H
+#define GEARCOLUMNDELEGATE_H
+#include <QStyledItemDelegate>
+
+/*
+ * Paints the "gear" icon of MenuColumnTableView centered in the cell, so rows do not need
+ * a label widget each. All cells share one pixmap.
+ */
+class GearColumnDelegate : public QStyledItemDelegate
+{
+    Q_OBJECT
+public:
+    explicit GearColumnDelegate(QObject *parent = nullptr);
+
+    void paint(QPainter *painter, const QStyleOptionViewItem& option, const QModelIndex& index) const override;
+    QSize sizeHint(const QStyleOptionViewItem& option, const QModelIndex& index) const override;
+
+    // Loaded from resources once
+    static QPixmap gearPixmap();
+};
+
+#endif // GEARCOLUMNDELEGATE_H
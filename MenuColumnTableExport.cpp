@@ -0,0 +1,156 @@
+#include "MenuColumnTableExport.h"
+#include <QAbstractItemModel>
+#include <QIODevice>
+#include <QTextStream>
+#include <algorithm>
+#include <QsLog.h>
+
+namespace {
+
+inline QString cellText(const QAbstractItemModel *model, int row, int column)
+{
+    // EditRole has the real value of the password echo column
+    return model->data(model->index(row, column), Qt::EditRole).toString();
+}
+
+bool finish(QTextStream& stream, QIODevice *device, const char *format)
+{
+    stream.flush();
+    if (stream.status() != QTextStream::Ok) {
+        QLOG_ERROR() << "Cannot export table as" << format << device->errorString();
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+int MenuColumnTableColumns::rowCount() const
+{
+    return values.isEmpty() ? 0 : values.first().size();
+}
+
+int MenuColumnTableColumns::columnCount() const
+{
+    return names.size();
+}
+
+MenuColumnTableColumns MenuColumnTableExport::columns(const QAbstractItemModel *model, const QStringList& names)
+{
+    MenuColumnTableColumns ret;
+    ret.names = names;
+    ret.values.resize(names.size());
+
+    const int rows = model->rowCount();
+    for (int column = 0; column < names.size(); ++column) {
+        QStringList& values = ret.values[column];
+        values.reserve(rows);
+        for (int row = 0; row < rows; ++row) {
+            values.append(cellText(model, row, column));
+        }
+    }
+    return ret;
+}
+
+bool MenuColumnTableExport::writeCsv(const QAbstractItemModel *model, const QStringList& names, QIODevice *device)
+{
+    QTextStream stream(device);
+    stream.setCodec("UTF-8");
+
+    for (int column = 0; column < names.size(); ++column) {
+        if (column > 0) {
+            stream << ',';
+        }
+        stream << csvField(names[column]);
+    }
+    stream << "\r\n";
+
+    const int rows = model->rowCount();
+    for (int row = 0; row < rows; ++row) {
+        for (int column = 0; column < names.size(); ++column) {
+            if (column > 0) {
+                stream << ',';
+            }
+            stream << csvField(cellText(model, row, column));
+        }
+        stream << "\r\n";
+    }
+    return finish(stream, device, "CSV");
+}
+
+bool MenuColumnTableExport::writeJson(const QAbstractItemModel *model, const QStringList& names, QIODevice *device)
+{
+    QTextStream stream(device);
+    stream.setCodec("UTF-8");
+
+    // Keys are escaped once, not per row
+    QStringList keys;
+    foreach (const QString& name, names) {
+        keys.append(jsonString(name) + ':');
+    }
+
+    // QJsonDocument (QVariantMap) orders keys alphabetically, so do we
+    QVector<int> order(names.size());
+    for (int i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [&names](int a, int b) { return names[a] < names[b]; });
+
+    stream << '[';
+    const int rows = model->rowCount();
+    for (int row = 0; row < rows; ++row) {
+        stream << (row == 0 ? "{" : ",{");
+        for (int i = 0; i < order.size(); ++i) {
+            if (i > 0) {
+                stream << ',';
+            }
+            stream << keys[order[i]] << jsonString(cellText(model, row, order[i]));
+        }
+        stream << '}';
+    }
+    stream << ']';
+    return finish(stream, device, "JSON");
+}
+
+QString MenuColumnTableExport::csvField(const QString& value)
+{
+    bool needsQuotes = false;
+    foreach (QChar ch, value) {
+        if (ch == ',' || ch == '"' || ch == '\n' || ch == '\r') {
+            needsQuotes = true;
+            break;
+        }
+    }
+    if (!needsQuotes) {
+        return value;
+    }
+    QString ret = value;
+    ret.replace('"', "\"\"");
+    return '"' + ret + '"';
+}
+
+QString MenuColumnTableExport::jsonString(const QString& value)
+{
+    QString ret;
+    ret.reserve(value.size() + 2);
+    ret += '"';
+    foreach (QChar ch, value) {
+        switch (ch.unicode()) {
+        case '"':  ret += "\\\""; break;
+        case '\\': ret += "\\\\"; break;
+        case '\b': ret += "\\b"; break;
+        case '\f': ret += "\\f"; break;
+        case '\n': ret += "\\n"; break;
+        case '\r': ret += "\\r"; break;
+        case '\t': ret += "\\t"; break;
+        default:
+            if (ch.unicode() < 0x20) {
+                ret += QString("\\u%1").arg(ch.unicode(), 4, 16, QChar('0'));
+            } else {
+                ret += ch;
+            }
+        }
+    }
+    ret += '"';
+    return ret;
+}
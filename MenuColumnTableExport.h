@@ -0,0 +1,39 @@
+#ifndef MENUCOLUMNTABLEEXPORT_H
+#define MENUCOLUMNTABLEEXPORT_H
+#include <QStringList>
+#include <QVector>
+
+class QAbstractItemModel;
+class QIODevice;
+
+/*
+ * Column oriented copy of table data: one list of values per mapped column
+ */
+struct MenuColumnTableColumns {
+    QStringList names;              // column mappings
+    QVector<QStringList> values;    // values[column][row]
+
+    int rowCount() const;
+    int columnCount() const;
+};
+
+/*
+ * Export of MenuColumnTableWidget/MenuColumnTableView data straight from the item model,
+ * without building a QVariantMap per row. Only the first 'columns' columns are exported
+ * (no "gear" column) and real values are written, not the password echo.
+ * 'names' are column mappings, used as CSV header and JSON keys.
+ */
+class MenuColumnTableExport {
+public:
+    static MenuColumnTableColumns columns(const QAbstractItemModel *model, const QStringList& names);
+
+    // RFC 4180, UTF-8, header line with names
+    static bool writeCsv(const QAbstractItemModel *model, const QStringList& names, QIODevice *device);
+    // Array of objects, same as QJsonDocument of data() but written row by row
+    static bool writeJson(const QAbstractItemModel *model, const QStringList& names, QIODevice *device);
+
+    static QString csvField(const QString& value);
+    static QString jsonString(const QString& value);
+};
+
+#endif // MENUCOLUMNTABLEEXPORT_H
@@ -0,0 +1,275 @@
+#include "MenuColumnTableFilterIndex.h"
+#include <QSet>
+#include <algorithm>
+
+MenuColumnTableFilterIndex::MenuColumnTableFilterIndex() :
+    m_lastColumn(-1),
+    m_isLastResultValid(false)
+{
+}
+
+void MenuColumnTableFilterIndex::clear()
+{
+    m_cells.clear();
+    m_postings.clear();
+    invalidateLastResult();
+}
+
+void MenuColumnTableFilterIndex::setRowCount(int rows)
+{
+    rows = qMax(0, rows);
+    if (rows < m_cells.size()) {
+        removeRows(rows, m_cells.size() - rows);
+    } else if (rows > m_cells.size()) {
+        // New rows at the end are empty, no posting has them
+        m_cells.resize(rows);
+        invalidateLastResult();
+    }
+}
+
+int MenuColumnTableFilterIndex::rowCount() const
+{
+    return m_cells.size();
+}
+
+void MenuColumnTableFilterIndex::insertRows(int row, int count)
+{
+    if (row < 0 || row > m_cells.size() || count <= 0) {
+        return;
+    }
+    if (row == m_cells.size()) {
+        // Appended rows are empty, no posting has a row to shift (appendRow() loops stay linear)
+        m_cells.resize(row + count);
+        invalidateLastResult();
+        return;
+    }
+    m_cells.insert(row, count, QStringList());
+    for (auto it = m_postings.begin(); it != m_postings.end(); ++it) {
+        QVector<int>& posting = it.value();
+        for (auto rowIt = std::lower_bound(posting.begin(), posting.end(), row); rowIt != posting.end(); ++rowIt) {
+            *rowIt += count;
+        }
+    }
+    invalidateLastResult();
+}
+
+void MenuColumnTableFilterIndex::removeRows(int row, int count)
+{
+    if (row < 0 || row >= m_cells.size() || count <= 0) {
+        return;
+    }
+    count = qMin(count, m_cells.size() - row);
+    m_cells.remove(row, count);
+    for (auto it = m_postings.begin(); it != m_postings.end();) {
+        QVector<int>& posting = it.value();
+        auto first = std::lower_bound(posting.begin(), posting.end(), row);
+        auto last = std::lower_bound(first, posting.end(), row + count);
+        for (auto rowIt = last; rowIt != posting.end(); ++rowIt) {
+            *rowIt -= count;
+        }
+        posting.erase(first, last);
+        if (posting.isEmpty()) {
+            it = m_postings.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    invalidateLastResult();
+}
+
+void MenuColumnTableFilterIndex::setText(int row, int column, const QString& text)
+{
+    if (row < 0 || column < 0) {
+        return;
+    }
+    if (row >= m_cells.size()) {
+        m_cells.resize(row + 1);
+    }
+
+    QStringList& cells = m_cells[row];
+    while (cells.size() <= column) {
+        cells.append(QString());
+    }
+    const QString folded = text.toCaseFolded();
+    if (cells[column] == folded) {
+        return;
+    }
+
+    QVector<quint64> keys;
+    trigrams(cells[column], &keys);
+    cells[column] = folded;
+    if (!keys.isEmpty()) {
+        // Old trigram stays if another cell of the row has it too
+        QSet<quint64> rowKeys;
+        QVector<quint64> cellKeys;
+        foreach (const QString& cell, cells) {
+            cellKeys.clear();
+            trigrams(cell, &cellKeys);
+            foreach (quint64 key, cellKeys) {
+                rowKeys.insert(key);
+            }
+        }
+        foreach (quint64 key, keys) {
+            if (!rowKeys.contains(key)) {
+                removeFromPosting(key, row);
+            }
+        }
+    }
+
+    keys.clear();
+    trigrams(folded, &keys);
+    foreach (quint64 key, keys) {
+        addToPosting(key, row);
+    }
+    invalidateLastResult();
+}
+
+/*
+ * Cells are moved and row ids in posting lists are remapped, no trigram is computed again
+ */
+void MenuColumnTableFilterIndex::permute(const QVector<int>& newToOld)
+{
+    if (newToOld.size() != m_cells.size()) {
+        return;
+    }
+    const int rows = m_cells.size();
+    QVector<QStringList> cells(rows);
+    QVector<int> oldToNew(rows);
+    for (int row = 0; row < rows; ++row) {
+        cells[row] = m_cells[newToOld[row]];
+        oldToNew[newToOld[row]] = row;
+    }
+    m_cells = cells;
+
+    for (auto it = m_postings.begin(); it != m_postings.end(); ++it) {
+        QVector<int>& posting = it.value();
+        for (int i = 0; i < posting.size(); ++i) {
+            posting[i] = oldToNew[posting[i]];
+        }
+        std::sort(posting.begin(), posting.end());
+    }
+    invalidateLastResult();
+}
+
+QVector<int> MenuColumnTableFilterIndex::match(const QString& text, int column)
+{
+    const QString folded = text.toCaseFolded();
+    QVector<int> result;
+    if (folded.isEmpty()) {
+        result.reserve(m_cells.size());
+        for (int row = 0; row < m_cells.size(); ++row) {
+            result.append(row);
+        }
+        return result;
+    }
+
+    QVector<int> candidates;
+    bool isAllRows = false;
+    if (m_isLastResultValid && column == m_lastColumn && !m_lastQuery.isEmpty() && folded.contains(m_lastQuery)) {
+        // Every match of the longer query is a match of the previous one
+        candidates = m_lastResult;
+    } else if (folded.size() >= 3) {
+        QVector<quint64> keys;
+        trigrams(folded, &keys);
+        const QVector<int> *rarest = nullptr;
+        foreach (quint64 key, keys) {
+            auto it = m_postings.constFind(key);
+            if (it == m_postings.constEnd()) {
+                // Some trigram is in no cell at all
+                rarest = nullptr;
+                candidates.clear();
+                break;
+            }
+            if (!rarest || it->size() < rarest->size()) {
+                rarest = &(*it);
+            }
+        }
+        if (rarest) {
+            candidates = *rarest;
+        }
+    } else {
+        isAllRows = true;
+    }
+
+    if (isAllRows) {
+        for (int row = 0; row < m_cells.size(); ++row) {
+            if (rowMatches(row, folded, column)) {
+                result.append(row);
+            }
+        }
+    } else {
+        foreach (int row, candidates) {
+            if (rowMatches(row, folded, column)) {
+                result.append(row);
+            }
+        }
+    }
+
+    m_lastQuery = folded;
+    m_lastColumn = column;
+    m_lastResult = result;
+    m_isLastResultValid = true;
+    return result;
+}
+
+void MenuColumnTableFilterIndex::trigrams(const QString& folded, QVector<quint64> *out)
+{
+    out->reserve(qMax(0, folded.size() - 2));
+    for (int i = 0; i + 2 < folded.size(); ++i) {
+        quint64 key = (quint64(folded[i].unicode()) << 32) | (quint64(folded[i + 1].unicode()) << 16) | folded[i + 2].unicode();
+        out->append(key);
+    }
+}
+
+void MenuColumnTableFilterIndex::addToPosting(quint64 key, int row)
+{
+    QVector<int>& posting = m_postings[key];
+    // Rows are mostly filled in order, appending keeps the list sorted
+    if (posting.isEmpty() || posting.last() < row) {
+        posting.append(row);
+        return;
+    }
+    auto it = std::lower_bound(posting.begin(), posting.end(), row);
+    if (*it != row) {
+        posting.insert(it, row);
+    }
+}
+
+void MenuColumnTableFilterIndex::removeFromPosting(quint64 key, int row)
+{
+    auto postingIt = m_postings.find(key);
+    if (postingIt == m_postings.end()) {
+        return;
+    }
+    QVector<int>& posting = postingIt.value();
+    auto it = std::lower_bound(posting.begin(), posting.end(), row);
+    if (it != posting.end() && *it == row) {
+        posting.erase(it);
+        if (posting.isEmpty()) {
+            m_postings.erase(postingIt);
+        }
+    }
+}
+
+bool MenuColumnTableFilterIndex::rowMatches(int row, const QString& folded, int column) const
+{
+    if (row >= m_cells.size()) {
+        return false;
+    }
+    const QStringList& cells = m_cells[row];
+    if (column >= 0) {
+        return column < cells.size() && cells[column].contains(folded);
+    }
+    foreach (const QString& cell, cells) {
+        if (cell.contains(folded)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void MenuColumnTableFilterIndex::invalidateLastResult()
+{
+    m_isLastResultValid = false;
+    m_lastResult.clear();
+}
@@ -0,0 +1,49 @@
+#ifndef MENUCOLUMNTABLEFILTERINDEX_H
+#define MENUCOLUMNTABLEFILTERINDEX_H
+#include <QHash>
+#include <QVector>
+#include <QStringList>
+
+/*
+ * Case insensitive "contains" search over table cells backed by a trigram index.
+ * Rows are looked up through the posting list of the rarest trigram of the query and then
+ * verified, so a query touches only candidate rows. Posting lists are sorted and exact:
+ * a replaced cell drops trigrams the row no longer has, inserted and removed rows shift them.
+ * A query which extends the previous one (user typed more) only narrows the previous result.
+ * Queries shorter than 3 characters scan the stored case folded text, no QString is copied
+ * out of the table.
+ */
+class MenuColumnTableFilterIndex {
+public:
+    MenuColumnTableFilterIndex();
+
+    void clear();
+    void setRowCount(int rows);
+    int rowCount() const;
+    void insertRows(int row, int count);
+    void removeRows(int row, int count);
+    void setText(int row, int column, const QString& text);
+    // Rows were reordered, new row i is old row newToOld[i]
+    void permute(const QVector<int>& newToOld);
+
+    // Ascending row indexes containing 'text' in 'column', any column if -1
+    QVector<int> match(const QString& text, int column = -1);
+
+private:
+    static void trigrams(const QString& folded, QVector<quint64> *out);
+    void addToPosting(quint64 key, int row);
+    void removeFromPosting(quint64 key, int row);
+    bool rowMatches(int row, const QString& folded, int column) const;
+    void invalidateLastResult();
+
+    QVector<QStringList> m_cells;   // case folded
+    // Ascending rows having the trigram in any cell
+    QHash<quint64, QVector<int> > m_postings;
+
+    QString m_lastQuery;
+    int m_lastColumn;
+    QVector<int> m_lastResult;
+    bool m_isLastResultValid;
+};
+
+#endif // MENUCOLUMNTABLEFILTERINDEX_H
@@ -0,0 +1,203 @@
+#include "MenuColumnTableModel.h"
+
+namespace {
+
+void resizeCells(QStringList *cells, int columns)
+{
+    while (cells->size() < columns) {
+        cells->append(QString());
+    }
+    while (cells->size() > columns) {
+        cells->removeLast();
+    }
+}
+
+} // namespace
+
+MenuColumnTableModel::MenuColumnTableModel(QObject *parent) :
+    QAbstractTableModel(parent),
+    m_columns(0),
+    m_hasGearColumn(false),
+    m_echoPasswordColumn(-1)
+{
+}
+
+int MenuColumnTableModel::rowCount(const QModelIndex& parent) const
+{
+    return parent.isValid() ? 0 : m_rows.size();
+}
+
+int MenuColumnTableModel::columnCount(const QModelIndex& parent) const
+{
+    return parent.isValid() ? 0 : (m_hasGearColumn ? m_columns + 1 : m_columns);
+}
+
+QVariant MenuColumnTableModel::data(const QModelIndex& index, int role) const
+{
+    if (!index.isValid() || index.column() >= m_columns || index.row() >= m_rows.size()) {
+        return QVariant();
+    }
+
+    if (role == Qt::DisplayRole || role == Qt::EditRole) {
+        const QString& text = m_rows[index.row()].at(index.column());
+        if (role == Qt::DisplayRole && index.column() == m_echoPasswordColumn && !text.isEmpty()) {
+            return QString("******");
+        }
+        return text;
+    }
+    return QVariant();
+}
+
+QVariant MenuColumnTableModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation == Qt::Horizontal && role == Qt::DisplayRole) {
+        return section < m_headerLabels.size() && section < m_columns ? m_headerLabels[section] : QString();
+    }
+    return QAbstractTableModel::headerData(section, orientation, role);
+}
+
+/*
+ * "Gear" column is not selectable, user can only click on the gear icon
+ */
+Qt::ItemFlags MenuColumnTableModel::flags(const QModelIndex& index) const
+{
+    if (!index.isValid()) {
+        return Qt::NoItemFlags;
+    }
+    if (index.column() == gearColumn()) {
+        return Qt::ItemIsEnabled;
+    }
+    return Qt::ItemIsSelectable | Qt::ItemIsEnabled;
+}
+
+void MenuColumnTableModel::setDataColumnCount(int columns)
+{
+    columns = qMax(0, columns);
+    if (columns == m_columns) {
+        return;
+    }
+
+    beginResetModel();
+    m_columns = columns;
+    for (int row = 0; row < m_rows.size(); ++row) {
+        resizeCells(&m_rows[row], m_columns);
+    }
+    endResetModel();
+}
+
+int MenuColumnTableModel::dataColumnCount() const
+{
+    return m_columns;
+}
+
+void MenuColumnTableModel::setHeaderLabels(const QStringList& labels)
+{
+    m_headerLabels = labels;
+    if (m_columns < labels.size()) {
+        setDataColumnCount(labels.size());
+    }
+    emit headerDataChanged(Qt::Horizontal, 0, qMax(0, m_columns - 1));
+}
+
+void MenuColumnTableModel::setGearColumn(bool on)
+{
+    if (m_hasGearColumn == on) {
+        return;
+    }
+    if (on) {
+        beginInsertColumns(QModelIndex(), m_columns, m_columns);
+        m_hasGearColumn = true;
+        endInsertColumns();
+    } else {
+        beginRemoveColumns(QModelIndex(), m_columns, m_columns);
+        m_hasGearColumn = false;
+        endRemoveColumns();
+    }
+}
+
+bool MenuColumnTableModel::hasGearColumn() const
+{
+    return m_hasGearColumn;
+}
+
+int MenuColumnTableModel::gearColumn() const
+{
+    return m_hasGearColumn ? m_columns : -1;
+}
+
+void MenuColumnTableModel::setEchoPasswordColumn(int column)
+{
+    m_echoPasswordColumn = column;
+    if (!m_rows.isEmpty() && column >= 0 && column < m_columns) {
+        emit dataChanged(index(0, column), index(m_rows.size() - 1, column), QVector<int>() << Qt::DisplayRole);
+    }
+}
+
+int MenuColumnTableModel::appendRow()
+{
+    int row = m_rows.size();
+    beginInsertRows(QModelIndex(), row, row);
+    QStringList cells;
+    resizeCells(&cells, m_columns);
+    m_rows.append(cells);
+    endInsertRows();
+    return row; // new row index
+}
+
+void MenuColumnTableModel::setText(int row, int column, const QString& text)
+{
+    if (row < 0 || row >= m_rows.size() || column < 0 || column >= m_columns) {
+        return;
+    }
+    m_rows[row][column] = text;
+    QModelIndex changed = index(row, column);
+    emit dataChanged(changed, changed, QVector<int>() << Qt::DisplayRole << Qt::EditRole);
+}
+
+QString MenuColumnTableModel::text(int row, int column) const
+{
+    if (row < 0 || row >= m_rows.size() || column < 0 || column >= m_columns) {
+        return QString();
+    }
+    return m_rows[row].at(column);
+}
+
+void MenuColumnTableModel::setRows(const QVector<QStringList>& rows)
+{
+    beginResetModel();
+    m_rows = rows;
+    for (int row = 0; row < m_rows.size(); ++row) {
+        resizeCells(&m_rows[row], m_columns);
+    }
+    endResetModel();
+}
+
+void MenuColumnTableModel::setRowCount(int rows)
+{
+    rows = qMax(0, rows);
+    if (rows > m_rows.size()) {
+        QStringList cells;
+        resizeCells(&cells, m_columns);
+        beginInsertRows(QModelIndex(), m_rows.size(), rows - 1);
+        m_rows.insert(m_rows.size(), rows - m_rows.size(), cells);
+        endInsertRows();
+    } else if (rows < m_rows.size()) {
+        beginRemoveRows(QModelIndex(), rows, m_rows.size() - 1);
+        m_rows.resize(rows);
+        endRemoveRows();
+    }
+}
+
+void MenuColumnTableModel::clearContents()
+{
+    if (m_rows.isEmpty()) {
+        return;
+    }
+    beginResetModel();
+    for (int row = 0; row < m_rows.size(); ++row) {
+        for (int column = 0; column < m_columns; ++column) {
+            m_rows[row][column].clear();
+        }
+    }
+    endResetModel();
+}
@@ -0,0 +1,53 @@
+#ifndef MENUCOLUMNTABLEMODEL_H
+#define MENUCOLUMNTABLEMODEL_H
+#include <QAbstractTableModel>
+#include <QStringList>
+#include <QVector>
+
+/*
+ * Table model of MenuColumnTableView. Cells are plain strings stored row by row, so a row costs
+ * one QStringList instead of one QTableWidgetItem per cell. The optional "gear" column is the
+ * last one, it has no data and is painted by GearColumnDelegate.
+ */
+class MenuColumnTableModel : public QAbstractTableModel
+{
+    Q_OBJECT
+public:
+    explicit MenuColumnTableModel(QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex& parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+    Qt::ItemFlags flags(const QModelIndex& index) const override;
+
+    // Columns without "gear" column
+    void setDataColumnCount(int columns);
+    int dataColumnCount() const;
+    void setHeaderLabels(const QStringList& labels);
+
+    void setGearColumn(bool on);
+    bool hasGearColumn() const;
+    int gearColumn() const;
+
+    // This column data is shown as '******'
+    void setEchoPasswordColumn(int column);
+
+    int appendRow();
+    void setText(int row, int column, const QString& text);
+    QString text(int row, int column) const;
+
+    // Replaces all rows at once (one model reset)
+    void setRows(const QVector<QStringList>& rows);
+    void setRowCount(int rows);
+    void clearContents();
+
+private:
+    QVector<QStringList> m_rows;
+    QStringList m_headerLabels;
+    int m_columns;
+    bool m_hasGearColumn;
+    int m_echoPasswordColumn;
+};
+
+#endif // MENUCOLUMNTABLEMODEL_H
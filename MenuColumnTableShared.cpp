@@ -0,0 +1,73 @@
+#include "MenuColumnTableShared.h"
+#include <QTableView>
+#include <QMenu>
+#include <QCursor>
+
+QString MenuColumnTableShared::columnMappingName(const QStringList& columnMappings, int column)
+{
+    return (column < columnMappings.size()) ? columnMappings[column] : QString::number(column);
+}
+
+QStringList MenuColumnTableShared::columnMappingNames(const QStringList& columnMappings, int columns)
+{
+    QStringList names;
+    names.reserve(columns);
+    for (int column = 0; column < columns; column++) {
+        names.append(columnMappingName(columnMappings, column));
+    }
+    return names;
+}
+
+void MenuColumnTableShared::rowData(const QStringList& columnMappings, int columns, std::function<QString (int column)> cellText,
+                                    QVariantMap *map)
+{
+    for (int column = 0; column < columns; column++) {
+        (*map)[columnMappingName(columnMappings, column)] = cellText(column);
+    }
+}
+
+void MenuColumnTableShared::execRowMenu(QTableView *table, QMenu *menu, int row)
+{
+    // current row selected
+    table->selectRow(row);
+
+    if (menu) {
+        QPoint pt = QCursor::pos();
+        pt.setX(pt.x() - menu->width());
+        pt.setY(pt.y() - menu->height());
+        menu->exec(pt);
+    }
+}
+
+/*
+ * Reset column width according to width of the control.
+ */
+void MenuColumnTableShared::resetColumnWidth(QTableView *table, int columns, bool hasGearColumn, bool isUniform, int strechColumn)
+{
+    if (columns < 1) {
+        return;
+    }
+
+    int availableWidth = hasGearColumn ? (table->width() - GearColumnWidth - 15) : (table->width() - 15);
+
+    if (isUniform) {
+        int columnWidth = availableWidth / columns;
+        if (columnWidth < MinimumColumnWidth) {
+            columnWidth = MinimumColumnWidth;
+        }
+
+        for (int i = 0; i < columns; i++) {
+            table->setColumnWidth(i, columnWidth);
+        }
+    } else if (strechColumn != -1 && strechColumn < columns) {
+        int otherColumnsTotalWidth = 0;
+        for (int i = 0; i < columns; i++) {
+            if (i == strechColumn) {
+                continue;
+            }
+            otherColumnsTotalWidth += table->columnWidth(i);
+        }
+        int stretchColumnWidth = availableWidth - otherColumnsTotalWidth;
+        table->setColumnWidth(strechColumn, stretchColumnWidth);
+    }
+}
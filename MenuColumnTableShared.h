@@ -0,0 +1,36 @@
+#ifndef MENUCOLUMNTABLESHARED_H
+#define MENUCOLUMNTABLESHARED_H
+#include <QStringList>
+#include <QVariantMap>
+#include <functional>
+
+class QMenu;
+class QTableView;
+
+/*
+ * Code shared by MenuColumnTableWidget and MenuColumnTableView: column mapping names,
+ * row maps, the "gear" column menu and the uniform or stretch column widths
+ */
+class MenuColumnTableShared
+{
+public:
+    enum {
+        MinimumColumnWidth = 175,
+        GearColumnWidth = 50
+    };
+
+    // Mapping of the column or its index if not mapped
+    static QString columnMappingName(const QStringList& columnMappings, int column);
+    static QStringList columnMappingNames(const QStringList& columnMappings, int columns);
+
+    static void rowData(const QStringList& columnMappings, int columns, std::function<QString (int column)> cellText,
+                        QVariantMap *map);
+
+    // Selects 'row' and shows 'menu' (if any) above left of the cursor
+    static void execRowMenu(QTableView *table, QMenu *menu, int row);
+
+    // Uniform width or width of the stretch column (-1 for none) from width of the table
+    static void resetColumnWidth(QTableView *table, int columns, bool hasGearColumn, bool isUniform, int strechColumn);
+};
+
+#endif // MENUCOLUMNTABLESHARED_H
@@ -0,0 +1,235 @@
+#include "MenuColumnTableView.h"
+#include <QHeaderView>
+#include <QMenu>
+#include "MenuColumnTableModel.h"
+#include "GearColumnDelegate.h"
+#include "MenuColumnTableShared.h"
+
+MenuColumnTableView::MenuColumnTableView(QWidget *parent) :
+    QTableView(parent),
+    m_model(new MenuColumnTableModel(this)),
+    m_gearDelegate(new GearColumnDelegate(this)),
+    m_selectedRowIndex(-1),
+    m_menu(nullptr),
+    m_isUniformColumnWidth(false),
+    m_strechColumnIndex(-1)
+{
+    setModel(m_model);
+    // Same height for all rows, so the view never measures rows
+    verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+    connect(this, SIGNAL(clicked(const QModelIndex&)), SLOT(onItemClicked(const QModelIndex&)));
+}
+
+MenuColumnTableModel *MenuColumnTableView::tableModel() const
+{
+    return m_model;
+}
+
+void MenuColumnTableView::setColumnMappings(const QStringList& columnMappings)
+{
+    m_columnMappings = columnMappings;
+}
+
+/*
+ * This column data will be shown as '******'
+ */
+void MenuColumnTableView::setEchoPasswordColumn(int column)
+{
+    if (column >= 0 && column < totalColumns()) {
+        m_model->setEchoPasswordColumn(column);
+    }
+}
+
+void MenuColumnTableView::setUniformColumnWidth(bool on)
+{
+    if (m_isUniformColumnWidth != on) {
+        m_isUniformColumnWidth = on;
+        resetColumnWidth();
+    }
+}
+
+void MenuColumnTableView::setStrechColumn(int column)
+{
+    if (m_strechColumnIndex != column) {
+        m_strechColumnIndex = column;
+        resetColumnWidth();
+    }
+}
+
+void MenuColumnTableView::setColumnCount(int columns)
+{
+    m_model->setDataColumnCount(m_model->hasGearColumn() ? columns - 1 : columns);
+}
+
+int MenuColumnTableView::columnCount() const
+{
+    return m_model->columnCount();
+}
+
+void MenuColumnTableView::setRowCount(int rows)
+{
+    m_model->setRowCount(rows);
+}
+
+int MenuColumnTableView::rowCount() const
+{
+    return m_model->rowCount();
+}
+
+void MenuColumnTableView::setHorizontalHeaderLabels(const QStringList& labels)
+{
+    m_model->setHeaderLabels(labels);
+}
+
+void MenuColumnTableView::clearContents()
+{
+    m_model->clearContents();
+}
+
+int MenuColumnTableView::appendRow()
+{
+    return m_model->appendRow();
+}
+
+/*
+ * This function will return columns count without "Gear" column
+ */
+int MenuColumnTableView::totalColumns()
+{
+    return m_model->dataColumnCount();
+}
+
+void MenuColumnTableView::setText(int row, int column, const QString& text)
+{
+    m_model->setText(row, column, text);
+}
+
+void MenuColumnTableView::resizeEvent(QResizeEvent *event)
+{
+    QTableView::resizeEvent(event);
+    if (m_isUniformColumnWidth || m_strechColumnIndex != -1) {
+        resetColumnWidth();
+    }
+}
+
+void MenuColumnTableView::resetColumnWidth()
+{
+    MenuColumnTableShared::resetColumnWidth(this, totalColumns(), m_model->hasGearColumn(), m_isUniformColumnWidth, m_strechColumnIndex);
+}
+
+void MenuColumnTableView::onItemClicked(const QModelIndex& index)
+{
+    if (index.isValid() && index.column() == m_model->gearColumn()) {
+        m_selectedRowIndex = index.row();
+        MenuColumnTableShared::execRowMenu(this, m_menu, index.row());
+    }
+}
+
+/*
+ * Add the additional column which only contains "gear" icon painted by the delegate.
+ */
+void MenuColumnTableView::addGearHeaderColumn()
+{
+    if (!m_model->hasGearColumn()) {
+        m_model->setGearColumn(true);
+        setItemDelegateForColumn(m_model->gearColumn(), m_gearDelegate);
+        setColumnWidth(m_model->gearColumn(), MenuColumnTableShared::GearColumnWidth);
+    }
+}
+
+void MenuColumnTableView::setMenu(QMenu *menu)
+{
+    m_menu = menu;
+}
+
+QMenu *MenuColumnTableView::menu() const
+{
+    return m_menu;
+}
+
+/*
+ * Get data of table row
+ */
+bool MenuColumnTableView::rowData(int row, QVariantMap *map)
+{
+    if (row < rowCount()) {
+        MenuColumnTableModel *model = m_model;
+        MenuColumnTableShared::rowData(m_columnMappings, totalColumns(), [model, row](int column) {
+            return model->text(row, column);
+        }, map);
+        return true;
+    }
+    return false;
+}
+
+/*
+ * Return cell (identified by row and column) data
+ *  row             row index
+ *  column          column index
+ */
+QString MenuColumnTableView::cellData(int row, int column)
+{
+    return m_model->text(row, column);
+}
+
+/*
+ * Name of every column (without "gear" one): its mapping or index if not mapped
+ */
+QStringList MenuColumnTableView::columnMappingNames()
+{
+    return MenuColumnTableShared::columnMappingNames(m_columnMappings, totalColumns());
+}
+
+MenuColumnTableColumns MenuColumnTableView::columnData()
+{
+    return MenuColumnTableExport::columns(m_model, columnMappingNames());
+}
+
+bool MenuColumnTableView::exportCsv(QIODevice *device)
+{
+    return MenuColumnTableExport::writeCsv(m_model, columnMappingNames(), device);
+}
+
+bool MenuColumnTableView::exportJson(QIODevice *device)
+{
+    return MenuColumnTableExport::writeJson(m_model, columnMappingNames(), device);
+}
+
+/*
+ * Get data in QVariantList. Each cell data is in QString format
+ */
+QVariantList MenuColumnTableView::data()
+{
+    QVariantList list;
+    int rows = rowCount();
+    list.reserve(rows);
+    for (int row = 0; row < rows; row++) {
+        QVariantMap map;
+        rowData(row, &map);
+        list.append(map);
+    }
+    return list;
+}
+
+/*
+ * Set QVariantList data back to the table. Rows are built first and given to the model
+ * at once, so the view is reset only once.
+ */
+void MenuColumnTableView::setData(const QVariantList& list)
+{
+    const int columns = totalColumns();
+    const QStringList columnMappings = columnMappingNames();
+
+    QVector<QStringList> rows;
+    rows.reserve(list.size());
+    foreach (const QVariant& item, list) {
+        const QVariantMap map = item.toMap();
+        QStringList cells;
+        cells.reserve(columns);
+        foreach (const QString& columnMapping, columnMappings) {
+            cells.append(map.value(columnMapping).toString());
+        }
+        rows.append(cells);
+    }
+    m_model->setRows(rows);
+}
@@ -0,0 +1,79 @@
+#ifndef MENUCOLUMNTABLEVIEW_H
+#define MENUCOLUMNTABLEVIEW_H
+#include <QTableView>
+#include "MenuColumnTableExport.h"
+
+class QMenu;
+class MenuColumnTableModel;
+class GearColumnDelegate;
+
+/*
+ * Virtualized variant of MenuColumnTableWidget for large tables (users, groups).
+ * It has the same public API but keeps data in MenuColumnTableModel and paints the "gear"
+ * column with GearColumnDelegate, so there are no items or widgets per row.
+ */
+class MenuColumnTableView : public QTableView
+{
+    Q_OBJECT
+public:
+    explicit MenuColumnTableView(QWidget *parent = nullptr);
+
+    void addGearHeaderColumn();
+    void setColumnMappings(const QStringList& columnMappings);
+
+    int totalColumns();
+
+    int appendRow();
+    void setText(int row, int column, const QString& text);
+
+    void setMenu(QMenu *menu);
+    QMenu *menu() const;
+
+    bool rowData(int row, QVariantMap *map);
+
+    QVariantList data();
+    void setData(const QVariantList& list);
+
+    QString cellData(int row, int column);
+
+    // Export without a QVariantMap per row, see MenuColumnTableExport
+    MenuColumnTableColumns columnData();
+    bool exportCsv(QIODevice *device);
+    bool exportJson(QIODevice *device);
+
+    void setEchoPasswordColumn(int column);
+    void setUniformColumnWidth(bool on);
+    // Pass -1 to disable
+    void setStrechColumn(int column);
+
+    // QTableWidget methods used to set the table up
+    void setColumnCount(int columns);
+    int columnCount() const;
+    void setRowCount(int rows);
+    int rowCount() const;
+    void setHorizontalHeaderLabels(const QStringList& labels);
+    void clearContents();
+
+    MenuColumnTableModel *tableModel() const;
+
+protected:
+    void resizeEvent(QResizeEvent *event) override;
+
+private slots:
+    void onItemClicked(const QModelIndex& index);
+
+private:
+    void resetColumnWidth();
+    QStringList columnMappingNames();
+
+private:
+    MenuColumnTableModel *m_model;
+    GearColumnDelegate *m_gearDelegate;
+    int m_selectedRowIndex;
+    QStringList m_columnMappings;
+    QMenu *m_menu;
+    bool m_isUniformColumnWidth;
+    int m_strechColumnIndex;
+};
+
+#endif // MENUCOLUMNTABLEVIEW_H
@@ -1,23 +1,164 @@
 #include "MenuColumnTableWidget.h"
-#include <QLabel>
-#include <QHBoxLayout>
 #include <QMenu>
 #include <QMetaMethod>
+#include <QTimer>
+#include <QHeaderView>
+#include <QCollator>
+#include <QCollatorSortKey>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QPointer>
+#include <QCoreApplication>
+#include <algorithm>
+#include <functional>
+#include <vector>
 #include <QDebug>
+#include "GearColumnDelegate.h"
+#include "MenuColumnTableShared.h"
 
-#define MINIMUM_COLUMN_WIDTH 175
-#define GEAR_COLUMN_WIDTH 50
+#define DEFAULT_STREAM_CHUNK_SIZE 2000
+#define DEFAULT_FILTER_DEBOUNCE_INTERVAL_MS 150
+#define AUTO_COLUMN_PADDING 16
+#define AUTO_COLUMN_MINIMUM_WIDTH 50
+#define AUTO_COLUMN_MAXIMUM_WIDTH 600
+
+namespace {
+
+/*
+ * Suspends painting and signals of the table while many cells are set
+ */
+class BulkUpdateGuard {
+public:
+    explicit BulkUpdateGuard(QTableWidget *table) :
+        m_table(table),
+        m_wasUpdatesEnabled(table->updatesEnabled()),
+        m_wasSortingEnabled(table->isSortingEnabled()),
+        m_wereSignalsBlocked(table->blockSignals(true))
+    {
+        m_table->setUpdatesEnabled(false);
+        // Sorting would move every inserted item
+        m_table->setSortingEnabled(false);
+    }
+
+    ~BulkUpdateGuard()
+    {
+        m_table->setSortingEnabled(m_wasSortingEnabled);
+        m_table->blockSignals(m_wereSignalsBlocked);
+        m_table->setUpdatesEnabled(m_wasUpdatesEnabled);
+    }
+
+private:
+    QTableWidget *m_table;
+    bool m_wasUpdatesEnabled;
+    bool m_wasSortingEnabled;
+    bool m_wereSignalsBlocked;
+};
+
+class SortTask : public QRunnable {
+public:
+    explicit SortTask(std::function<void ()> function) :
+        m_function(function)
+    {
+    }
+
+    void run() override
+    {
+        m_function();
+    }
+
+private:
+    std::function<void ()> m_function;
+};
+
+/*
+ * Returns row order (new row i is old row result[i]). Each text is turned into a collation
+ * key once, so comparisons during the sort are plain byte comparisons. Sort is stable.
+ */
+std::vector<QCollatorSortKey> sortKeys(const QStringList& texts)
+{
+    QCollator collator;
+    collator.setCaseSensitivity(Qt::CaseInsensitive);
+    // user2 before user10
+    collator.setNumericMode(true);
+
+    std::vector<QCollatorSortKey> keys;
+    keys.reserve(texts.size());
+    foreach (const QString& text, texts) {
+        keys.push_back(collator.sortKey(text));
+    }
+    return keys;
+}
+
+QVector<int> sortPermutation(const QStringList& texts, Qt::SortOrder order)
+{
+    const std::vector<QCollatorSortKey> keys = sortKeys(texts);
+    QVector<int> newToOld(texts.size());
+    for (int i = 0; i < newToOld.size(); ++i) {
+        newToOld[i] = i;
+    }
+    std::stable_sort(newToOld.begin(), newToOld.end(), [&keys, order](int a, int b) {
+        return order == Qt::AscendingOrder ? keys[a].compare(keys[b]) < 0 : keys[b].compare(keys[a]) < 0;
+    });
+    return newToOld;
+}
+
+/*
+ * Same as sortPermutation() when the first 'sortedRows' texts are already in order: only
+ * the rows after them are sorted, then both runs are merged. Sorted rows win ties.
+ */
+QVector<int> mergePermutation(const QStringList& texts, int sortedRows, Qt::SortOrder order)
+{
+    const std::vector<QCollatorSortKey> keys = sortKeys(texts);
+    auto lessThan = [&keys, order](int a, int b) {
+        return order == Qt::AscendingOrder ? keys[a].compare(keys[b]) < 0 : keys[b].compare(keys[a]) < 0;
+    };
+
+    QVector<int> rows(texts.size());
+    for (int i = 0; i < rows.size(); ++i) {
+        rows[i] = i;
+    }
+    std::stable_sort(rows.begin() + sortedRows, rows.end(), lessThan);
+
+    QVector<int> newToOld(texts.size());
+    std::merge(rows.begin(), rows.begin() + sortedRows, rows.begin() + sortedRows, rows.end(), newToOld.begin(), lessThan);
+    return newToOld;
+}
+
+} // namespace
 
 MenuColumnTableWidget::MenuColumnTableWidget(QWidget *parent) :
     QTableWidget(parent),
     m_selectedRowIndex(-1),
     m_isGearHeaderColumnAdded(false),
+    m_gearDelegate(new GearColumnDelegate(this)),
     m_menu(nullptr),
     m_echoPasswordColumn(-1),
     m_isUniformColumnWidth(false),
-    m_strechColumnIndex(-1)
+    m_strechColumnIndex(-1),
+    m_pendingRowsOffset(0),
+    m_isAppendPendingRowsScheduled(false),
+    m_streamChunkSize(DEFAULT_STREAM_CHUNK_SIZE),
+    m_isFilterIndexSyncSuspended(false),
+    m_filterTimer(new QTimer(this)),
+    m_filterColumn(-1),
+    m_contentGeneration(0),
+    m_sortRequest(0),
+    m_sortRowCount(0),
+    m_isAutoColumnWidth(false),
+    m_isAutoColumnWidthResetScheduled(false)
 {
+    m_widthStats.setFont(font());
+    m_filterTimer->setSingleShot(true);
+    m_filterTimer->setInterval(DEFAULT_FILTER_DEBOUNCE_INTERVAL_MS);
+    connect(m_filterTimer, SIGNAL(timeout()), SLOT(applyFilter()));
     connect(this, SIGNAL(clicked(const QModelIndex&)), SLOT(onItemClicked(const QModelIndex&)));
+
+    // Index follows the model, so inherited QTableWidget calls keep it in sync too
+    connect(model(), SIGNAL(rowsInserted(const QModelIndex&, int, int)), SLOT(onModelRowsInserted(const QModelIndex&, int, int)));
+    connect(model(), SIGNAL(rowsRemoved(const QModelIndex&, int, int)), SLOT(onModelRowsRemoved(const QModelIndex&, int, int)));
+    connect(model(), SIGNAL(dataChanged(const QModelIndex&, const QModelIndex&)), SLOT(onModelDataChanged(const QModelIndex&, const QModelIndex&)));
+    connect(model(), SIGNAL(modelReset()), SLOT(rebuildFilterIndex()));
+    connect(model(), SIGNAL(layoutChanged()), SLOT(rebuildFilterIndex()));
 }
 
 void MenuColumnTableWidget::setColumnMappings(const QStringList& columnMappings)
@@ -51,6 +192,82 @@ void MenuColumnTableWidget::setStrechColumn(int column)
     }
 }
 
+void MenuColumnTableWidget::setAutoColumnWidth(bool on)
+{
+    if (m_isAutoColumnWidth != on) {
+        m_isAutoColumnWidth = on;
+        if (on) {
+            measureColumnWidthSample();
+        }
+        resetColumnWidth();
+    }
+}
+
+/*
+ * Called for every cell change, so a new width is measured only for sampled rows
+ * and columns are resized (once, later) only if their widest cell changed
+ */
+void MenuColumnTableWidget::updateColumnWidthStats(int row, int column, const QString& text)
+{
+    if (!m_isAutoColumnWidth || !m_widthStats.isSampled(row)) {
+        return;
+    }
+    if (m_widthStats.setText(row, column, text)) {
+        scheduleAutoColumnWidthReset();
+    }
+}
+
+void MenuColumnTableWidget::scheduleAutoColumnWidthReset()
+{
+    if (!m_isAutoColumnWidthResetScheduled) {
+        m_isAutoColumnWidthResetScheduled = true;
+        QTimer::singleShot(0, this, SLOT(resetAutoColumnWidth()));
+    }
+}
+
+/*
+ * Rows of the sample changed (sort, font), measure them again
+ */
+void MenuColumnTableWidget::measureColumnWidthSample()
+{
+    m_widthStats.clear();
+    measureColumnWidthRows(0);
+}
+
+/*
+ * Measures rows from 'firstRow' to the end of the sample, returns true if a column got wider or narrower
+ */
+bool MenuColumnTableWidget::measureColumnWidthRows(int firstRow)
+{
+    bool isChanged = false;
+    const int columns = totalColumns();
+    for (int row = firstRow; row < rowCount() && m_widthStats.isSampled(row); ++row) {
+        for (int column = 0; column < columns; ++column) {
+            QTableWidgetItem *cellItem = item(row, column);
+            isChanged |= m_widthStats.setText(row, column, cellItem ? cellItem->text() : QString());
+        }
+    }
+    return isChanged;
+}
+
+void MenuColumnTableWidget::resetAutoColumnWidth()
+{
+    m_isAutoColumnWidthResetScheduled = false;
+    resetColumnWidth();
+}
+
+void MenuColumnTableWidget::changeEvent(QEvent *event)
+{
+    QTableWidget::changeEvent(event);
+    if (event->type() == QEvent::FontChange) {
+        m_widthStats.setFont(font());
+        if (m_isAutoColumnWidth) {
+            measureColumnWidthSample();
+            resetColumnWidth();
+        }
+    }
+}
+
 int MenuColumnTableWidget::appendRow()
 {
     int rows = rowCount();
@@ -73,22 +290,332 @@ int MenuColumnTableWidget::totalColumns()
  * Set data to specified cell of QTableWidget. cell is identified by row and column.
  */
 void MenuColumnTableWidget::setText(int row, int column, const QString& data)
+{
+    setCellText(row, column, data);
+}
+
+void MenuColumnTableWidget::setCellText(int row, int column, const QString& data)
 {
     QTableWidgetItem *item = new QTableWidgetItem(data);
     item->setFlags(Qt::ItemIsSelectable | Qt::ItemIsEnabled);
+    // Filter index and width stats follow in onModelDataChanged()
     setItem(row, column, item);
 }
 
+/*
+ * Filter has to see the new content. Pending sort result is stale only if rows it covers
+ * changed, rows appended after them are merged in when it is applied.
+ */
+void MenuColumnTableWidget::contentChanged(int firstRow)
+{
+    if (firstRow < m_sortRowCount) {
+        m_contentGeneration++;
+    }
+    scheduleFilter();
+}
+
+/*
+ * Model change handlers. Bulk updates block the table signals and call contentChanged()
+ * once for the whole batch, any other change is reported here.
+ */
+void MenuColumnTableWidget::onModelRowsInserted(const QModelIndex& parent, int first, int last)
+{
+    if (parent.isValid() || m_isFilterIndexSyncSuspended) {
+        return;
+    }
+    m_filterIndex.insertRows(first, last - first + 1);
+    // New rows are empty, their cells are measured when set
+    if (m_isAutoColumnWidth && m_widthStats.insertRows(first, last - first + 1)) {
+        scheduleAutoColumnWidthReset();
+    }
+    if (!signalsBlocked()) {
+        contentChanged(first);
+    }
+}
+
+void MenuColumnTableWidget::onModelRowsRemoved(const QModelIndex& parent, int first, int last)
+{
+    if (parent.isValid() || m_isFilterIndexSyncSuspended) {
+        return;
+    }
+    m_filterIndex.removeRows(first, last - first + 1);
+    if (m_isAutoColumnWidth) {
+        bool isChanged = m_widthStats.removeRows(first, last - first + 1);
+        // Rows after the sample moved into it
+        isChanged |= measureColumnWidthRows(m_widthStats.rowCount());
+        if (isChanged) {
+            scheduleAutoColumnWidthReset();
+        }
+    }
+    if (!signalsBlocked()) {
+        contentChanged(first);
+    }
+}
+
+void MenuColumnTableWidget::onModelDataChanged(const QModelIndex& topLeft, const QModelIndex& bottomRight)
+{
+    if (m_isFilterIndexSyncSuspended || !topLeft.isValid() || !bottomRight.isValid()) {
+        return;
+    }
+    const int lastColumn = qMin(bottomRight.column(), totalColumns() - 1);
+    for (int row = topLeft.row(); row <= bottomRight.row(); ++row) {
+        for (int column = topLeft.column(); column <= lastColumn; ++column) {
+            QTableWidgetItem *cellItem = item(row, column);
+            const QString text = cellItem ? cellItem->text() : QString();
+            m_filterIndex.setText(row, column, text);
+            updateColumnWidthStats(row, column, text);
+        }
+    }
+    if (!signalsBlocked()) {
+        contentChanged(topLeft.row());
+    }
+}
+
+/*
+ * Model was reset or its rows were reordered (inherited sortItems()), index and measure it again
+ */
+void MenuColumnTableWidget::rebuildFilterIndex()
+{
+    if (m_isFilterIndexSyncSuspended) {
+        return;
+    }
+    const int rows = rowCount();
+    const int columns = totalColumns();
+    m_filterIndex.clear();
+    m_filterIndex.setRowCount(rows);
+    for (int row = 0; row < rows; ++row) {
+        for (int column = 0; column < columns; ++column) {
+            QTableWidgetItem *cellItem = item(row, column);
+            if (cellItem) {
+                m_filterIndex.setText(row, column, cellItem->text());
+            }
+        }
+    }
+    if (m_isAutoColumnWidth) {
+        measureColumnWidthSample();
+        scheduleAutoColumnWidthReset();
+    }
+    if (!signalsBlocked()) {
+        contentChanged();
+    }
+}
+
+void MenuColumnTableWidget::setFilterText(const QString& text)
+{
+    if (m_filterText != text) {
+        m_filterText = text;
+        // Restarted by every keystroke
+        m_filterTimer->start();
+    }
+}
+
+QString MenuColumnTableWidget::filterText() const
+{
+    return m_filterText;
+}
+
+void MenuColumnTableWidget::setFilterColumn(int column)
+{
+    if (m_filterColumn != column) {
+        m_filterColumn = column;
+        m_filterTimer->start();
+    }
+}
+
+void MenuColumnTableWidget::setFilterDebounceInterval(int ms)
+{
+    m_filterTimer->setInterval(qMax(0, ms));
+}
+
+/*
+ * Table content changed, filter it again unless it is already scheduled. Unlike a keystroke
+ * this does not restart the timer, so a long load does not postpone filtering.
+ */
+void MenuColumnTableWidget::scheduleFilter()
+{
+    if (!m_filterText.isEmpty() && !m_filterTimer->isActive()) {
+        m_filterTimer->start();
+    }
+}
+
+/*
+ * Only rows whose visibility changed are touched
+ */
+void MenuColumnTableWidget::applyFilter()
+{
+    const int rows = rowCount();
+    QVector<bool> isVisible(rows, m_filterText.isEmpty());
+    if (!m_filterText.isEmpty()) {
+        foreach (int row, m_filterIndex.match(m_filterText, m_filterColumn)) {
+            if (row < rows) {
+                isVisible[row] = true;
+            }
+        }
+    }
+
+    bool wasUpdatesEnabled = updatesEnabled();
+    setUpdatesEnabled(false);
+    int visibleRows = 0;
+    for (int row = 0; row < rows; ++row) {
+        if (isRowHidden(row) == isVisible[row]) {
+            setRowHidden(row, !isVisible[row]);
+        }
+        if (isVisible[row]) {
+            visibleRows++;
+        }
+    }
+    setUpdatesEnabled(wasUpdatesEnabled);
+    emit filterApplied(visibleRows);
+}
+
+void MenuColumnTableWidget::sortRows(int column, Qt::SortOrder order)
+{
+    startSort(column, order, 0);
+}
+
+/*
+ * Sorts on a worker. First 'sortedRows' rows are already in order and are only merged with
+ * the rest.
+ */
+void MenuColumnTableWidget::startSort(int column, Qt::SortOrder order, int sortedRows)
+{
+    const int rows = rowCount();
+    if (column < 0 || column >= totalColumns() || rows < 2) {
+        return;
+    }
+
+    // Only the sort column is copied (implicitly shared strings), keys are made on the worker
+    QStringList texts;
+    texts.reserve(rows);
+    for (int row = 0; row < rows; ++row) {
+        QTableWidgetItem *cellItem = item(row, column);
+        texts.append(cellItem ? cellItem->text() : QString());
+    }
+
+    const quint64 sortRequest = ++m_sortRequest;
+    const quint64 contentGeneration = m_contentGeneration;
+    m_sortRowCount = rows;
+    QPointer<MenuColumnTableWidget> table(this);
+    QThreadPool::globalInstance()->start(new SortTask([table, texts, order, column, sortRequest, contentGeneration, sortedRows]() {
+        QVector<int> newToOld = (sortedRows > 0) ? mergePermutation(texts, sortedRows, order) : sortPermutation(texts, order);
+        // QPointer is checked on the GUI thread, the table may be gone by then
+        QMetaObject::invokeMethod(QCoreApplication::instance(), [table, newToOld, order, column, sortRequest, contentGeneration]() {
+            if (table) {
+                table->applySort(sortRequest, contentGeneration, column, order, newToOld);
+            }
+        }, Qt::QueuedConnection);
+    }));
+}
+
+/*
+ * Moves items of data columns to their new rows. "Gear" column is the same in every row,
+ * so its items and widgets are not touched. Rows appended while sorting stay after the
+ * sorted ones and are merged in by a follow-up sort of just them.
+ */
+void MenuColumnTableWidget::applySort(quint64 sortRequest, quint64 contentGeneration, int column, Qt::SortOrder order,
+                                      const QVector<int>& sortedNewToOld)
+{
+    if (sortRequest != m_sortRequest) {
+        return;
+    }
+    const int sortedRows = sortedNewToOld.size();
+    const int rows = rowCount();
+    if (contentGeneration != m_contentGeneration || sortedRows > rows) {
+        // Sorted rows were edited or removed meanwhile, their order is unknown now
+        sortRows(column, order);
+        return;
+    }
+
+    QVector<int> newToOld = sortedNewToOld;
+    newToOld.reserve(rows);
+    for (int row = sortedRows; row < rows; ++row) {
+        newToOld.append(row);
+    }
+
+    const int columns = totalColumns();
+    {
+        BulkUpdateGuard guard(this);
+        // Items only move, the index is permuted below instead of following every cell
+        m_isFilterIndexSyncSuspended = true;
+        QVector<QTableWidgetItem *> items(sortedRows * columns);
+        for (int row = 0; row < sortedRows; ++row) {
+            for (int c = 0; c < columns; ++c) {
+                items[row * columns + c] = takeItem(row, c);
+            }
+        }
+        for (int row = 0; row < sortedRows; ++row) {
+            const int oldRow = newToOld[row];
+            for (int c = 0; c < columns; ++c) {
+                QTableWidgetItem *cellItem = items[oldRow * columns + c];
+                if (cellItem) {
+                    setItem(row, c, cellItem);
+                }
+            }
+        }
+        m_isFilterIndexSyncSuspended = false;
+
+        QVector<int> oldToNew(rows);
+        for (int row = 0; row < rows; ++row) {
+            oldToNew[newToOld[row]] = row;
+        }
+        if (m_selectedRowIndex >= 0 && m_selectedRowIndex < rows) {
+            m_selectedRowIndex = oldToNew[m_selectedRowIndex];
+        }
+        if (currentRow() >= 0 && currentRow() < rows) {
+            selectRow(oldToNew[currentRow()]);
+        }
+    }
+
+    // Hidden rows of the filter follow their data, other rows may be in width sample now
+    m_filterIndex.permute(newToOld);
+    if (m_isAutoColumnWidth) {
+        measureColumnWidthSample();
+        resetColumnWidth();
+    }
+    m_contentGeneration++;
+    if (!m_filterText.isEmpty()) {
+        applyFilter();
+    }
+
+    horizontalHeader()->setSortIndicator(column, order);
+    if (sortedRows < rows) {
+        startSort(column, order, sortedRows);
+        return;
+    }
+    emit rowsSorted(column, order);
+}
+
+void MenuColumnTableWidget::setAsyncSortingEnabled(bool on)
+{
+    horizontalHeader()->setSortIndicatorShown(on);
+    horizontalHeader()->setSectionsClickable(on);
+    if (on) {
+        connect(horizontalHeader(), SIGNAL(sectionClicked(int)), this, SLOT(onHeaderClicked(int)), Qt::UniqueConnection);
+    } else {
+        disconnect(horizontalHeader(), SIGNAL(sectionClicked(int)), this, SLOT(onHeaderClicked(int)));
+    }
+}
+
+void MenuColumnTableWidget::onHeaderClicked(int column)
+{
+    // "Gear" column is not sortable
+    if (column >= totalColumns()) {
+        return;
+    }
+    // Header already flipped the indicator on click
+    sortRows(column, horizontalHeader()->sortIndicatorOrder());
+}
+
 void MenuColumnTableWidget::resizeEvent(QResizeEvent *event)
 {
     QTableWidget::resizeEvent(event);
-    if (m_isUniformColumnWidth || m_strechColumnIndex != -1) {
+    if (m_isUniformColumnWidth || m_isAutoColumnWidth || m_strechColumnIndex != -1) {
         resetColumnWidth();
     }
 }
 
 /*
- * Reset column width according to width of the control.
+ * Reset column width according to width of the control. Uniform width wins over auto width.
  */
 void MenuColumnTableWidget::resetColumnWidth()
 {
@@ -97,44 +624,45 @@ void MenuColumnTableWidget::resetColumnWidth()
         return;
     }
 
-    int availableWidth = m_isGearHeaderColumnAdded ? (width() - GEAR_COLUMN_WIDTH - 15) : (width() - 15);
-
-    if (m_isUniformColumnWidth) {
-        int columnWidth = availableWidth / columns;
-        if (columnWidth < MINIMUM_COLUMN_WIDTH) {
-            columnWidth = MINIMUM_COLUMN_WIDTH;
+    if (m_isAutoColumnWidth && !m_isUniformColumnWidth) {
+        // Only cached widths are used here, no row is measured on resize
+        int autoAvailableWidth = viewport()->width() - (m_isGearHeaderColumnAdded ? columnWidth(columnCount() - 1) : 0);
+        QFontMetrics headerMetrics = horizontalHeader()->fontMetrics();
+        QVector<int> widths(columns);
+        int totalWidth = 0;
+        for (int i = 0; i < columns; i++) {
+            QTableWidgetItem *header = horizontalHeaderItem(i);
+            int headerWidth = header ? headerMetrics.horizontalAdvance(header->text()) : 0;
+            widths[i] = qBound(AUTO_COLUMN_MINIMUM_WIDTH, qMax(m_widthStats.width(i), headerWidth) + AUTO_COLUMN_PADDING,
+                               AUTO_COLUMN_MAXIMUM_WIDTH);
+            totalWidth += widths[i];
         }
 
-        for (int i = 0; i < columns; i++) {
-            setColumnWidth(i, columnWidth);
+        int spareWidth = autoAvailableWidth - totalWidth;
+        if (spareWidth > 0) {
+            if (m_strechColumnIndex != -1 && m_strechColumnIndex < columns) {
+                widths[m_strechColumnIndex] += spareWidth;
+            } else {
+                for (int i = 0; i < columns; i++) {
+                    widths[i] += spareWidth / columns + (i < spareWidth % columns ? 1 : 0);
+                }
+            }
         }
-    } else if (m_strechColumnIndex != -1 && m_strechColumnIndex < columns) {
-        int otherColumnsTotalWidth = 0;
         for (int i = 0; i < columns; i++) {
-            if (i == m_strechColumnIndex) {
-                continue;
+            if (columnWidth(i) != widths[i]) {
+                setColumnWidth(i, widths[i]);
             }
-            otherColumnsTotalWidth += columnWidth(i);
         }
-        int stretchColumnWidth = availableWidth - otherColumnsTotalWidth;
-        setColumnWidth(m_strechColumnIndex, stretchColumnWidth);
+        return;
     }
+    MenuColumnTableShared::resetColumnWidth(this, columns, m_isGearHeaderColumnAdded, m_isUniformColumnWidth, m_strechColumnIndex);
 }
 
 void MenuColumnTableWidget::onItemClicked(const QModelIndex& index)
 {
     if (index.isValid() && index.column() == (columnCount() - 1)) {
         m_selectedRowIndex = index.row();
-
-        // current row selected
-        selectRow(index.row());
-
-        if (m_menu) {
-            QPoint pt = QCursor::pos();
-            pt.setX(pt.x() - m_menu->width());
-            pt.setY(pt.y() - m_menu->height());
-            m_menu->exec(pt);
-        }
+        MenuColumnTableShared::execRowMenu(this, m_menu, index.row());
     }
 }
 
@@ -146,7 +674,9 @@ void MenuColumnTableWidget::addGearHeaderColumn()
     if (!m_isGearHeaderColumnAdded) {
         int columns = columnCount();
         setColumnCount(columns + 1);
-        setColumnWidth(columns, GEAR_COLUMN_WIDTH);
+        setColumnWidth(columns, MenuColumnTableShared::GearColumnWidth);
+        // Icon is painted for every row, there is no widget per row
+        setItemDelegateForColumn(columns, m_gearDelegate);
 
         // set column text
         QTableWidgetItem *item = new QTableWidgetItem("");
@@ -167,44 +697,17 @@ QMenu *MenuColumnTableWidget::menu() const
 }
 
 /*
- * This function add "gear" column in each new row.
+ * This function add "gear" column in each new row. The icon itself is painted by GearColumnDelegate.
  */
 void MenuColumnTableWidget::addGearColumnInNewRow(int row)
 {
     // last column is considered as "gear" column
     int gearColumn = columnCount() - 1;
-    setColumnWidth(gearColumn, GEAR_COLUMN_WIDTH);
 
     // set "gear" column not selectable. User can click on gear icon.
     QTableWidgetItem *item = new QTableWidgetItem("");
     item->setFlags(Qt::ItemIsEnabled);
     setItem(row, gearColumn, item);
-
-    // now set gear icon
-    addGearWidget(row);
-}
-
-/*
- * This internal functional sets gear icon in "gear" column
- */
-void MenuColumnTableWidget::addGearWidget(int row)
-{
-    QPixmap image;
-    QLabel *imageLabel = new QLabel();
-    if (image.load(":gfx/toolbar-icons/normal/Settings-24.png")) {
-        imageLabel->setFixedSize(image.size());
-        imageLabel->setPixmap(image);
-
-        // Create a widget that will contain a gear icon label widget
-        QWidget *labelWidget = new QWidget(this);
-        QHBoxLayout *horizontalLayout = new QHBoxLayout(labelWidget);
-        horizontalLayout->addWidget(imageLabel);          // Add label in the horizontal layout
-        horizontalLayout->setAlignment(Qt::AlignCenter);  // Center the label widget
-        horizontalLayout->setContentsMargins(0,0,0,0);    // Set the zero padding
-
-        int gearColumn = columnCount() - 1;
-        setCellWidget(row, gearColumn, labelWidget);
-    }
 }
 
 /*
@@ -213,11 +716,9 @@ void MenuColumnTableWidget::addGearWidget(int row)
 bool MenuColumnTableWidget::rowData(int row, QVariantMap *map)
 {
     if (row < rowCount()) {
-        for (int column = 0; column < totalColumns(); column++) {
-            QString data = cellData(row, column);
-            QString columnMapping = (column < m_columnMappings.size()) ? m_columnMappings[column] : QString::number(column);
-            (*map)[columnMapping] = data;
-        }
+        MenuColumnTableShared::rowData(m_columnMappings, totalColumns(), [this, row](int column) {
+            return cellData(row, column);
+        }, map);
         return true;
     }
     return false;
@@ -240,6 +741,29 @@ QString MenuColumnTableWidget::cellData(int row, int column)
     return data;
 }
 
+/*
+ * Name of every column (without "gear" one): its mapping or index if not mapped
+ */
+QStringList MenuColumnTableWidget::columnMappingNames()
+{
+    return MenuColumnTableShared::columnMappingNames(m_columnMappings, totalColumns());
+}
+
+MenuColumnTableColumns MenuColumnTableWidget::columnData()
+{
+    return MenuColumnTableExport::columns(model(), columnMappingNames());
+}
+
+bool MenuColumnTableWidget::exportCsv(QIODevice *device)
+{
+    return MenuColumnTableExport::writeCsv(model(), columnMappingNames(), device);
+}
+
+bool MenuColumnTableWidget::exportJson(QIODevice *device)
+{
+    return MenuColumnTableExport::writeJson(model(), columnMappingNames(), device);
+}
+
 /*
  * Get data in QVariantList. Each cell data is in QString format
  */
@@ -260,17 +784,107 @@ QVariantList MenuColumnTableWidget::data()
  */
 void MenuColumnTableWidget::setData(const QVariantList& list)
 {
+    {
+        QMutexLocker locker(&m_pendingRowsMutex);
+        m_pendingRows.clear();
+        m_pendingRowsOffset = 0;
+    }
+
+    BulkUpdateGuard guard(this);
     clearContents();
     setRowCount(0);
+    m_widthStats.clear();
+    fillRows(0, list);
+    contentChanged();
+}
 
-    int rows = list.size();
-    for (int row = 0; row < rows; row++) {
-        appendRow();
-        QVariantMap map = list[row].toMap();
-        for (int column = 0; column < totalColumns(); column++) {
-            QString columnMapping = (column < m_columnMappings.size()) ? m_columnMappings[column] : QString::number(column);
-            QString data = map[columnMapping].toString();
-            setText(row, column, data);
+void MenuColumnTableWidget::appendRows(const QVariantList& list)
+{
+    BulkUpdateGuard guard(this);
+    const int firstRow = rowCount();
+    fillRows(firstRow, list);
+    contentChanged(firstRow);
+}
+
+/*
+ * Sizes the table once for all rows of 'list', then fills them. Caller suspends updates
+ * and calls contentChanged() once for the batch.
+ */
+void MenuColumnTableWidget::fillRows(int firstRow, const QVariantList& list)
+{
+    const int count = list.size();
+    if (count == 0) {
+        return;
+    }
+    setRowCount(firstRow + count);
+
+    // Column mapping strings are resolved once, not per cell
+    const int columns = totalColumns();
+    const QStringList columnMappings = columnMappingNames();
+
+    for (int i = 0; i < count; i++) {
+        const int row = firstRow + i;
+        const QVariantMap map = list[i].toMap();
+        for (int column = 0; column < columns; column++) {
+            setCellText(row, column, map.value(columnMappings[column]).toString());
+        }
+        if (m_isGearHeaderColumnAdded) {
+            addGearColumnInNewRow(row);
+        }
+    }
+}
+
+void MenuColumnTableWidget::appendRowsAsync(const QVariantList& list)
+{
+    QMutexLocker locker(&m_pendingRowsMutex);
+    m_pendingRows.append(list);
+    // Batches arriving before the table gets to them are coalesced into one call
+    if (!m_isAppendPendingRowsScheduled) {
+        m_isAppendPendingRowsScheduled = true;
+        QMetaObject::invokeMethod(this, "appendPendingRows", Qt::QueuedConnection);
+    }
+}
+
+void MenuColumnTableWidget::setStreamChunkSize(int rows)
+{
+    QMutexLocker locker(&m_pendingRowsMutex);
+    m_streamChunkSize = qMax(1, rows);
+}
+
+int MenuColumnTableWidget::pendingRowCount() const
+{
+    QMutexLocker locker(&m_pendingRowsMutex);
+    return m_pendingRows.size() - m_pendingRowsOffset;
+}
+
+/*
+ * Appends one chunk and yields to the event loop before the next one
+ */
+void MenuColumnTableWidget::appendPendingRows()
+{
+    QVariantList rows;
+    int count = 0;
+    {
+        QMutexLocker locker(&m_pendingRowsMutex);
+        count = qMin(m_streamChunkSize, m_pendingRows.size() - m_pendingRowsOffset);
+        rows = m_pendingRows.mid(m_pendingRowsOffset, count);
+        m_pendingRowsOffset += count;
+        if (m_pendingRowsOffset >= m_pendingRows.size()) {
+            m_pendingRows.clear();
+            m_pendingRowsOffset = 0;
+            m_isAppendPendingRowsScheduled = false;
+        } else {
+            QMetaObject::invokeMethod(this, "appendPendingRows", Qt::QueuedConnection);
+        }
+    }
+
+    if (count > 0) {
+        {
+            BulkUpdateGuard guard(this);
+            const int firstRow = rowCount();
+            fillRows(firstRow, rows);
+            contentChanged(firstRow);
         }
+        emit pendingRowsAppended();
     }
 }
@@ -1,8 +1,14 @@
 #ifndef MENUCOLUMNTABLEWIDGET_H
 #define MENUCOLUMNTABLEWIDGET_H
 #include <QTableWidget>
+#include <QMutex>
+#include "MenuColumnTableExport.h"
+#include "MenuColumnTableFilterIndex.h"
+#include "MenuColumnTableWidthStats.h"
 
+class QTimer;
 class QModelIndex;
+class GearColumnDelegate;
 
 /*
  * This class extends QTableWidget and add "gear" icon in its last column to provide facility
@@ -29,34 +35,112 @@ public:
     bool rowData(int row, QVariantMap *map);
 
     QVariantList data();
+    // Replaces all rows. Table is sized once, updates and signals are suspended while loading.
     void setData(const QVariantList& list);
+    void appendRows(const QVariantList& list);
+
+    // Thread safe, for a background producer of a long listing. Batches are queued and appended
+    // on the event loop in chunks of at most 'rows' rows, so the UI stays responsive.
+    // setData() drops batches not appended yet.
+    void appendRowsAsync(const QVariantList& list);
+    void setStreamChunkSize(int rows);
+    int pendingRowCount() const;
 
     QString cellData(int row, int column);
 
+    // Export without a QVariantMap per row, see MenuColumnTableExport
+    MenuColumnTableColumns columnData();
+    bool exportCsv(QIODevice *device);
+    bool exportJson(QIODevice *device);
+
+    // Shows only rows containing 'text' (case insensitive). Applied when user stops typing
+    // for the debounce interval, rows added later are filtered too.
+    void setFilterText(const QString& text);
+    QString filterText() const;
+    // Pass -1 to filter on all columns
+    void setFilterColumn(int column);
+    void setFilterDebounceInterval(int ms);
+
+    // Sorts rows by 'column' on a worker thread using precomputed collation keys and
+    // reorders the table at once when done. Gear cells stay in place, selected row follows its data.
+    void sortRows(int column, Qt::SortOrder order = Qt::AscendingOrder);
+    // Header click sorts with sortRows(), do not combine with QTableWidget::setSortingEnabled()
+    void setAsyncSortingEnabled(bool on);
+
     void setEchoPasswordColumn(int column);
     void setUniformColumnWidth(bool on);
     // Pass -1 to disable
     void setStrechColumn(int column);
+    // Columns are as wide as their content (measured on a sample of rows), spare width goes
+    // to the stretch column or is spread over all columns
+    void setAutoColumnWidth(bool on);
 
 protected:
     void resizeEvent(QResizeEvent *event) override;
+    void changeEvent(QEvent *event) override;
+
+signals:
+    void pendingRowsAppended();
+    void filterApplied(int visibleRows);
+    void rowsSorted(int column, Qt::SortOrder order);
 
 private slots:
     void onItemClicked(const QModelIndex& index);
+    void appendPendingRows();
+    void applyFilter();
+    void onHeaderClicked(int column);
+    void resetAutoColumnWidth();
+    void onModelRowsInserted(const QModelIndex& parent, int first, int last);
+    void onModelRowsRemoved(const QModelIndex& parent, int first, int last);
+    void onModelDataChanged(const QModelIndex& topLeft, const QModelIndex& bottomRight);
+    void rebuildFilterIndex();
 
 private:
     void addGearColumnInNewRow(int row);
-    void addGearWidget(int row);
-     void resetColumnWidth();
+    // setText() without the per change bookkeeping, callers do it once per batch
+    void setCellText(int row, int column, const QString& text);
+    void contentChanged(int firstRow = 0);
+    void resetColumnWidth();
+    QStringList columnMappingNames();
+    void scheduleFilter();
+    void updateColumnWidthStats(int row, int column, const QString& text);
+    void scheduleAutoColumnWidthReset();
+    void measureColumnWidthSample();
+    bool measureColumnWidthRows(int firstRow);
+    void startSort(int column, Qt::SortOrder order, int sortedRows);
+    void applySort(quint64 sortRequest, quint64 contentGeneration, int column, Qt::SortOrder order, const QVector<int>& sortedNewToOld);
+    void fillRows(int firstRow, const QVariantList& list);
 
 private:
     int m_selectedRowIndex;
     QStringList m_columnMappings;
     bool m_isGearHeaderColumnAdded;
+    GearColumnDelegate *m_gearDelegate;
     QMenu *m_menu;
     int m_echoPasswordColumn;
     bool m_isUniformColumnWidth;
     int m_strechColumnIndex;
+
+    mutable QMutex m_pendingRowsMutex;
+    QVariantList m_pendingRows;
+    int m_pendingRowsOffset;
+    bool m_isAppendPendingRowsScheduled;
+    int m_streamChunkSize;
+
+    MenuColumnTableFilterIndex m_filterIndex;
+    bool m_isFilterIndexSyncSuspended;
+    QTimer *m_filterTimer;
+    QString m_filterText;
+    int m_filterColumn;
+
+    // Sort result is dropped if its rows changed meanwhile or a newer sort was requested
+    quint64 m_contentGeneration;
+    quint64 m_sortRequest;
+    int m_sortRowCount;     // rows covered by the latest sort request
+
+    bool m_isAutoColumnWidth;
+    bool m_isAutoColumnWidthResetScheduled;
+    MenuColumnTableWidthStats m_widthStats;
 };
 
 #endif // MENUCOLUMNTABLEWIDGET_H
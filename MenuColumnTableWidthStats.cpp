@@ -0,0 +1,128 @@
+#include "MenuColumnTableWidthStats.h"
+
+MenuColumnTableWidthStats::MenuColumnTableWidthStats(int sampleRows) :
+    m_fontMetrics(QFont()),
+    m_sampleRows(sampleRows)
+{
+}
+
+void MenuColumnTableWidthStats::setFont(const QFont& font)
+{
+    m_fontMetrics = QFontMetrics(font);
+    clear();
+}
+
+void MenuColumnTableWidthStats::clear()
+{
+    m_cellWidths.clear();
+    m_widthCounts.clear();
+}
+
+bool MenuColumnTableWidthStats::isSampled(int row) const
+{
+    return row >= 0 && row < m_sampleRows;
+}
+
+int MenuColumnTableWidthStats::rowCount() const
+{
+    return m_cellWidths.size();
+}
+
+bool MenuColumnTableWidthStats::setText(int row, int column, const QString& text)
+{
+    if (!isSampled(row) || column < 0) {
+        return false;
+    }
+    return setWidth(row, column, text.isEmpty() ? 0 : m_fontMetrics.horizontalAdvance(text));
+}
+
+int MenuColumnTableWidthStats::width(int column) const
+{
+    if (column < 0 || column >= m_widthCounts.size() || m_widthCounts[column].isEmpty()) {
+        return 0;
+    }
+    return m_widthCounts[column].lastKey();
+}
+
+bool MenuColumnTableWidthStats::setWidth(int row, int column, int width)
+{
+    if (row >= m_cellWidths.size()) {
+        m_cellWidths.resize(row + 1);
+    }
+    if (column >= m_widthCounts.size()) {
+        m_widthCounts.resize(column + 1);
+    }
+    QVector<int>& cells = m_cellWidths[row];
+    while (cells.size() <= column) {
+        // Not measured yet
+        cells.append(-1);
+    }
+
+    const int oldMax = this->width(column);
+    QMap<int, int>& counts = m_widthCounts[column];
+    const int oldWidth = cells[column];
+    if (oldWidth == width) {
+        return false;
+    }
+    if (oldWidth >= 0) {
+        auto it = counts.find(oldWidth);
+        if (it != counts.end() && --(*it) == 0) {
+            counts.erase(it);
+        }
+    }
+    cells[column] = width;
+    counts[width]++;
+    return this->width(column) != oldMax;
+}
+
+bool MenuColumnTableWidthStats::insertRows(int row, int count)
+{
+    if (row < 0 || row >= m_cellWidths.size() || count <= 0) {
+        // Nothing measured at or after 'row'
+        return false;
+    }
+    const QVector<int> oldMax = maxWidths();
+    m_cellWidths.insert(row, count, QVector<int>());
+    while (m_cellWidths.size() > m_sampleRows) {
+        forgetRow(m_cellWidths.last());
+        m_cellWidths.removeLast();
+    }
+    return maxWidths() != oldMax;
+}
+
+bool MenuColumnTableWidthStats::removeRows(int row, int count)
+{
+    if (row < 0 || row >= m_cellWidths.size() || count <= 0) {
+        return false;
+    }
+    count = qMin(count, m_cellWidths.size() - row);
+    const QVector<int> oldMax = maxWidths();
+    for (int i = row; i < row + count; ++i) {
+        forgetRow(m_cellWidths[i]);
+    }
+    m_cellWidths.remove(row, count);
+    return maxWidths() != oldMax;
+}
+
+void MenuColumnTableWidthStats::forgetRow(const QVector<int>& cells)
+{
+    for (int column = 0; column < cells.size(); ++column) {
+        if (cells[column] < 0) {
+            continue;
+        }
+        QMap<int, int>& counts = m_widthCounts[column];
+        auto it = counts.find(cells[column]);
+        if (it != counts.end() && --(*it) == 0) {
+            counts.erase(it);
+        }
+    }
+}
+
+QVector<int> MenuColumnTableWidthStats::maxWidths() const
+{
+    QVector<int> ret(m_widthCounts.size());
+    for (int column = 0; column < ret.size(); ++column) {
+        ret[column] = width(column);
+    }
+    return ret;
+}
@@ -0,0 +1,43 @@
+#ifndef MENUCOLUMNTABLEWIDTHSTATS_H
+#define MENUCOLUMNTABLEWIDTHSTATS_H
+#include <QFontMetrics>
+#include <QVector>
+#include <QMap>
+
+/*
+ * Text widths of a bounded sample of table rows (first 'sampleRows' rows), per column.
+ * Widths are measured once per cell change with cached font metrics and counted per column,
+ * so the widest sampled cell is known without scanning rows, even after the widest one changes.
+ */
+class MenuColumnTableWidthStats {
+public:
+    explicit MenuColumnTableWidthStats(int sampleRows = 2000);
+
+    // Forgets all widths, the sample has to be measured again
+    void setFont(const QFont& font);
+    void clear();
+
+    bool isSampled(int row) const;
+    // Rows measured so far (sampled rows up to the last one set)
+    int rowCount() const;
+    // Returns true if max width of the column changed
+    bool setText(int row, int column, const QString& text);
+    // Table rows were inserted or removed, sampled rows move with them. Rows pushed out of the
+    // sample are forgotten, rows moved into it are not measured. Return true if max width of any column changed.
+    bool insertRows(int row, int count);
+    bool removeRows(int row, int count);
+    // Widest sampled cell of the column, 0 if none
+    int width(int column) const;
+
+private:
+    bool setWidth(int row, int column, int width);
+    void forgetRow(const QVector<int>& cells);
+    QVector<int> maxWidths() const;
+
+    QFontMetrics m_fontMetrics;
+    int m_sampleRows;
+    QVector<QVector<int> > m_cellWidths;        // [row][column] of sampled rows
+    QVector<QMap<int, int> > m_widthCounts;     // [column] width -> number of cells
+};
+
+#endif // MENUCOLUMNTABLEWIDTHSTATS_H
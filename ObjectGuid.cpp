@@ -0,0 +1,154 @@
+#include "ObjectGuid.h"
+
+namespace ActiveDirectory {
+
+namespace {
+
+inline int hexValue(ushort c)
+{
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+} // anonymous namespace
+
+////////////////////////////////////////////////////////////////////////////////
+// ObjectGuid
+
+ObjectGuid ObjectGuid::fromString(const QString& str)
+{
+    const QChar *data = str.constData();
+    int begin = 0;
+    int end = str.size();
+    if (end >= 2 && data[0] == '{' && data[end - 1] == '}') {
+        begin++;
+        end--;
+    }
+    int length = end - begin;
+    bool hasDashes = (length == 36);
+    if (!hasDashes && length != 32) {
+        return ObjectGuid();
+    }
+
+    ObjectGuid ret;
+    int digits = 0;
+    for (int i = begin; i < end; ++i) {
+        int position = i - begin;
+        if (hasDashes && (position == 8 || position == 13 || position == 18 || position == 23)) {
+            if (data[i] != '-') {
+                return ObjectGuid();
+            }
+            continue;
+        }
+        int value = hexValue(data[i].unicode());
+        if (value < 0) {
+            return ObjectGuid();
+        }
+        quint64& half = (digits < 16) ? ret.m_high : ret.m_low;
+        half = (half << 4) | static_cast<quint64>(value);
+        digits++;
+    }
+    return ret;
+}
+
+ObjectGuid ObjectGuid::fromByteArray(const QByteArray& bytes)
+{
+    ObjectGuid ret;
+    if (bytes.size() != 16) {
+        return ret;
+    }
+    for (int i = 0; i < 8; ++i) {
+        ret.m_high = (ret.m_high << 8) | static_cast<uchar>(bytes[i]);
+        ret.m_low = (ret.m_low << 8) | static_cast<uchar>(bytes[i + 8]);
+    }
+    return ret;
+}
+
+QString ObjectGuid::toString() const
+{
+    QString hex = QString("%1%2").arg(m_high, 16, 16, QChar('0')).arg(m_low, 16, 16, QChar('0'));
+    return hex.left(8) + '-' + hex.mid(8, 4) + '-' + hex.mid(12, 4) + '-' + hex.mid(16, 4) + '-' + hex.mid(20);
+}
+
+QByteArray ObjectGuid::toByteArray() const
+{
+    QByteArray ret(16, Qt::Uninitialized);
+    for (int i = 0; i < 8; ++i) {
+        ret[7 - i] = static_cast<char>((m_high >> (i * 8)) & 0xff);
+        ret[15 - i] = static_cast<char>((m_low >> (i * 8)) & 0xff);
+    }
+    return ret;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// HostNameTable
+
+HostId HostNameTable::intern(const QString& host)
+{
+    QString k = key(host);
+    if (k.isEmpty()) {
+        return 0;
+    }
+
+    HostNameTable *table = instance();
+    {
+        QReadLocker locker(&table->m_lock);
+        HostId id = table->m_ids.value(k, 0);
+        if (id != 0) {
+            return id;
+        }
+    }
+
+    QWriteLocker locker(&table->m_lock);
+    HostId& id = table->m_ids[k];
+    if (id == 0) {
+        table->m_names.append(host.trimmed());
+        id = static_cast<HostId>(table->m_names.size());
+    }
+    return id;
+}
+
+HostId HostNameTable::find(const QString& host)
+{
+    HostNameTable *table = instance();
+    QReadLocker locker(&table->m_lock);
+    return table->m_ids.value(key(host), 0);
+}
+
+QString HostNameTable::name(HostId id)
+{
+    HostNameTable *table = instance();
+    QReadLocker locker(&table->m_lock);
+    if (id == 0 || static_cast<int>(id) > table->m_names.size()) {
+        return QString();
+    }
+    return table->m_names[id - 1];
+}
+
+int HostNameTable::size()
+{
+    HostNameTable *table = instance();
+    QReadLocker locker(&table->m_lock);
+    return table->m_names.size();
+}
+
+QString HostNameTable::key(const QString& host)
+{
+    return host.trimmed().toLower();
+}
+
+HostNameTable *HostNameTable::instance()
+{
+    static HostNameTable table;
+    return &table;
+}
+
+} // namespace ActiveDirectory
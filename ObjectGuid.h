@@ -0,0 +1,77 @@
+#ifndef OBJECTGUID_H
+#define OBJECTGUID_H
+#include <QString>
+#include <QByteArray>
+#include <QHash>
+#include <QReadWriteLock>
+#include <QVector>
+
+namespace ActiveDirectory {
+
+/*
+ * 16 byte objectGUID. Compares and hashes as two integers instead of a 36+ character string.
+ * Bytes are kept in the order of the text form, so binary (BLOB) order matches text order.
+ */
+class ObjectGuid {
+public:
+    ObjectGuid() : m_high(0), m_low(0) {}
+
+    // Accepts "{xxxxxxxx-xxxx-xxxx-xxxx-xxxxxxxxxxxx}", the same without braces or 32 hex digits.
+    // Returns a null guid if 'str' is not a guid.
+    static ObjectGuid fromString(const QString& str);
+    // 'bytes' must have 16 bytes, as returned by toByteArray()
+    static ObjectGuid fromByteArray(const QByteArray& bytes);
+
+    bool isNull() const { return m_high == 0 && m_low == 0; }
+    // Lower case, with dashes, without braces
+    QString toString() const;
+    QByteArray toByteArray() const;
+
+    quint64 high() const { return m_high; }
+    quint64 low() const { return m_low; }
+
+    bool operator==(const ObjectGuid& other) const { return m_high == other.m_high && m_low == other.m_low; }
+    bool operator!=(const ObjectGuid& other) const { return !(*this == other); }
+    bool operator<(const ObjectGuid& other) const { return m_high < other.m_high || (m_high == other.m_high && m_low < other.m_low); }
+
+private:
+    quint64 m_high;
+    quint64 m_low;
+};
+
+inline uint qHash(const ObjectGuid& guid, uint seed = 0)
+{
+    return qHash(guid.high() ^ (guid.low() * Q_UINT64_C(0x9e3779b97f4a7c15)), seed);
+}
+
+// Small integer standing for a host name, 0 is no host
+typedef quint32 HostId;
+
+/*
+ * Process wide table of interned host names. Host names are compared case insensitively,
+ * so "DC1.corp" and "dc1.CORP" get the same id. Ids are never reused, the table only grows
+ * (there are a few DCs per forest). Thread safe.
+ */
+class HostNameTable {
+public:
+    static HostId intern(const QString& host);
+    // Returns 0 if the host was never interned
+    static HostId find(const QString& host);
+    // Host name as first interned
+    static QString name(HostId id);
+    static int size();
+
+private:
+    static QString key(const QString& host);
+    static HostNameTable *instance();
+
+    QReadWriteLock m_lock;
+    QHash<QString, HostId> m_ids;
+    QVector<QString> m_names;
+};
+
+} // namespace ActiveDirectory
+
+Q_DECLARE_TYPEINFO(ActiveDirectory::ObjectGuid, Q_PRIMITIVE_TYPE);
+
+#endif // OBJECTGUID_H
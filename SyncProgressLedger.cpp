@@ -0,0 +1,253 @@
+#include "SyncProgressLedger.h"
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QVariant>
+#include <QDateTime>
+#include <QsLog.h>
+
+#define SYNC_WATERMARK_TABLE "active_directory_sync_watermark"
+#define SYNC_KNOWLEDGE_TABLE "active_directory_sync_knowledge"
+
+namespace ActiveDirectory {
+
+namespace {
+
+enum WatermarkKind {
+    CheckpointWatermark = 0,
+    ObservationWatermark,
+    // Previous observation already covered by knowledge, kept when a newer one replaces it
+    CoveredObservationWatermark
+};
+
+bool isCovered(const QHash<QString, qint64>& upToDateVector, const QHash<QString, qint64>& knowledge)
+{
+    for (auto it = upToDateVector.constBegin(); it != upToDateVector.constEnd(); ++it) {
+        if (knowledge.value(it.key(), -1) < it.value()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool upsertWatermark(const QString& forestGuid, const QString& invocationId, int kind, const QString& host,
+                     qint64 usn, const QString& upToDateVector, QSqlDatabase db)
+{
+    QSqlQuery query(db);
+    query.prepare("INSERT OR REPLACE INTO " SYNC_WATERMARK_TABLE
+                  " (forest_guid, invocation_id, kind, host, usn, up_to_dateness, recorded_at) VALUES (?, ?, ?, ?, ?, ?, ?)");
+    query.addBindValue(forestGuid);
+    query.addBindValue(invocationId);
+    query.addBindValue(kind);
+    query.addBindValue(host);
+    query.addBindValue(usn);
+    query.addBindValue(upToDateVector);
+    query.addBindValue(QDateTime::currentMSecsSinceEpoch());
+    bool ret = query.exec();
+    if (!ret) {
+        QLOG_ERROR() << "Cannot write sync watermark of DC" << host << query.lastError().text();
+    }
+    return ret;
+}
+
+} // namespace
+
+bool DirectoryReplicationState::isValid() const
+{
+    return !invocationId.isEmpty() && highestCommittedUsn >= 0;
+}
+
+QString DirectoryReplicationState::upToDateVectorToString() const
+{
+    QStringList parts;
+    for (auto it = upToDateVector.constBegin(); it != upToDateVector.constEnd(); ++it) {
+        parts.append(it.key() + "=" + QString::number(it.value()));
+    }
+    return parts.join(';');
+}
+
+QHash<QString, qint64> DirectoryReplicationState::upToDateVectorFromString(const QString& str)
+{
+    QHash<QString, qint64> ret;
+    foreach (const QString& part, str.split(';', QString::SkipEmptyParts)) {
+        int separator = part.lastIndexOf('=');
+        if (separator > 0) {
+            ret.insert(part.left(separator), part.mid(separator + 1).toLongLong());
+        }
+    }
+    return ret;
+}
+
+bool SyncProgressLedger::createTablesIfNotExist(QSqlDatabase db)
+{
+    QSqlQuery query(db);
+    bool ret = query.exec("CREATE TABLE IF NOT EXISTS " SYNC_WATERMARK_TABLE " ("
+                          " forest_guid TEXT NOT NULL,"
+                          " invocation_id TEXT NOT NULL,"
+                          " kind INTEGER NOT NULL,"
+                          " host TEXT,"
+                          " usn INTEGER NOT NULL,"
+                          " up_to_dateness TEXT,"
+                          " recorded_at INTEGER NOT NULL,"
+                          " PRIMARY KEY (forest_guid, invocation_id, kind))") &&
+               query.exec("CREATE TABLE IF NOT EXISTS " SYNC_KNOWLEDGE_TABLE " ("
+                          " forest_guid TEXT NOT NULL,"
+                          " invocation_id TEXT NOT NULL,"
+                          " usn INTEGER NOT NULL,"
+                          " PRIMARY KEY (forest_guid, invocation_id))");
+    if (!ret) {
+        QLOG_ERROR() << "Cannot create sync progress tables" << query.lastError().text();
+    }
+    return ret;
+}
+
+bool SyncProgressLedger::recordObservation(const QString& forestGuid, const QString& host, const DirectoryReplicationState& state, QSqlDatabase db)
+{
+    if (!state.isValid() || !createTablesIfNotExist(db)) {
+        return false;
+    }
+
+    // The observation being replaced may be the only one usable for a failover
+    QSqlQuery query(db);
+    query.prepare("SELECT host, usn, up_to_dateness FROM " SYNC_WATERMARK_TABLE " WHERE forest_guid = ? AND invocation_id = ? AND kind = ?");
+    query.addBindValue(forestGuid);
+    query.addBindValue(state.invocationId);
+    query.addBindValue(static_cast<int>(ObservationWatermark));
+    if (query.exec() && query.next()) {
+        QString previousHost = query.value(0).toString();
+        qint64 previousUsn = query.value(1).toLongLong();
+        QString previousVector = query.value(2).toString();
+        query.finish();
+        if (isCovered(DirectoryReplicationState::upToDateVectorFromString(previousVector), knowledge(forestGuid, db)) &&
+                !upsertWatermark(forestGuid, state.invocationId, CoveredObservationWatermark, previousHost, previousUsn, previousVector, db)) {
+            return false;
+        }
+    }
+
+    return upsertWatermark(forestGuid, state.invocationId, ObservationWatermark, host,
+                           state.highestCommittedUsn, state.upToDateVectorToString(), db);
+}
+
+bool SyncProgressLedger::recordCheckpoint(const QString& forestGuid, const QString& host, const DirectoryReplicationState& stateAtStart,
+                                          qint64 syncedUsn, QSqlDatabase db)
+{
+    if (!stateAtStart.isValid() || !createTablesIfNotExist(db)) {
+        return false;
+    }
+    if (!upsertWatermark(forestGuid, stateAtStart.invocationId, CheckpointWatermark, host, syncedUsn,
+                         stateAtStart.upToDateVectorToString(), db)) {
+        return false;
+    }
+
+    // Changes originating on the DC itself are synced up to 'syncedUsn'. Everything the DC had
+    // replicated from others is synced only if the sync got past its state at start.
+    QHash<QString, qint64> synced;
+    if (syncedUsn >= stateAtStart.highestCommittedUsn) {
+        synced = stateAtStart.upToDateVector;
+    }
+    synced[stateAtStart.invocationId] = qMax(synced.value(stateAtStart.invocationId, -1), syncedUsn);
+
+    QVariantList forestGuids, invocationIds, usns;
+    for (auto it = synced.constBegin(); it != synced.constEnd(); ++it) {
+        forestGuids.append(forestGuid);
+        invocationIds.append(it.key());
+        usns.append(it.value());
+    }
+
+    QSqlQuery insert(db);
+    insert.prepare("INSERT OR IGNORE INTO " SYNC_KNOWLEDGE_TABLE " (forest_guid, invocation_id, usn) VALUES (?, ?, ?)");
+    insert.addBindValue(forestGuids);
+    insert.addBindValue(invocationIds);
+    insert.addBindValue(usns);
+    QSqlQuery update(db);
+    update.prepare("UPDATE " SYNC_KNOWLEDGE_TABLE " SET usn = MAX(usn, ?) WHERE forest_guid = ? AND invocation_id = ?");
+    update.addBindValue(usns);
+    update.addBindValue(forestGuids);
+    update.addBindValue(invocationIds);
+    if (!insert.execBatch() || !update.execBatch()) {
+        QLOG_ERROR() << "Cannot update sync knowledge of forest" << forestGuid << insert.lastError().text() << update.lastError().text();
+        return false;
+    }
+    return true;
+}
+
+bool SyncProgressLedger::resumeUsn(const QString& forestGuid, const DirectoryReplicationState& current, qint64 *outUsn, QSqlDatabase db)
+{
+    if (!current.isValid() || !createTablesIfNotExist(db)) {
+        return false;
+    }
+
+    QSqlQuery query(db);
+    query.prepare("SELECT kind, usn, up_to_dateness FROM " SYNC_WATERMARK_TABLE " WHERE forest_guid = ? AND invocation_id = ?");
+    query.addBindValue(forestGuid);
+    query.addBindValue(current.invocationId);
+    if (!query.exec()) {
+        QLOG_ERROR() << "Cannot read sync watermarks of forest" << forestGuid << query.lastError().text();
+        return false;
+    }
+
+    QHash<QString, qint64> forestKnowledge = knowledge(forestGuid, db);
+    qint64 best = -1;
+    while (query.next()) {
+        int kind = query.value(0).toInt();
+        qint64 usn = query.value(1).toLongLong();
+        if (usn > current.highestCommittedUsn) {
+            // USN went back with the same invocationId, our positions on this DC mean nothing
+            QLOG_ERROR() << "USN rollback detected on DC with invocationId" << current.invocationId << "full sync is needed";
+            return false;
+        }
+        bool isSafe = (kind == CheckpointWatermark) ||
+                      isCovered(DirectoryReplicationState::upToDateVectorFromString(query.value(2).toString()), forestKnowledge);
+        if (isSafe && usn > best) {
+            best = usn;
+        }
+    }
+
+    if (best < 0) {
+        QLOG_SUPPORT() << "No safe sync position on DC with invocationId" << current.invocationId << "full sync is needed";
+        return false;
+    }
+    *outUsn = best;
+    return true;
+}
+
+bool SyncProgressLedger::deleteOfForests(const QStringList& forestGuids, QSqlDatabase db)
+{
+    if (forestGuids.isEmpty()) {
+        return true;
+    }
+    if (!createTablesIfNotExist(db)) {
+        return false;
+    }
+
+    QVariantList values;
+    foreach (const QString& forestGuid, forestGuids) {
+        values.append(forestGuid);
+    }
+    QSqlQuery watermarks(db);
+    watermarks.prepare("DELETE FROM " SYNC_WATERMARK_TABLE " WHERE forest_guid = ?");
+    watermarks.addBindValue(values);
+    QSqlQuery knowledge(db);
+    knowledge.prepare("DELETE FROM " SYNC_KNOWLEDGE_TABLE " WHERE forest_guid = ?");
+    knowledge.addBindValue(values);
+    bool ret = watermarks.execBatch() && knowledge.execBatch();
+    if (!ret) {
+        QLOG_ERROR() << "Cannot delete sync progress of forests" << watermarks.lastError().text() << knowledge.lastError().text();
+    }
+    return ret;
+}
+
+QHash<QString, qint64> SyncProgressLedger::knowledge(const QString& forestGuid, QSqlDatabase db)
+{
+    QHash<QString, qint64> ret;
+    QSqlQuery query(db);
+    query.prepare("SELECT invocation_id, usn FROM " SYNC_KNOWLEDGE_TABLE " WHERE forest_guid = ?");
+    query.addBindValue(forestGuid);
+    if (query.exec()) {
+        while (query.next()) {
+            ret.insert(query.value(0).toString(), query.value(1).toLongLong());
+        }
+    }
+    return ret;
+}
+
+} // namespace ActiveDirectory
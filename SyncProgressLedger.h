@@ -0,0 +1,69 @@
+#ifndef SYNCPROGRESSLEDGER_H
+#define SYNCPROGRESSLEDGER_H
+#include <QHash>
+#include <QString>
+#include <QStringList>
+#include <QSqlDatabase>
+
+namespace ActiveDirectory {
+
+/*
+ * Replication state of a domain controller as read by the sync engine: invocationId and
+ * highestCommittedUSN from rootDSE/nTDSDSA and the up-to-dateness vector (msDS-NCReplCursors,
+ * originating invocationId -> USN, including the DC itself).
+ */
+struct DirectoryReplicationState {
+    QString invocationId;
+    qint64 highestCommittedUsn;
+    QHash<QString, qint64> upToDateVector;
+
+    DirectoryReplicationState() : highestCommittedUsn(-1) {}
+    bool isValid() const;
+
+    QString upToDateVectorToString() const;
+    static QHash<QString, qint64> upToDateVectorFromString(const QString& str);
+};
+
+/*
+ * Forest wide bookkeeping of sync progress keyed by DC invocationId instead of host, so a
+ * failover to another DC (or removal of a DC from configuration) does not force a full sync.
+ *
+ * USNs are local to a DC, so a position on one DC cannot be translated to another one directly.
+ * Instead the ledger keeps:
+ *  - checkpoints: DC invocationId -> USN up to which we synced from that DC
+ *  - observations: DC invocationId -> highestCommittedUSN and up-to-dateness vector seen at some time
+ *  - knowledge of the forest: originating invocationId -> USN of changes we have synced
+ *    (merged from up-to-dateness vectors of DCs we completed a sync from)
+ * A DC can be resumed from its checkpoint, or from an observation whose up-to-dateness vector
+ * is covered by our knowledge (we already have everything that DC had then). Everything else,
+ * or a DC whose USN went back (restore), needs a full sync.
+ *
+ * DomainControllerManager records an observation of every selected DC when it is given a
+ * replication state reader (setReplicationStateReader()). Fetching changes is done by the sync
+ * engine: when nextForest() hands it a DC its sync context does not know, it calls resumeUsn()
+ * before falling back to a full sync, and recordCheckpoint() after every committed sync.
+ */
+class SyncProgressLedger {
+public:
+    static bool createTablesIfNotExist(QSqlDatabase db);
+
+    // DC state seen without syncing from it, i.e. when probed
+    static bool recordObservation(const QString& forestGuid, const QString& host, const DirectoryReplicationState& state, QSqlDatabase db);
+    // Sync from the DC completed up to 'syncedUsn'. 'stateAtStart' was read before the sync started.
+    // Call inside the transaction which commits the synced data.
+    static bool recordCheckpoint(const QString& forestGuid, const QString& host, const DirectoryReplicationState& stateAtStart,
+                                 qint64 syncedUsn, QSqlDatabase db);
+
+    // USN from which changes of the DC in 'current' state can be fetched without missing any.
+    // Returns false if that cannot be proven, then a full sync is needed.
+    static bool resumeUsn(const QString& forestGuid, const DirectoryReplicationState& current, qint64 *outUsn, QSqlDatabase db);
+
+    static bool deleteOfForests(const QStringList& forestGuids, QSqlDatabase db);
+
+private:
+    static QHash<QString, qint64> knowledge(const QString& forestGuid, QSqlDatabase db);
+};
+
+} // namespace ActiveDirectory
+
+#endif // SYNCPROGRESSLEDGER_H
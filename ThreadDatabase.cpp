@@ -0,0 +1,113 @@
+#include "ThreadDatabase.h"
+#include <QThread>
+#include <QThreadStorage>
+#include <QHash>
+#include <QAtomicInt>
+#include <QSqlDriver>
+#include <QsLog.h>
+
+namespace ActiveDirectory {
+
+namespace {
+
+/*
+ * Clones opened by one thread. QThreadStorage deletes it when the thread finishes,
+ * so connections of expired pool threads are closed and a new thread never gets
+ * a connection opened by a dead one.
+ */
+class ThreadConnections {
+public:
+    ThreadConnections() :
+        m_threadNumber(nextThreadNumber().fetchAndAddRelaxed(1))
+    {
+    }
+
+    ~ThreadConnections()
+    {
+        foreach (const QString& cloneName, m_connectionNames) {
+            removeClone(cloneName);
+        }
+    }
+
+    // db connection name -> clone connection name
+    QString connectionName(const QString& dbConnectionName) const
+    {
+        return QString("%1-thread-%2").arg(dbConnectionName).arg(m_threadNumber);
+    }
+
+    void add(const QString& dbConnectionName)
+    {
+        m_connectionNames.insert(dbConnectionName, connectionName(dbConnectionName));
+    }
+
+    void remove(const QString& dbConnectionName)
+    {
+        removeClone(m_connectionNames.take(dbConnectionName));
+    }
+
+private:
+    static void removeClone(const QString& cloneName)
+    {
+        if (QSqlDatabase::contains(cloneName)) {
+            {
+                QSqlDatabase clone = QSqlDatabase::database(cloneName, false);
+                clone.close();
+            }
+            QSqlDatabase::removeDatabase(cloneName);
+        }
+    }
+
+    static QAtomicInt& nextThreadNumber()
+    {
+        static QAtomicInt number(1);
+        return number;
+    }
+
+    int m_threadNumber;
+    QHash<QString, QString> m_connectionNames;
+};
+
+QThreadStorage<ThreadConnections *>& threadConnections()
+{
+    static QThreadStorage<ThreadConnections *> storage;
+    return storage;
+}
+
+ThreadConnections *connectionsOfCurrentThread()
+{
+    if (!threadConnections().hasLocalData()) {
+        threadConnections().setLocalData(new ThreadConnections());
+    }
+    return threadConnections().localData();
+}
+
+} // anonymous namespace
+
+QSqlDatabase databaseForCurrentThread(const QSqlDatabase& db)
+{
+    if (!db.isValid() || (db.driver() && db.driver()->thread() == QThread::currentThread())) {
+        return db;
+    }
+
+    ThreadConnections *connections = connectionsOfCurrentThread();
+    QString connectionName = connections->connectionName(db.connectionName());
+    if (QSqlDatabase::contains(connectionName)) {
+        return QSqlDatabase::database(connectionName);
+    }
+    // Cloning by name does not touch the connection owned by the other thread
+    QSqlDatabase clone = QSqlDatabase::cloneDatabase(db.connectionName(), connectionName);
+    connections->add(db.connectionName());
+    if (!clone.open()) {
+        QLOG_ERROR() << "Cannot open database connection" << connectionName;
+    }
+    return clone;
+}
+
+void removeDatabaseForCurrentThread(const QSqlDatabase& db)
+{
+    if (threadConnections().hasLocalData()) {
+        threadConnections().localData()->remove(db.connectionName());
+    }
+}
+
+} // namespace ActiveDirectory
@@ -0,0 +1,19 @@
+#ifndef THREADDATABASE_H
+#define THREADDATABASE_H
+#include <QSqlDatabase>
+
+namespace ActiveDirectory {
+
+/*
+ * QSqlDatabase connection can be used only from the thread which created it.
+ * Returns 'db' itself when called from its owner thread, otherwise a clone of it
+ * opened once per calling thread. The clone is closed and removed when its thread finishes.
+ */
+QSqlDatabase databaseForCurrentThread(const QSqlDatabase& db);
+
+// Closes and removes the clone created for calling thread (if any)
+void removeDatabaseForCurrentThread(const QSqlDatabase& db);
+
+} // namespace ActiveDirectory
+
+#endif // THREADDATABASE_H
@@ -0,0 +1,166 @@
+#include "BenchmarkDatabase.h"
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QVariant>
+#include <QAtomicInt>
+#include <QTextStream>
+#include "ForestSchema.h"
+
+namespace ActiveDirectory {
+
+namespace {
+
+QAtomicInt& nextDatabaseNumber()
+{
+    static QAtomicInt number(1);
+    return number;
+}
+
+} // anonymous namespace
+
+BenchmarkDatabase::BenchmarkDatabase() :
+    m_connectionName(QString("benchmark-%1").arg(nextDatabaseNumber().fetchAndAddRelaxed(1)))
+{
+    QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", m_connectionName);
+    db.setDatabaseName(m_dir.filePath("benchmark.db"));
+    if (!db.open()) {
+        QTextStream(stderr) << "Cannot open benchmark database: " << db.lastError().text() << "\n";
+        return;
+    }
+
+    QSqlQuery query(db);
+    const char *statements[] = {
+        "CREATE TABLE " FOREST_TABLE " (" FOREST_OBJECT_GUID_COLUMN " TEXT PRIMARY KEY, " FOREST_USER_NAME_COLUMN " TEXT, "
+            FOREST_PASSWORD_COLUMN " TEXT, " FOREST_SYNC_GROUP_COLUMN " TEXT)",
+        "CREATE TABLE " DC_MEMBERSHIP_TABLE " (" DC_MEMBERSHIP_FOREST_GUID_COLUMN " TEXT, " DC_MEMBERSHIP_HOST_COLUMN " TEXT, "
+            DC_MEMBERSHIP_IS_PRIMARY_COLUMN " INTEGER, " DC_MEMBERSHIP_FULL_SERVER_NAME_COLUMN " TEXT)",
+        "CREATE INDEX " DC_MEMBERSHIP_TABLE "_forest_idx ON " DC_MEMBERSHIP_TABLE " (" DC_MEMBERSHIP_FOREST_GUID_COLUMN ")",
+        "CREATE TABLE " SYNC_CONTEXT_TABLE " (" SYNC_CONTEXT_FOREST_GUID_COLUMN " TEXT, " SYNC_CONTEXT_DC_HOST_COLUMN " TEXT)",
+        "CREATE TABLE " AD_USER_TABLE " (" AD_USER_OBJECT_GUID_COLUMN " TEXT, " AD_USER_FOREST_GUID_COLUMN " TEXT, "
+            AD_USER_IS_DELETED_COLUMN " INTEGER DEFAULT 0)",
+        "CREATE TABLE " AD_GROUP_TABLE " (" AD_GROUP_OBJECT_GUID_COLUMN " TEXT, " AD_GROUP_FOREST_GUID_COLUMN " TEXT, "
+            AD_GROUP_IS_DELETED_COLUMN " INTEGER DEFAULT 0)",
+        "CREATE TABLE " FOREST_GROUP_MEMBERSHIP_TABLE " (" FOREST_GROUP_MEMBERSHIP_FOREST_GUID_COLUMN " TEXT)"
+    };
+    for (const char *sql : statements) {
+        if (!query.exec(sql)) {
+            QTextStream(stderr) << "Cannot create benchmark table: " << query.lastError().text() << "\n";
+        }
+    }
+}
+
+BenchmarkDatabase::~BenchmarkDatabase()
+{
+    {
+        QSqlDatabase db = QSqlDatabase::database(m_connectionName, false);
+        db.close();
+    }
+    QSqlDatabase::removeDatabase(m_connectionName);
+}
+
+bool BenchmarkDatabase::isOpen() const
+{
+    return database().isOpen();
+}
+
+QSqlDatabase BenchmarkDatabase::database() const
+{
+    return QSqlDatabase::database(m_connectionName, false);
+}
+
+QString BenchmarkDatabase::path() const
+{
+    return database().databaseName();
+}
+
+bool BenchmarkDatabase::insert(const QVector<Forest>& forests)
+{
+    QSqlDatabase db = database();
+    QVariantList guids, userNames, passwords, syncGroups;
+    QVariantList dcForestGuids, hosts, isPrimary, dnsNames;
+    foreach (const Forest& forest, forests) {
+        guids.append(forest.objectGuid);
+        userNames.append(forest.userName);
+        passwords.append(forest.password);
+        syncGroups.append(forest.syncGroup);
+        foreach (const DomainController& dc, forest.domainControllers) {
+            dcForestGuids.append(forest.objectGuid);
+            hosts.append(dc.host);
+            isPrimary.append(dc.isPrimary ? 1 : 0);
+            dnsNames.append(dc.dnsName);
+        }
+    }
+
+    db.transaction();
+    QSqlQuery forestQuery(db);
+    forestQuery.prepare("INSERT INTO " FOREST_TABLE " (" FOREST_OBJECT_GUID_COLUMN ", " FOREST_USER_NAME_COLUMN ", "
+                        FOREST_PASSWORD_COLUMN ", " FOREST_SYNC_GROUP_COLUMN ") VALUES (?, ?, ?, ?)");
+    forestQuery.addBindValue(guids);
+    forestQuery.addBindValue(userNames);
+    forestQuery.addBindValue(passwords);
+    forestQuery.addBindValue(syncGroups);
+    QSqlQuery dcQuery(db);
+    dcQuery.prepare("INSERT INTO " DC_MEMBERSHIP_TABLE " (" DC_MEMBERSHIP_FOREST_GUID_COLUMN ", " DC_MEMBERSHIP_HOST_COLUMN ", "
+                    DC_MEMBERSHIP_IS_PRIMARY_COLUMN ", " DC_MEMBERSHIP_FULL_SERVER_NAME_COLUMN ") VALUES (?, ?, ?, ?)");
+    dcQuery.addBindValue(dcForestGuids);
+    dcQuery.addBindValue(hosts);
+    dcQuery.addBindValue(isPrimary);
+    dcQuery.addBindValue(dnsNames);
+    if (!forestQuery.execBatch() || !dcQuery.execBatch()) {
+        QTextStream(stderr) << "Cannot insert benchmark forests: " << forestQuery.lastError().text() << dcQuery.lastError().text() << "\n";
+        db.rollback();
+        return false;
+    }
+    return db.commit();
+}
+
+QVector<Forest> BenchmarkDatabase::syntheticForests(int forestCount, int dcCount, int firstIndex)
+{
+    QVector<Forest> forests;
+    forests.reserve(forestCount);
+    for (int i = firstIndex; i < firstIndex + forestCount; ++i) {
+        Forest forest;
+        forest.objectGuid = syntheticGuid(i);
+        forest.userName = QString("admin%1@forest%1.test").arg(i);
+        forest.password = QString("password%1").arg(i);
+        forest.syncGroup = QString("CN=qliq,OU=Groups,DC=forest%1,DC=test").arg(i);
+        for (int j = 0; j < dcCount; ++j) {
+            DomainController dc;
+            dc.host = QString("dc%1.forest%2.test").arg(j).arg(i);
+            dc.isPrimary = (j == 0);
+            forest.domainControllers.append(dc);
+        }
+        forests.append(forest);
+    }
+    return forests;
+}
+
+QVector<Forest> BenchmarkDatabase::churnedForests(const QVector<Forest>& forests, double churnPercent)
+{
+    QVector<Forest> ret = forests;
+    int changeCount = qMax(1, static_cast<int>(forests.size() * churnPercent / 100));
+    int step = qMax(1, forests.size() / changeCount);
+    for (int i = 0, changed = 0; i < ret.size() && changed < changeCount; i += step, ++changed) {
+        switch (changed % 3) {
+        case 0:
+            ret[i].syncGroup += "-changed";
+            break;
+        case 1:
+            if (!ret[i].domainControllers.isEmpty()) {
+                ret[i].domainControllers.removeLast();
+            }
+            break;
+        default:
+            ret[i] = syntheticForests(1, 2, forests.size() + i).first();
+            break;
+        }
+    }
+    return ret;
+}
+
+QString BenchmarkDatabase::syntheticGuid(int index)
+{
+    return QString("%1-0000-4000-8000-%2").arg(index, 8, 16, QChar('0')).arg(index, 12, 16, QChar('0'));
+}
+
+} // namespace ActiveDirectory
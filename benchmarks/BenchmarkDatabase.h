@@ -0,0 +1,40 @@
+#ifndef BENCHMARKDATABASE_H
+#define BENCHMARKDATABASE_H
+#include <QSqlDatabase>
+#include <QTemporaryDir>
+#include <QVector>
+#include "qliqdirect/shared/ActiveDirectoryDataTypes.h"
+
+namespace ActiveDirectory {
+
+/*
+ * SQLite database in a temporary directory with the forest configuration tables
+ * (columns of ForestSchema.h). Removed with the object.
+ */
+class BenchmarkDatabase {
+public:
+    BenchmarkDatabase();
+    ~BenchmarkDatabase();
+
+    bool isOpen() const;
+    QSqlDatabase database() const;
+    QString path() const;
+
+    // Inserts forests and their DCs with set based SQL, not through the DAOs
+    bool insert(const QVector<Forest>& forests);
+
+    // 'forestCount' forests with 'dcCount' DCs each, the first DC is primary
+    static QVector<Forest> syntheticForests(int forestCount, int dcCount, int firstIndex = 0);
+    static QString syntheticGuid(int index);
+    // Config push where 'churnPercent' of forests changed: a third get another sync group,
+    // a third lose a DC and a third are replaced by new forests
+    static QVector<Forest> churnedForests(const QVector<Forest>& forests, double churnPercent);
+
+private:
+    QTemporaryDir m_dir;
+    QString m_connectionName;
+};
+
+} // namespace ActiveDirectory
+
+#endif // BENCHMARKDATABASE_H
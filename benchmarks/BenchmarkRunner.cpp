@@ -0,0 +1,227 @@
+#include "BenchmarkRunner.h"
+#include <algorithm>
+#include <cmath>
+#include <QCommandLineParser>
+#include <QRegularExpression>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QSaveFile>
+#include <QDateTime>
+#include <QSysInfo>
+#include <QTextStream>
+#include <QFile>
+#ifdef Q_OS_WIN
+#include <windows.h>
+#include <psapi.h>
+#endif
+
+namespace ActiveDirectory {
+
+////////////////////////////////////////////////////////////////////////////////
+// BenchmarkContext
+
+BenchmarkContext::BenchmarkContext(int iterations, const QVariantMap& params) :
+    m_iterations(iterations),
+    m_params(params)
+{
+}
+
+int BenchmarkContext::iterations() const
+{
+    return m_iterations;
+}
+
+QVariant BenchmarkContext::param(const QString& name, const QVariant& defaultValue) const
+{
+    return m_params.value(name, defaultValue);
+}
+
+void BenchmarkContext::measure(const QString& operation, std::function<void ()> function)
+{
+    QElapsedTimer timer;
+    for (int i = 0; i < m_iterations; ++i) {
+        timer.start();
+        function();
+        sample(operation, timer.nsecsElapsed() / 1000000.0);
+    }
+}
+
+void BenchmarkContext::sample(const QString& operation, double ms)
+{
+    auto it = m_operationIndex.find(operation);
+    if (it == m_operationIndex.end()) {
+        Operation op;
+        op.name = operation;
+        m_operations.append(op);
+        it = m_operationIndex.insert(operation, m_operations.size() - 1);
+    }
+    m_operations[*it].samplesMs.append(ms);
+}
+
+void BenchmarkContext::setCounter(const QString& name, double value)
+{
+    m_counters.insert(name, value);
+}
+
+QVector<BenchmarkContext::Operation> BenchmarkContext::operations() const
+{
+    return m_operations;
+}
+
+QVariantMap BenchmarkContext::counters() const
+{
+    return m_counters;
+}
+
+qint64 BenchmarkContext::residentMemory()
+{
+#ifdef Q_OS_WIN
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return static_cast<qint64>(counters.WorkingSetSize);
+    }
+    return 0;
+#else
+    QFile file("/proc/self/status");
+    if (!file.open(QIODevice::ReadOnly)) {
+        return 0;
+    }
+    foreach (const QByteArray& line, file.readAll().split('\n')) {
+        if (line.startsWith("VmRSS:")) {
+            return line.mid(6).trimmed().split(' ').value(0).toLongLong() * 1024;
+        }
+    }
+    return 0;
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// BenchmarkRunner
+
+void BenchmarkRunner::add(const QString& name, Function function)
+{
+    Benchmark benchmark;
+    benchmark.name = name;
+    benchmark.function = function;
+    m_benchmarks.append(benchmark);
+}
+
+/*
+ * Nearest rank percentile, 'p' in 0..100
+ */
+double BenchmarkRunner::percentile(QVector<double> samples, double p)
+{
+    if (samples.isEmpty()) {
+        return 0;
+    }
+    std::sort(samples.begin(), samples.end());
+    int rank = static_cast<int>(std::ceil(p / 100.0 * samples.size()));
+    return samples[qBound(0, rank - 1, samples.size() - 1)];
+}
+
+int BenchmarkRunner::run(const QStringList& arguments)
+{
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Active Directory forest configuration benchmarks");
+    parser.addHelpOption();
+    QCommandLineOption filterOption("filter", "Run only benchmarks matching <regexp>.", "regexp");
+    QCommandLineOption iterationsOption("iterations", "Samples per operation (default 20).", "n", "20");
+    QCommandLineOption outputOption("output", "Write results as JSON to <file>.", "file");
+    QCommandLineOption paramOption("param", "Benchmark parameter <name=value>, can be repeated.", "name=value");
+    QCommandLineOption listOption("list", "List benchmarks and exit.");
+    parser.addOptions({filterOption, iterationsOption, outputOption, paramOption, listOption});
+    parser.process(arguments);
+
+    QTextStream out(stdout);
+    if (parser.isSet(listOption)) {
+        foreach (const Benchmark& benchmark, m_benchmarks) {
+            out << benchmark.name << "\n";
+        }
+        return 0;
+    }
+
+    QVariantMap params;
+    foreach (const QString& param, parser.values(paramOption)) {
+        int separator = param.indexOf('=');
+        if (separator > 0) {
+            params.insert(param.left(separator), param.mid(separator + 1));
+        }
+    }
+    int iterations = qMax(1, parser.value(iterationsOption).toInt());
+    QRegularExpression filter(parser.value(filterOption));
+
+    QJsonArray results;
+    foreach (const Benchmark& benchmark, m_benchmarks) {
+        if (parser.isSet(filterOption) && !filter.match(benchmark.name).hasMatch()) {
+            continue;
+        }
+
+        out << benchmark.name << "\n";
+        out.flush();
+        BenchmarkContext context(iterations, params);
+        benchmark.function(context);
+
+        QJsonArray operations;
+        foreach (const BenchmarkContext::Operation& op, context.operations()) {
+            double total = 0;
+            foreach (double ms, op.samplesMs) {
+                total += ms;
+            }
+            double p50 = percentile(op.samplesMs, 50);
+            double p99 = percentile(op.samplesMs, 99);
+            double throughput = total > 0 ? op.samplesMs.size() * 1000.0 / total : 0;
+            out << QString("  %1 count %2 p50 %3 ms p99 %4 ms min %5 ms max %6 ms %7 ops/s\n")
+                   .arg(op.name, -40).arg(op.samplesMs.size())
+                   .arg(p50, 0, 'f', 3).arg(p99, 0, 'f', 3)
+                   .arg(percentile(op.samplesMs, 0), 0, 'f', 3).arg(percentile(op.samplesMs, 100), 0, 'f', 3)
+                   .arg(throughput, 0, 'f', 1);
+
+            QJsonObject json;
+            json["name"] = op.name;
+            json["count"] = op.samplesMs.size();
+            json["total_ms"] = total;
+            json["p50_ms"] = p50;
+            json["p99_ms"] = p99;
+            json["min_ms"] = percentile(op.samplesMs, 0);
+            json["max_ms"] = percentile(op.samplesMs, 100);
+            json["ops_per_second"] = throughput;
+            operations.append(json);
+        }
+        QVariantMap counters = context.counters();
+        for (auto it = counters.constBegin(); it != counters.constEnd(); ++it) {
+            out << QString("  %1 %2\n").arg(it.key(), -40).arg(it.value().toDouble(), 0, 'f', 0);
+        }
+        out.flush();
+
+        QJsonObject result;
+        result["benchmark"] = benchmark.name;
+        result["operations"] = operations;
+        result["counters"] = QJsonObject::fromVariantMap(counters);
+        results.append(result);
+    }
+
+    if (parser.isSet(outputOption)) {
+        QJsonObject root;
+        root["format_version"] = 1;
+        root["timestamp"] = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+        root["host"] = QSysInfo::machineHostName();
+        root["iterations"] = iterations;
+        root["params"] = QJsonObject::fromVariantMap(params);
+        root["results"] = results;
+
+        QSaveFile file(parser.value(outputOption));
+        if (!file.open(QIODevice::WriteOnly)) {
+            out << "Cannot open " << file.fileName() << ": " << file.errorString() << "\n";
+            return 1;
+        }
+        file.write(QJsonDocument(root).toJson());
+        if (!file.commit()) {
+            out << "Cannot write " << file.fileName() << ": " << file.errorString() << "\n";
+            return 1;
+        }
+    }
+    return 0;
+}
+
+} // namespace ActiveDirectory
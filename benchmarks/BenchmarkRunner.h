@@ -0,0 +1,77 @@
+#ifndef BENCHMARKRUNNER_H
+#define BENCHMARKRUNNER_H
+#include <functional>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QHash>
+#include <QVariantMap>
+#include <QElapsedTimer>
+
+namespace ActiveDirectory {
+
+/*
+ * Samples and counters of one benchmark run. A benchmark measures one or more named
+ * operations, each sample is the duration of one call of that operation.
+ */
+class BenchmarkContext {
+public:
+    BenchmarkContext(int iterations, const QVariantMap& params);
+
+    int iterations() const;
+    // Value of --param name=value or 'defaultValue'
+    QVariant param(const QString& name, const QVariant& defaultValue = QVariant()) const;
+
+    // Calls 'function' iterations() times, every call is one sample of 'operation'
+    void measure(const QString& operation, std::function<void ()> function);
+    // Sample measured by the benchmark itself
+    void sample(const QString& operation, double ms);
+    // Anything else worth tracking, i.e. memory or rows
+    void setCounter(const QString& name, double value);
+
+    struct Operation {
+        QString name;
+        QVector<double> samplesMs;
+    };
+    QVector<Operation> operations() const;
+    QVariantMap counters() const;
+
+    // Resident set size of this process in bytes, 0 if unknown
+    static qint64 residentMemory();
+
+private:
+    int m_iterations;
+    QVariantMap m_params;
+    QVector<Operation> m_operations;
+    QHash<QString, int> m_operationIndex;
+    QVariantMap m_counters;
+};
+
+/*
+ * Runs registered benchmarks and reports count, throughput, p50, p99, min and max of every
+ * operation. The text report goes to stdout, --output writes the same as JSON so results
+ * can be compared between releases.
+ *
+ * Options: --filter <regexp> --iterations <n> --output <file.json> --param <name=value> (repeatable)
+ */
+class BenchmarkRunner {
+public:
+    typedef std::function<void (BenchmarkContext& context)> Function;
+
+    void add(const QString& name, Function function);
+    int run(const QStringList& arguments);
+
+    static double percentile(QVector<double> samples, double p);
+
+private:
+    struct Benchmark {
+        QString name;
+        Function function;
+    };
+
+    QVector<Benchmark> m_benchmarks;
+};
+
+} // namespace ActiveDirectory
+
+#endif // BENCHMARKRUNNER_H
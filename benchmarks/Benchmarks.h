@@ -0,0 +1,17 @@
+#ifndef BENCHMARKS_H
+#define BENCHMARKS_H
+#include "BenchmarkRunner.h"
+
+namespace ActiveDirectory {
+
+// One function per benchmark source file, called by main()
+void registerForestLoadBenchmarks(BenchmarkRunner& runner);
+void registerForestDiffBenchmarks(BenchmarkRunner& runner);
+void registerManagerBenchmarks(BenchmarkRunner& runner);
+void registerProbeTierBenchmarks(BenchmarkRunner& runner);
+void registerTableBenchmarks(BenchmarkRunner& runner);
+void registerForestKeyBenchmarks(BenchmarkRunner& runner);
+
+} // namespace ActiveDirectory
+
+#endif // BENCHMARKS_H
@@ -0,0 +1,47 @@
+#include "Benchmarks.h"
+#include "ForestDiff.h"
+#include "BenchmarkDatabase.h"
+
+namespace ActiveDirectory {
+
+namespace {
+
+void benchmarkDiff(BenchmarkContext& context)
+{
+    int forestCount = context.param("diff_forests", 10000).toInt();
+    double churnPercent = context.param("diff_churn_percent", 1.0).toDouble();
+    int dcCount = context.param("dcs_per_forest", 3).toInt();
+
+    QVector<Forest> oldForests = BenchmarkDatabase::syntheticForests(forestCount, dcCount);
+    QVector<Forest> newForests = BenchmarkDatabase::churnedForests(oldForests, churnPercent);
+    QVector<quint64> oldHashes = ForestDiff::contentHashes(oldForests);
+
+    QString suffix = QString(", %1 forests, %2% churn").arg(forestCount).arg(churnPercent);
+    int fullChangeCount = 0;
+    context.measure("ForestComparator::compare" + suffix, [&]() {
+        QVector<ForestComparator::ForestWithChange> changes;
+        ForestComparator::compare(oldForests, newForests, &changes);
+        fullChangeCount = changes.size();
+    });
+    int diffChangeCount = 0;
+    context.measure("ForestDiff::compare" + suffix, [&]() {
+        QVector<ForestComparator::ForestWithChange> changes;
+        ForestDiff::compare(oldForests, oldHashes, newForests, &changes);
+        diffChangeCount = changes.size();
+    });
+    context.measure("ForestDiff::contentHashes" + suffix, [&]() {
+        ForestDiff::contentHashes(newForests);
+    });
+    // Both must find the same changes, otherwise the numbers mean nothing
+    context.setCounter("changes ForestComparator" + suffix, fullChangeCount);
+    context.setCounter("changes ForestDiff" + suffix, diffChangeCount);
+}
+
+} // anonymous namespace
+
+void registerForestDiffBenchmarks(BenchmarkRunner& runner)
+{
+    runner.add("forest_configuration_diff", benchmarkDiff);
+}
+
+} // namespace ActiveDirectory
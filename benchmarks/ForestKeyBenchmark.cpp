@@ -0,0 +1,165 @@
+#include "Benchmarks.h"
+#include <QHash>
+#include "ObjectGuid.h"
+#include "BenchmarkDatabase.h"
+
+namespace ActiveDirectory {
+
+namespace {
+
+// Membership row as loaded with text keys and with the compact ones
+struct TextMembership {
+    QString forestGuid;
+    QString host;
+};
+
+struct BinaryMembership {
+    ObjectGuid forestGuid;
+    HostId host;
+};
+
+QString syntheticHost(int forest, int dc)
+{
+    return QString("DC%1.forest%2.test").arg(dc).arg(forest);
+}
+
+/*
+ * Forest index plus memberships, every string is its own allocation like rows read from the
+ * database (no implicit sharing between the index and the memberships)
+ */
+struct TextKeys {
+    QHash<QString, int> forestIndex;
+    QHash<QString, int> hostIndex;     // lower case, as the health cache keyed it
+    QVector<TextMembership> memberships;
+
+    void build(int forestCount, int membershipCount)
+    {
+        forestIndex.reserve(forestCount);
+        for (int i = 0; i < forestCount; ++i) {
+            forestIndex.insert(BenchmarkDatabase::syntheticGuid(i), i);
+        }
+        const int dcsPerForest = qMax(1, membershipCount / qMax(1, forestCount));
+        memberships.reserve(membershipCount);
+        hostIndex.reserve(membershipCount);
+        for (int i = 0; i < membershipCount; ++i) {
+            TextMembership membership;
+            membership.forestGuid = BenchmarkDatabase::syntheticGuid(i / dcsPerForest % forestCount);
+            membership.host = syntheticHost(i / dcsPerForest, i % dcsPerForest);
+            hostIndex.insert(membership.host.toLower(), i);
+            memberships.append(membership);
+        }
+    }
+};
+
+struct BinaryKeys {
+    QHash<ObjectGuid, int> forestIndex;
+    QHash<HostId, int> hostIndex;
+    QVector<BinaryMembership> memberships;
+
+    void build(int forestCount, int membershipCount)
+    {
+        forestIndex.reserve(forestCount);
+        for (int i = 0; i < forestCount; ++i) {
+            forestIndex.insert(ObjectGuid::fromString(BenchmarkDatabase::syntheticGuid(i)), i);
+        }
+        const int dcsPerForest = qMax(1, membershipCount / qMax(1, forestCount));
+        memberships.reserve(membershipCount);
+        hostIndex.reserve(membershipCount);
+        for (int i = 0; i < membershipCount; ++i) {
+            BinaryMembership membership;
+            membership.forestGuid = ObjectGuid::fromString(BenchmarkDatabase::syntheticGuid(i / dcsPerForest % forestCount));
+            membership.host = HostNameTable::intern(syntheticHost(i / dcsPerForest, i % dcsPerForest));
+            hostIndex.insert(membership.host, i);
+            memberships.append(membership);
+        }
+    }
+};
+
+double megabytes(qint64 bytes)
+{
+    return bytes / (1024.0 * 1024.0);
+}
+
+/*
+ * Memory of the forest index and memberships with text keys and with ObjectGuid/HostId keys,
+ * and the lookups done per membership (forest of a DC, health of a host).
+ * Binary keys are measured first: RSS rarely shrinks after a free, so the bigger text
+ * structures built second cannot hide in memory freed by the smaller ones.
+ * Host names are interned before the RSS baseline, the table is process wide and never freed.
+ */
+void benchmarkForestKeys(BenchmarkContext& context)
+{
+    int forestCount = context.param("key_forests", 50000).toInt();
+    int membershipCount = context.param("key_memberships", 500000).toInt();
+    QString suffix = QString(", %1 forests, %2 memberships").arg(forestCount).arg(membershipCount);
+
+    const int dcsPerForest = qMax(1, membershipCount / qMax(1, forestCount));
+    for (int i = 0; i < membershipCount; ++i) {
+        HostNameTable::intern(syntheticHost(i / dcsPerForest, i % dcsPerForest));
+    }
+
+    {
+        qint64 memoryBefore = BenchmarkContext::residentMemory();
+        BinaryKeys keys;
+        keys.build(forestCount, membershipCount);
+        context.setCounter("ObjectGuid/HostId keys RSS growth MB" + suffix, megabytes(BenchmarkContext::residentMemory() - memoryBefore));
+
+        int found = 0;
+        context.measure("ObjectGuid forest lookup per membership" + suffix, [&keys, &found]() {
+            found = 0;
+            foreach (const BinaryMembership& membership, keys.memberships) {
+                found += keys.forestIndex.contains(membership.forestGuid) ? 1 : 0;
+            }
+        });
+        context.setCounter("ObjectGuid forests found" + suffix, found);
+        context.measure("HostId host lookup per membership" + suffix, [&keys, &found]() {
+            found = 0;
+            foreach (const BinaryMembership& membership, keys.memberships) {
+                found += keys.hostIndex.contains(membership.host) ? 1 : 0;
+            }
+        });
+    }
+
+    {
+        qint64 memoryBefore = BenchmarkContext::residentMemory();
+        TextKeys keys;
+        keys.build(forestCount, membershipCount);
+        context.setCounter("QString keys RSS growth MB" + suffix, megabytes(BenchmarkContext::residentMemory() - memoryBefore));
+
+        int found = 0;
+        context.measure("QString forest lookup per membership" + suffix, [&keys, &found]() {
+            found = 0;
+            foreach (const TextMembership& membership, keys.memberships) {
+                found += keys.forestIndex.contains(membership.forestGuid) ? 1 : 0;
+            }
+        });
+        context.setCounter("QString forests found" + suffix, found);
+        // Case insensitive like the health cache was, so the key is folded on every lookup
+        context.measure("QString host lookup per membership" + suffix, [&keys, &found]() {
+            found = 0;
+            foreach (const TextMembership& membership, keys.memberships) {
+                found += keys.hostIndex.contains(membership.host.toLower()) ? 1 : 0;
+            }
+        });
+    }
+
+    // Cost of getting the compact keys from the text ones, paid once per loaded row
+    QStringList guids;
+    for (int i = 0; i < forestCount; ++i) {
+        guids.append(BenchmarkDatabase::syntheticGuid(i));
+    }
+    context.measure("ObjectGuid::fromString per forest" + suffix, [&guids]() {
+        foreach (const QString& guid, guids) {
+            ObjectGuid::fromString(guid);
+        }
+    });
+}
+
+} // anonymous namespace
+
+void registerForestKeyBenchmarks(BenchmarkRunner& runner)
+{
+    runner.add("forest_key_lookup", benchmarkForestKeys);
+}
+
+} // namespace ActiveDirectory
@@ -0,0 +1,118 @@
+#include "Benchmarks.h"
+#include <QElapsedTimer>
+#include <QStringList>
+#include <QFileInfo>
+#include "dao/ActiveDirectoryDao.h"
+#include "ActiveDirectoryDomainControllerManager.h"
+#include "BenchmarkDatabase.h"
+
+namespace ActiveDirectory {
+
+namespace {
+
+/*
+ * load() as it was before the bulk loader: one query for forest guids, then
+ * a forest and a DC query per forest
+ */
+QVector<Forest> loadForestsOneByOne(QSqlDatabase db)
+{
+    QVector<Forest> forests;
+    foreach (const QString& forestGuid, ForestDomainControllerMembershipDao::selectForestGuids(db)) {
+        Forest forest = ForestDao::selectOneBy(ForestDao::ObjectGuidColumn, forestGuid, 0, db);
+        if (!forest.isEmpty()) {
+            forest.domainControllers = ForestDomainControllerMembershipDao::selectOfForest(forestGuid, db);
+            forest.sortDomainControllersByPrimary();
+            forests.append(forest);
+        }
+    }
+    return forests;
+}
+
+void benchmarkLoad(BenchmarkContext& context)
+{
+    QStringList sizes = context.param("load_forests", "10,1000,50000").toString().split(',', QString::SkipEmptyParts);
+    int dcCount = context.param("dcs_per_forest", 3).toInt();
+
+    foreach (const QString& size, sizes) {
+        int forestCount = size.toInt();
+        BenchmarkDatabase database;
+        database.insert(BenchmarkDatabase::syntheticForests(forestCount, dcCount));
+        QSqlDatabase db = database.database();
+
+        // Schema migration and the stamp are made by the first load(), not measured
+        DomainControllerManager manager;
+        manager.setDatabaseWriterEnabled(false);
+        manager.setSnapshotFilePath(QString());
+        manager.setDatabase(db);
+        manager.load();
+
+        // The N+1 pattern is far too slow to repeat at large scale
+        int legacyIterations = forestCount > 1000 ? qMin(3, context.iterations()) : context.iterations();
+        QElapsedTimer timer;
+        for (int i = 0; i < legacyIterations; ++i) {
+            timer.start();
+            QVector<Forest> forests = loadForestsOneByOne(db);
+            context.sample(QString("load one by one, %1 forests").arg(forestCount), timer.nsecsElapsed() / 1000000.0);
+        }
+        context.measure(QString("load bulk, %1 forests").arg(forestCount), [&manager]() {
+            manager.load();
+        });
+        context.setCounter(QString("forests loaded, %1 forests").arg(forestCount), manager.snapshot()->forests.size());
+    }
+}
+
+/*
+ * load() at startup as the service does it (database writer on): from the snapshot file next to
+ * the database against the bulk queries. Every sample is a load() of a manager which has not
+ * loaded anything yet.
+ */
+void benchmarkStartup(BenchmarkContext& context)
+{
+    QStringList sizes = context.param("startup_forests", "1000,50000").toString().split(',', QString::SkipEmptyParts);
+    int dcCount = context.param("dcs_per_forest", 3).toInt();
+
+    foreach (const QString& size, sizes) {
+        int forestCount = size.toInt();
+        QString suffix = QString(", %1 forests").arg(forestCount);
+        BenchmarkDatabase database;
+        database.insert(BenchmarkDatabase::syntheticForests(forestCount, dcCount));
+        QString snapshotPath = database.path() + ".forests";
+
+        // Migration, stamp and the snapshot file are made by the first start, not measured
+        {
+            DomainControllerManager manager;
+            manager.setSnapshotFilePath(snapshotPath);
+            manager.setDatabase(database.database());
+            manager.load();
+        }
+        context.setCounter("snapshot file KB" + suffix, QFileInfo(snapshotPath).size() / 1024.0);
+
+        int loadedCount = 0;
+        context.measure("startup from snapshot" + suffix, [&]() {
+            DomainControllerManager manager;
+            manager.setSnapshotFilePath(snapshotPath);
+            manager.setDatabase(database.database());
+            manager.load();
+            loadedCount = manager.snapshot()->forests.size();
+        });
+        context.setCounter("forests loaded from snapshot" + suffix, loadedCount);
+        context.measure("startup from database" + suffix, [&]() {
+            DomainControllerManager manager;
+            manager.setSnapshotFilePath(QString());
+            manager.setDatabase(database.database());
+            manager.load();
+            loadedCount = manager.snapshot()->forests.size();
+        });
+        context.setCounter("forests loaded from database" + suffix, loadedCount);
+    }
+}
+
+} // anonymous namespace
+
+void registerForestLoadBenchmarks(BenchmarkRunner& runner)
+{
+    runner.add("forest_configuration_load", benchmarkLoad);
+    runner.add("forest_configuration_startup", benchmarkStartup);
+}
+
+} // namespace ActiveDirectory
@@ -0,0 +1,80 @@
+#include "Benchmarks.h"
+#include <QElapsedTimer>
+#include "ActiveDirectoryDomainControllerManager.h"
+#include "DomainControllerProbe.h"
+#include "BenchmarkDatabase.h"
+
+namespace ActiveDirectory {
+
+namespace {
+
+/*
+ * Operations of DomainControllerManager at 'manager_forests' scale. ActiveDirectoryApi is replaced
+ * by SimulatedDomainControllerProbe, every DC answers after 'probe_latency_ms' and fails with
+ * 'probe_failure_rate' probability.
+ */
+void benchmarkManager(BenchmarkContext& context)
+{
+    int forestCount = context.param("manager_forests", 1000).toInt();
+    int dcCount = context.param("dcs_per_forest", 3).toInt();
+    double churnPercent = context.param("manager_churn_percent", 1.0).toDouble();
+    int latencyMs = context.param("probe_latency_ms", 1).toInt();
+    double failureRate = context.param("probe_failure_rate", 0.1).toDouble();
+    bool isParallel = context.param("probe_parallel", 0).toInt() != 0;
+
+    QVector<Forest> forests = BenchmarkDatabase::syntheticForests(forestCount, dcCount);
+    QVector<Forest> churned = BenchmarkDatabase::churnedForests(forests, churnPercent);
+    BenchmarkDatabase database;
+    database.insert(forests);
+
+    QSharedPointer<SimulatedDomainControllerProbe> probe(
+                new SimulatedDomainControllerProbe(SimulatedDomainControllerProbe::HostBehavior(latencyMs, failureRate)));
+    DomainControllerManager manager;
+    manager.setSnapshotFilePath(QString());
+    manager.setProbe(probe);
+    manager.setParallelProbe(isParallel);
+    manager.setDatabase(database.database());
+
+    QString suffix = QString(", %1 forests").arg(forestCount);
+    context.measure("load" + suffix, [&manager]() {
+        manager.load();
+    });
+
+    // Every call is a config push with changes: the churned configuration and back.
+    // saveForests() runs the diff and the updateDatabaseWithForestChanges() transaction.
+    bool isChurned = false;
+    int failedSaves = 0;
+    context.measure(QString("saveForests, %1% churn").arg(churnPercent) + suffix, [&]() {
+        isChurned = !isChurned;
+        if (!manager.saveForests(isChurned ? churned : forests)) {
+            ++failedSaves;
+        }
+    });
+    context.setCounter("failed saveForests" + suffix, failedSaves);
+
+    // One sample per forest, DC selection included
+    int selectedCount = 0;
+    for (int i = 0; i < context.iterations(); ++i) {
+        manager.resetIteration();
+        QElapsedTimer timer;
+        timer.start();
+        Forest forest;
+        DomainController dc;
+        while (manager.nextForest(&forest, &dc)) {
+            context.sample("nextForest" + suffix, timer.nsecsElapsed() / 1000000.0);
+            ++selectedCount;
+            timer.start();
+        }
+    }
+    context.setCounter("forests with accessible DC per pass" + suffix, selectedCount / qMax(1, context.iterations()));
+    context.setCounter("probes" + suffix, probe->probeCount());
+}
+
+} // anonymous namespace
+
+void registerManagerBenchmarks(BenchmarkRunner& runner)
+{
+    runner.add("forest_configuration_manager", benchmarkManager);
+}
+
+} // namespace ActiveDirectory
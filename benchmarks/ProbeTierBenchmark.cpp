@@ -0,0 +1,124 @@
+#include "Benchmarks.h"
+#include <QThread>
+#include <QSemaphore>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QHostAddress>
+#include "DomainControllerProbe.h"
+
+namespace ActiveDirectory {
+
+namespace {
+
+/*
+ * Stand-in of a DC's LDAP port: accepts and closes connections on 127.0.0.1 in its own thread.
+ * 127.0.0.2 is loopback too but nothing listens there, so it stands in for a dead DC.
+ */
+class LoopbackServer : public QThread {
+public:
+    LoopbackServer() : m_port(0) {}
+
+    quint16 startAndWaitForPort()
+    {
+        start();
+        m_ready.acquire();
+        return m_port;
+    }
+
+protected:
+    void run() override
+    {
+        QTcpServer server;
+        QObject::connect(&server, &QTcpServer::newConnection, &server, [&server]() {
+            while (QTcpSocket *socket = server.nextPendingConnection()) {
+                socket->close();
+                socket->deleteLater();
+            }
+        });
+        server.listen(QHostAddress::LocalHost);
+        m_port = server.serverPort();
+        m_ready.release();
+        exec();
+    }
+
+private:
+    quint16 m_port;
+    QSemaphore m_ready;
+};
+
+const char *tierName(DomainControllerProbeTier tier)
+{
+    switch (tier) {
+    case PingThenFullProbeTier:
+        return "ping then full";
+    case PingProbeTier:
+        return "ping only";
+    default:
+        return "full";
+    }
+}
+
+/*
+ * One cycle probes every DC once. The full check is SimulatedDomainControllerProbe with the cost
+ * of a bind, DNS name lookup and database access ('full_probe_latency_ms'), the ping is a real
+ * TcpConnectProbe against the loopback server.
+ */
+void benchmarkProbeTiers(BenchmarkContext& context)
+{
+    int aliveCount = context.param("alive_dcs", 8).toInt();
+    int deadCount = context.param("dead_dcs", 2).toInt();
+    int fullLatencyMs = context.param("full_probe_latency_ms", 50).toInt();
+
+    LoopbackServer server;
+    quint16 port = server.startAndWaitForPort();
+
+    QStringList hosts;
+    QHash<QString, QString> knownDnsNames;
+    QSharedPointer<SimulatedDomainControllerProbe> full(
+                new SimulatedDomainControllerProbe(SimulatedDomainControllerProbe::HostBehavior(fullLatencyMs)));
+    // Every alive DC is the loopback server, its DNS name is known from an earlier full check
+    const QString aliveHost = "127.0.0.1";
+    const QString deadHost = "127.0.0.2";
+    for (int i = 0; i < aliveCount; ++i) {
+        hosts.append(aliveHost);
+    }
+    for (int i = 0; i < deadCount; ++i) {
+        hosts.append(deadHost);
+    }
+    knownDnsNames.insert(aliveHost, "dc.forest.test");
+    full->setHostBehavior(deadHost, SimulatedDomainControllerProbe::HostBehavior(fullLatencyMs, 1));
+    QSharedPointer<DomainControllerProbe> ping(new TcpConnectProbe(port, 1000));
+
+    QString suffix = QString(", %1 alive + %2 dead DCs").arg(aliveCount).arg(deadCount);
+    DomainControllerProbeTier tiers[] = { FullProbeTier, PingThenFullProbeTier, PingProbeTier };
+    for (DomainControllerProbeTier tier : tiers) {
+        TieredDomainControllerProbe probe(ping, full, tier, knownDnsNames);
+        int fullProbesBefore = full->probeCount();
+        int accessibleCount = 0;
+        context.measure(QString("probe cycle, %1").arg(tierName(tier)) + suffix, [&]() {
+            accessibleCount = 0;
+            foreach (const QString& host, hosts) {
+                QString dnsName;
+                QString errorMsg;
+                if (SUCCEEDED(probe.probe(host, &dnsName, &errorMsg, ProbeCancellationToken()))) {
+                    accessibleCount++;
+                }
+            }
+        });
+        context.setCounter(QString("full probes per cycle, %1").arg(tierName(tier)) + suffix,
+                           static_cast<double>(full->probeCount() - fullProbesBefore) / context.iterations());
+        context.setCounter(QString("accessible DCs, %1").arg(tierName(tier)) + suffix, accessibleCount);
+    }
+
+    server.quit();
+    server.wait();
+}
+
+} // anonymous namespace
+
+void registerProbeTierBenchmarks(BenchmarkRunner& runner)
+{
+    runner.add("dc_probe_tiers", benchmarkProbeTiers);
+}
+
+} // namespace ActiveDirectory
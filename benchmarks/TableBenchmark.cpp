@@ -0,0 +1,221 @@
+#include "Benchmarks.h"
+#include <QElapsedTimer>
+#include <QStringList>
+#include <QCoreApplication>
+#include <QBuffer>
+#include <QJsonDocument>
+#include <QTableWidget>
+#include <QLabel>
+#include <QHBoxLayout>
+#include <QPixmap>
+#include "MenuColumnTableWidget.h"
+#include "MenuColumnTableView.h"
+
+namespace ActiveDirectory {
+
+namespace {
+
+const int COLUMN_COUNT = 5;
+
+QStringList columnMappings()
+{
+    return QStringList() << "name" << "email" << "department" << "title" << "password";
+}
+
+QVariantList syntheticRows(int count)
+{
+    QStringList mappings = columnMappings();
+    QVariantList rows;
+    rows.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        QVariantMap row;
+        row.insert(mappings[0], QString("User %1").arg(i));
+        row.insert(mappings[1], QString("user%1@forest.test").arg(i));
+        row.insert(mappings[2], QString("Department %1").arg(i % 50));
+        row.insert(mappings[3], QString("Title %1").arg(i % 20));
+        row.insert(mappings[4], QString("password%1").arg(i));
+        rows.append(row);
+    }
+    return rows;
+}
+
+/*
+ * MenuColumnTableWidget as it was before the gear delegate: a QLabel in a layout widget per row
+ * for the gear icon and setData() through appendRow()/setText(). The icon is made here, the
+ * benchmark has no resources, so the widgets are created like with the icon loaded.
+ */
+class BaselineMenuColumnTable : public QTableWidget
+{
+public:
+    void setColumnMappings(const QStringList& columnMappings)
+    {
+        m_columnMappings = columnMappings;
+    }
+
+    void setEchoPasswordColumn(int column)
+    {
+        Q_UNUSED(column);
+    }
+
+    void addGearHeaderColumn()
+    {
+        int columns = columnCount();
+        setColumnCount(columns + 1);
+        setColumnWidth(columns, 50);
+        QTableWidgetItem *headerItem = new QTableWidgetItem("");
+        headerItem->setFlags(Qt::ItemIsEnabled);
+        setHorizontalHeaderItem(columns, headerItem);
+    }
+
+    void setData(const QVariantList& list)
+    {
+        clearContents();
+        setRowCount(0);
+
+        const int columns = columnCount() - 1;
+        for (int row = 0; row < list.size(); row++) {
+            appendRow();
+            QVariantMap map = list[row].toMap();
+            for (int column = 0; column < columns; column++) {
+                QString columnMapping = (column < m_columnMappings.size()) ? m_columnMappings[column] : QString::number(column);
+                QTableWidgetItem *cellItem = new QTableWidgetItem(map[columnMapping].toString());
+                cellItem->setFlags(Qt::ItemIsSelectable | Qt::ItemIsEnabled);
+                setItem(row, column, cellItem);
+            }
+        }
+    }
+
+private:
+    void appendRow()
+    {
+        int row = rowCount();
+        setRowCount(row + 1);
+        int gearColumn = columnCount() - 1;
+        setColumnWidth(gearColumn, 50);
+        QTableWidgetItem *gearItem = new QTableWidgetItem("");
+        gearItem->setFlags(Qt::ItemIsEnabled);
+        setItem(row, gearColumn, gearItem);
+
+        QPixmap image(24, 24);
+        image.fill(Qt::darkGray);
+        QLabel *imageLabel = new QLabel();
+        imageLabel->setFixedSize(image.size());
+        imageLabel->setPixmap(image);
+        QWidget *labelWidget = new QWidget(this);
+        QHBoxLayout *horizontalLayout = new QHBoxLayout(labelWidget);
+        horizontalLayout->addWidget(imageLabel);
+        horizontalLayout->setAlignment(Qt::AlignCenter);
+        horizontalLayout->setContentsMargins(0, 0, 0, 0);
+        setCellWidget(row, gearColumn, labelWidget);
+    }
+
+    QStringList m_columnMappings;
+};
+
+template <typename Table>
+void setUp(Table *table)
+{
+    table->setColumnCount(COLUMN_COUNT);
+    table->setHorizontalHeaderLabels(columnMappings());
+    table->setColumnMappings(columnMappings());
+    table->addGearHeaderColumn();
+    table->setEchoPasswordColumn(COLUMN_COUNT - 1);
+    table->resize(1200, 800);
+}
+
+/*
+ * setData() of 'rows' rows, every sample is a fill of a table which already has them
+ * (filling QTableWidget with 100k rows takes long, run with a low --iterations).
+ * RSS growth is measured over creating the table and its first fill, the table is shown
+ * so the gear widgets of the baseline and delegate painting are part of the cost.
+ */
+template <typename Table>
+void benchmarkFill(BenchmarkContext& context, const QString& name, const QVariantList& rows)
+{
+    QString suffix = QString(", %1 rows").arg(rows.size());
+    qint64 memoryBefore = BenchmarkContext::residentMemory();
+    Table *table = new Table();
+    setUp(table);
+    table->show();
+
+    QElapsedTimer timer;
+    timer.start();
+    table->setData(rows);
+    QCoreApplication::processEvents();
+    context.sample(name + " first fill" + suffix, timer.nsecsElapsed() / 1000000.0);
+    context.setCounter(name + " RSS growth MB" + suffix, (BenchmarkContext::residentMemory() - memoryBefore) / (1024.0 * 1024.0));
+
+    context.measure(name + " fill" + suffix, [table, &rows]() {
+        table->setData(rows);
+        QCoreApplication::processEvents();
+    });
+    delete table;
+}
+
+void benchmarkTableFill(BenchmarkContext& context)
+{
+    QStringList sizes = context.param("table_rows", "1000,10000,100000").toString().split(',', QString::SkipEmptyParts);
+    foreach (const QString& size, sizes) {
+        QVariantList rows = syntheticRows(size.toInt());
+        benchmarkFill<BaselineMenuColumnTable>(context, "baseline QTableWidget with gear widgets", rows);
+        benchmarkFill<MenuColumnTableWidget>(context, "MenuColumnTableWidget", rows);
+        benchmarkFill<MenuColumnTableView>(context, "MenuColumnTableView", rows);
+    }
+}
+
+/*
+ * Export of a filled table: the QVariantMap per row data() path (and what callers did with it
+ * to get CSV/JSON) against the columnar copy and the streaming writers
+ */
+template <typename Table>
+void benchmarkExport(BenchmarkContext& context, const QString& name, const QVariantList& rows)
+{
+    QString suffix = QString(", %1 rows").arg(rows.size());
+    Table table;
+    setUp(&table);
+    table.setData(rows);
+
+    context.measure(name + " data()" + suffix, [&table]() {
+        QVariantList list = table.data();
+        Q_UNUSED(list);
+    });
+    context.measure(name + " data() to JSON" + suffix, [&table]() {
+        QByteArray json = QJsonDocument::fromVariant(table.data()).toJson(QJsonDocument::Compact);
+        Q_UNUSED(json);
+    });
+    context.measure(name + " columnData()" + suffix, [&table]() {
+        MenuColumnTableColumns columns = table.columnData();
+        Q_UNUSED(columns);
+    });
+    context.measure(name + " exportCsv()" + suffix, [&table]() {
+        QBuffer buffer;
+        buffer.open(QIODevice::WriteOnly);
+        table.exportCsv(&buffer);
+    });
+    context.measure(name + " exportJson()" + suffix, [&table]() {
+        QBuffer buffer;
+        buffer.open(QIODevice::WriteOnly);
+        table.exportJson(&buffer);
+    });
+}
+
+void benchmarkTableExport(BenchmarkContext& context)
+{
+    QStringList sizes = context.param("table_rows", "1000,10000,100000").toString().split(',', QString::SkipEmptyParts);
+
+    foreach (const QString& size, sizes) {
+        QVariantList rows = syntheticRows(size.toInt());
+        benchmarkExport<MenuColumnTableWidget>(context, "MenuColumnTableWidget", rows);
+        benchmarkExport<MenuColumnTableView>(context, "MenuColumnTableView", rows);
+    }
+}
+
+} // anonymous namespace
+
+void registerTableBenchmarks(BenchmarkRunner& runner)
+{
+    runner.add("menu_column_table_fill", benchmarkTableFill);
+    runner.add("menu_column_table_export", benchmarkTableExport);
+}
+
+} // namespace ActiveDirectory
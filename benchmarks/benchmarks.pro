@@ -0,0 +1,26 @@
+# Benchmarks of the forest configuration manager, see BenchmarkRunner.h for options:
+#   qmake QLIQDIRECT_SRC=<qliqDirect root> QLIQDIRECT_LIBS="..." && make
+#   ./ad_benchmarks --output results.json
+
+TEMPLATE = app
+TARGET = ad_benchmarks
+CONFIG += console
+CONFIG -= app_bundle
+
+include(../ActiveDirectory.pri)
+
+HEADERS += \
+    BenchmarkDatabase.h \
+    BenchmarkRunner.h \
+    Benchmarks.h
+
+SOURCES += \
+    main.cpp \
+    BenchmarkDatabase.cpp \
+    BenchmarkRunner.cpp \
+    ForestLoadBenchmark.cpp \
+    ForestDiffBenchmark.cpp \
+    ManagerBenchmark.cpp \
+    ProbeTierBenchmark.cpp \
+    TableBenchmark.cpp \
+    ForestKeyBenchmark.cpp
@@ -0,0 +1,21 @@
+#include <QApplication>
+#include "Benchmarks.h"
+
+/*
+ * ad_benchmarks --help lists the options, results can be written as JSON with --output.
+ * Table benchmarks create widgets, without a display run with -platform offscreen.
+ */
+int main(int argc, char *argv[])
+{
+    QApplication app(argc, argv);
+    app.setApplicationName("ad_benchmarks");
+
+    ActiveDirectory::BenchmarkRunner runner;
+    ActiveDirectory::registerForestLoadBenchmarks(runner);
+    ActiveDirectory::registerForestDiffBenchmarks(runner);
+    ActiveDirectory::registerManagerBenchmarks(runner);
+    ActiveDirectory::registerProbeTierBenchmarks(runner);
+    ActiveDirectory::registerTableBenchmarks(runner);
+    ActiveDirectory::registerForestKeyBenchmarks(runner);
+    return runner.run(app.arguments());
+}
@@ -0,0 +1,113 @@
+#include "DatabaseWriterTest.h"
+#include <QtTest>
+#include <QSqlQuery>
+#include <QElapsedTimer>
+#include "DatabaseWriter.h"
+#include "BenchmarkDatabase.h"
+
+namespace ActiveDirectory {
+
+namespace {
+
+bool createValueTable(QSqlDatabase db)
+{
+    return QSqlQuery(db).exec("CREATE TABLE writer_test (value INTEGER)");
+}
+
+DatabaseWriter::Operation insertValue(int value, bool isSuccess = true)
+{
+    return [value, isSuccess](QSqlDatabase db) -> bool {
+        QSqlQuery query(db);
+        query.prepare("INSERT INTO writer_test (value) VALUES (?)");
+        query.addBindValue(value);
+        return query.exec() && isSuccess;
+    };
+}
+
+// Read on the test's own connection, so only committed rows are seen
+QList<int> committedValues(QSqlDatabase db)
+{
+    QList<int> ret;
+    QSqlQuery query(db);
+    if (query.exec("SELECT value FROM writer_test ORDER BY rowid")) {
+        while (query.next()) {
+            ret.append(query.value(0).toInt());
+        }
+    }
+    return ret;
+}
+
+} // anonymous namespace
+
+void DatabaseWriterTest::failingOperationRollsBackOnlyItself()
+{
+    BenchmarkDatabase database;
+    QSqlDatabase db = database.database();
+    QVERIFY(createValueTable(db));
+
+    // Queued before start(), so all three are grouped into one transaction
+    DatabaseWriter writer(db);
+    DatabaseWriteFuture first = writer.submit("insert 1", insertValue(1));
+    DatabaseWriteFuture failing = writer.submit("insert 2 and fail", insertValue(2, false));
+    DatabaseWriteFuture last = writer.submit("insert 3", insertValue(3));
+    writer.start();
+
+    QVERIFY(first.result());
+    QVERIFY(!failing.result());
+    QVERIFY(last.result());
+    QCOMPARE(committedValues(db), QList<int>() << 1 << 3);
+}
+
+void DatabaseWriterTest::operationsRunInSubmitOrder()
+{
+    BenchmarkDatabase database;
+    QSqlDatabase db = database.database();
+    QVERIFY(createValueTable(db));
+
+    DatabaseWriter writer(db);
+    writer.setMaxBatchSize(3);
+    writer.start();
+    QList<int> expected;
+    for (int i = 0; i < 20; ++i) {
+        writer.submit("insert", insertValue(i));
+        expected.append(i);
+    }
+    QVERIFY(writer.flush(QDeadlineTimer(10000)));
+    QCOMPARE(committedValues(db), expected);
+}
+
+void DatabaseWriterTest::futureFinishesAfterCommit()
+{
+    BenchmarkDatabase database;
+    QSqlDatabase db = database.database();
+    QVERIFY(createValueTable(db));
+
+    DatabaseWriter writer(db);
+    DatabaseWriteFuture future = writer.submit("insert", insertValue(7));
+    QVERIFY(future.isValid());
+    QVERIFY(!future.isFinished());
+    QVERIFY(!future.waitForFinished(QDeadlineTimer(50)));
+
+    writer.start();
+    QVERIFY(future.waitForFinished(QDeadlineTimer(10000)));
+    QVERIFY(future.result());
+    QCOMPARE(committedValues(db), QList<int>() << 7);
+}
+
+void DatabaseWriterTest::waitedWriteSkipsCoalesceInterval()
+{
+    BenchmarkDatabase database;
+    QSqlDatabase db = database.database();
+    QVERIFY(createValueTable(db));
+
+    DatabaseWriter writer(db);
+    writer.setCoalesceInterval(5000);
+    writer.start();
+    QElapsedTimer timer;
+    timer.start();
+    QVERIFY(writer.write("insert", insertValue(1)));
+    QVERIFY(timer.elapsed() < 2500);
+    QCOMPARE(committedValues(db), QList<int>() << 1);
+}
+
+} // namespace ActiveDirectory
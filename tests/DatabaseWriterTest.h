@@ -0,0 +1,22 @@
+#ifndef DATABASEWRITERTEST_H
+#define DATABASEWRITERTEST_H
+#include <QObject>
+
+namespace ActiveDirectory {
+
+/*
+ * DatabaseWriter grouping, ordering and completion against a temporary database
+ */
+class DatabaseWriterTest : public QObject {
+    Q_OBJECT
+
+private slots:
+    void failingOperationRollsBackOnlyItself();
+    void operationsRunInSubmitOrder();
+    void futureFinishesAfterCommit();
+    void waitedWriteSkipsCoalesceInterval();
+};
+
+} // namespace ActiveDirectory
+
+#endif // DATABASEWRITERTEST_H
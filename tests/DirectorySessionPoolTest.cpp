@@ -0,0 +1,210 @@
+#include "DirectorySessionPoolTest.h"
+#include <QtTest>
+#include <QAtomicInt>
+#include <QThread>
+#include "DirectorySessionPool.h"
+
+namespace ActiveDirectory {
+
+namespace {
+
+class FakeSession : public DirectorySession {
+public:
+    FakeSession(QAtomicInt *closedCount, bool isHealthy) :
+        m_closedCount(closedCount),
+        m_isHealthy(isHealthy)
+    {
+    }
+
+    ~FakeSession()
+    {
+        m_closedCount->fetchAndAddRelaxed(1);
+    }
+
+    bool isHealthy() override
+    {
+        return m_isHealthy;
+    }
+
+private:
+    QAtomicInt *m_closedCount;
+    bool m_isHealthy;
+};
+
+class FakeBackend : public DirectorySessionBackend {
+public:
+    FakeBackend() : isHealthy(true), isFailing(false) {}
+
+    QSharedPointer<DirectorySession> open(const DirectorySessionKey& key, QString *errorMsg) override
+    {
+        Q_UNUSED(key);
+        if (isFailing) {
+            *errorMsg = "Simulated bind failure";
+            return QSharedPointer<DirectorySession>();
+        }
+        openedCount.fetchAndAddRelaxed(1);
+        return QSharedPointer<DirectorySession>(new FakeSession(&closedCount, isHealthy));
+    }
+
+    QAtomicInt openedCount;
+    QAtomicInt closedCount;
+    bool isHealthy;
+    bool isFailing;
+};
+
+DirectorySessionKey forestKey(const QString& forestGuid, const QString& password = "password")
+{
+    return DirectorySessionKey(forestGuid, "dc1." + forestGuid + ".test", QString(), "admin", password);
+}
+
+} // anonymous namespace
+
+void DirectorySessionPoolTest::releasedSessionIsReused()
+{
+    QSharedPointer<FakeBackend> backend(new FakeBackend());
+    DirectorySessionPool pool(backend);
+
+    QSharedPointer<DirectorySession> first;
+    {
+        DirectorySessionPool::Lease lease = pool.acquire(forestKey("forest1"));
+        QVERIFY(lease.isValid());
+        first = lease.session();
+    }
+    QCOMPARE(pool.idleCount(), 1);
+
+    DirectorySessionPool::Lease lease = pool.acquire(forestKey("forest1"));
+    QCOMPARE(lease.session(), first);
+    QCOMPARE(backend->openedCount.load(), 1);
+    QCOMPARE(pool.idleCount(), 0);
+    QCOMPARE(pool.size(), 1);
+}
+
+void DirectorySessionPoolTest::otherCredentialsGetOtherSession()
+{
+    QSharedPointer<FakeBackend> backend(new FakeBackend());
+    DirectorySessionPool pool(backend);
+
+    pool.acquire(forestKey("forest1", "old")).release();
+    DirectorySessionPool::Lease lease = pool.acquire(forestKey("forest1", "new"));
+    QVERIFY(lease.isValid());
+    QCOMPARE(backend->openedCount.load(), 2);
+}
+
+void DirectorySessionPoolTest::discardedSessionIsClosed()
+{
+    QSharedPointer<FakeBackend> backend(new FakeBackend());
+    DirectorySessionPool pool(backend);
+
+    {
+        DirectorySessionPool::Lease lease = pool.acquire(forestKey("forest1"));
+        lease.discard();
+    }
+    QCOMPARE(pool.size(), 0);
+    QCOMPARE(backend->closedCount.load(), 1);
+}
+
+void DirectorySessionPoolTest::unhealthySessionIsReplaced()
+{
+    QSharedPointer<FakeBackend> backend(new FakeBackend());
+    backend->isHealthy = false;
+    DirectorySessionPool pool(backend);
+    pool.setHealthCheckInterval(0);
+
+    pool.acquire(forestKey("forest1")).release();
+    DirectorySessionPool::Lease lease = pool.acquire(forestKey("forest1"));
+    QVERIFY(lease.isValid());
+    QCOMPARE(backend->openedCount.load(), 2);
+    QCOMPARE(backend->closedCount.load(), 1);
+    QCOMPARE(pool.size(), 1);
+}
+
+void DirectorySessionPoolTest::invalidateForestClosesIdleAndLeasedSessions()
+{
+    QSharedPointer<FakeBackend> backend(new FakeBackend());
+    DirectorySessionPool pool(backend);
+
+    pool.acquire(forestKey("forest1")).release();
+    pool.acquire(forestKey("forest2")).release();
+    DirectorySessionPool::Lease leased = pool.acquire(DirectorySessionKey("forest1", "dc2.test", QString(), "admin", "password"));
+
+    pool.invalidateForest("forest1");
+    QCOMPARE(pool.idleCount(), 1);
+    QCOMPARE(backend->closedCount.load(), 1);
+
+    // Leased at the time of invalidation, closed when returned
+    leased.release();
+    QCOMPARE(backend->closedCount.load(), 2);
+    QCOMPARE(pool.idleCount(), 1);
+}
+
+void DirectorySessionPoolTest::maxSizeIsHardLimit()
+{
+    QSharedPointer<FakeBackend> backend(new FakeBackend());
+    DirectorySessionPool pool(backend);
+    pool.setMaxSize(2);
+    pool.setAcquireTimeout(50);
+
+    DirectorySessionPool::Lease first = pool.acquire(forestKey("forest1"));
+    DirectorySessionPool::Lease second = pool.acquire(forestKey("forest2"));
+    QString errorMsg;
+    DirectorySessionPool::Lease third = pool.acquire(forestKey("forest3"), &errorMsg);
+
+    QVERIFY(first.isValid());
+    QVERIFY(second.isValid());
+    QVERIFY(!third.isValid());
+    QVERIFY(!errorMsg.isEmpty());
+    QCOMPARE(pool.size(), 2);
+    QCOMPARE(backend->openedCount.load(), 2);
+}
+
+void DirectorySessionPoolTest::acquireWaitsForRelease()
+{
+    QSharedPointer<FakeBackend> backend(new FakeBackend());
+    DirectorySessionPool pool(backend);
+    pool.setMaxSize(1);
+    pool.setAcquireTimeout(5000);
+
+    DirectorySessionPool::Lease first = pool.acquire(forestKey("forest1"));
+    QThread *releaser = QThread::create([&first]() {
+        QThread::msleep(50);
+        first.release();
+    });
+    releaser->start();
+
+    DirectorySessionPool::Lease second = pool.acquire(forestKey("forest2"));
+    releaser->wait();
+    delete releaser;
+
+    QVERIFY(second.isValid());
+    QCOMPARE(pool.size(), 1);
+}
+
+void DirectorySessionPoolTest::idleSessionIsEvictedWhenFull()
+{
+    QSharedPointer<FakeBackend> backend(new FakeBackend());
+    DirectorySessionPool pool(backend);
+    pool.setMaxSize(1);
+
+    pool.acquire(forestKey("forest1")).release();
+    DirectorySessionPool::Lease lease = pool.acquire(forestKey("forest2"));
+    QVERIFY(lease.isValid());
+    QCOMPARE(backend->closedCount.load(), 1);
+    QCOMPARE(pool.size(), 1);
+}
+
+void DirectorySessionPoolTest::failedOpenFreesSlot()
+{
+    QSharedPointer<FakeBackend> backend(new FakeBackend());
+    DirectorySessionPool pool(backend);
+    pool.setMaxSize(1);
+    pool.setAcquireTimeout(0);
+
+    backend->isFailing = true;
+    QVERIFY(!pool.acquire(forestKey("forest1")).isValid());
+    QCOMPARE(pool.size(), 0);
+
+    backend->isFailing = false;
+    QVERIFY(pool.acquire(forestKey("forest1")).isValid());
+}
+
+} // namespace ActiveDirectory
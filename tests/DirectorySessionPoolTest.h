@@ -0,0 +1,27 @@
+#ifndef DIRECTORYSESSIONPOOLTEST_H
+#define DIRECTORYSESSIONPOOLTEST_H
+#include <QObject>
+
+namespace ActiveDirectory {
+
+/*
+ * DirectorySessionPool against a fake backend which counts opened and closed sessions
+ */
+class DirectorySessionPoolTest : public QObject {
+    Q_OBJECT
+
+private slots:
+    void releasedSessionIsReused();
+    void otherCredentialsGetOtherSession();
+    void discardedSessionIsClosed();
+    void unhealthySessionIsReplaced();
+    void invalidateForestClosesIdleAndLeasedSessions();
+    void maxSizeIsHardLimit();
+    void acquireWaitsForRelease();
+    void idleSessionIsEvictedWhenFull();
+    void failedOpenFreesSlot();
+};
+
+} // namespace ActiveDirectory
+
+#endif // DIRECTORYSESSIONPOOLTEST_H
@@ -0,0 +1,133 @@
+#include "DomainControllerProbeTest.h"
+#include <QtTest>
+#include <QElapsedTimer>
+#include "DomainControllerProbe.h"
+
+namespace ActiveDirectory {
+
+namespace {
+
+typedef SimulatedDomainControllerProbe::HostBehavior HostBehavior;
+
+QSharedPointer<SimulatedDomainControllerProbe> simulatedProbe(const HostBehavior& behavior = HostBehavior())
+{
+    return QSharedPointer<SimulatedDomainControllerProbe>(new SimulatedDomainControllerProbe(behavior));
+}
+
+} // anonymous namespace
+
+void DomainControllerProbeTest::finishedProbeReportsResult()
+{
+    AsyncDomainControllerProbe async(simulatedProbe(HostBehavior(10)));
+    DomainControllerProbeResult result = async.start("dc1.test", QDeadlineTimer(5000)).result();
+
+    QCOMPARE(result.status, DomainControllerProbeResult::FinishedStatus);
+    QVERIFY(result.isAccessible());
+    QCOMPARE(result.host, QString("dc1.test"));
+    QCOMPARE(result.dnsName, QString("dc1.test"));
+    QVERIFY(result.latencyMs >= 10);
+}
+
+void DomainControllerProbeTest::probeTimesOutAtDeadline()
+{
+    AsyncDomainControllerProbe async(simulatedProbe(HostBehavior(5000)));
+    QElapsedTimer timer;
+    timer.start();
+    DomainControllerProbeFuture future = async.start("slow.test", QDeadlineTimer(50));
+    DomainControllerProbeResult result = future.result();
+
+    QCOMPARE(result.status, DomainControllerProbeResult::TimedOutStatus);
+    QVERIFY(!result.isAccessible());
+    QVERIFY(timer.elapsed() < 1000);
+}
+
+void DomainControllerProbeTest::cancelFinishesProbeAndStopsBackend()
+{
+    QSharedPointer<SimulatedDomainControllerProbe> probe = simulatedProbe(HostBehavior(5000));
+    AsyncDomainControllerProbe async(probe);
+    DomainControllerProbeFuture future = async.start("slow.test", QDeadlineTimer(QDeadlineTimer::Forever));
+    QTRY_COMPARE(probe->probeCount(), 1);
+
+    QElapsedTimer timer;
+    timer.start();
+    future.cancel();
+    QVERIFY(future.waitForFinished(QDeadlineTimer(1000)));
+    QCOMPARE(future.result().status, DomainControllerProbeResult::CancelledStatus);
+    QVERIFY(timer.elapsed() < 1000);
+}
+
+void DomainControllerProbeTest::cancelOfParentTokenCancelsProbe()
+{
+    ProbeCancellationToken parent;
+    AsyncDomainControllerProbe async(simulatedProbe(HostBehavior(5000)));
+    DomainControllerProbeFuture future = async.start("slow.test", QDeadlineTimer(QDeadlineTimer::Forever), parent.child());
+
+    parent.cancel();
+    QVERIFY(future.waitForFinished(QDeadlineTimer(1000)));
+    QCOMPARE(future.result().status, DomainControllerProbeResult::CancelledStatus);
+}
+
+void DomainControllerProbeTest::waitForAnyReturnsFirstFinished()
+{
+    QSharedPointer<SimulatedDomainControllerProbe> probe = simulatedProbe(HostBehavior(2000));
+    probe->setHostBehavior("fast.test", HostBehavior(20));
+    AsyncDomainControllerProbe async(probe);
+    QVector<DomainControllerProbeFuture> futures = async.startAll(QStringList() << "slow1.test" << "fast.test" << "slow2.test",
+                                                                  QDeadlineTimer(5000));
+
+    QCOMPARE(DomainControllerProbeFuture::waitForAny(futures, QDeadlineTimer(1000)), 1);
+    QVERIFY(futures[1].result().isAccessible());
+    foreach (DomainControllerProbeFuture future, futures) {
+        future.cancel();
+    }
+}
+
+void DomainControllerProbeTest::waitForAnyReturnsMinusOneWhenNothingFinishes()
+{
+    AsyncDomainControllerProbe async(simulatedProbe(HostBehavior(5000)));
+    QVector<DomainControllerProbeFuture> futures = async.startAll(QStringList() << "slow1.test" << "slow2.test",
+                                                                  QDeadlineTimer(QDeadlineTimer::Forever));
+
+    QCOMPARE(DomainControllerProbeFuture::waitForAny(futures, QDeadlineTimer(50)), -1);
+    foreach (DomainControllerProbeFuture future, futures) {
+        future.cancel();
+    }
+}
+
+void DomainControllerProbeTest::parallelPrefersPrimaryWithinGrace()
+{
+    QSharedPointer<SimulatedDomainControllerProbe> probe = simulatedProbe(HostBehavior(10));
+    probe->setHostBehavior("primary.test", HostBehavior(100));
+
+    QString dnsName;
+    int index = ParallelDomainControllerProber::probe(probe, QStringList() << "primary.test" << "additional.test",
+                                                      true, 5000, 1000, &dnsName);
+    QCOMPARE(index, 0);
+    QCOMPARE(dnsName, QString("primary.test"));
+}
+
+void DomainControllerProbeTest::parallelFallsBackToFastestWhenPrimaryFails()
+{
+    QSharedPointer<SimulatedDomainControllerProbe> probe = simulatedProbe(HostBehavior(200));
+    probe->setHostBehavior("primary.test", HostBehavior(0, 1));
+    probe->setHostBehavior("fast.test", HostBehavior(10));
+
+    QVector<DomainControllerProbeOutcome> outcomes;
+    int index = ParallelDomainControllerProber::probe(probe, QStringList() << "primary.test" << "slow.test" << "fast.test",
+                                                      true, 5000, 1000, nullptr, &outcomes);
+    QCOMPARE(index, 2);
+    QCOMPARE(outcomes.size(), 3);
+    QVERIFY(outcomes[0].isDone);
+    QVERIFY(FAILED(outcomes[0].hr));
+    // Slow probe was cancelled when the fast one won
+    QVERIFY(!outcomes[1].isDone);
+}
+
+void DomainControllerProbeTest::parallelReturnsMinusOneWhenAllFail()
+{
+    QSharedPointer<SimulatedDomainControllerProbe> probe = simulatedProbe(HostBehavior(0, 1));
+    int index = ParallelDomainControllerProber::probe(probe, QStringList() << "dc1.test" << "dc2.test", false, 5000, 0, nullptr);
+    QCOMPARE(index, -1);
+}
+
+} // namespace ActiveDirectory
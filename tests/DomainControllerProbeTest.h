@@ -0,0 +1,27 @@
+#ifndef DOMAINCONTROLLERPROBETEST_H
+#define DOMAINCONTROLLERPROBETEST_H
+#include <QObject>
+
+namespace ActiveDirectory {
+
+/*
+ * Timeout, cancellation and selection paths of the DC probes, run against SimulatedDomainControllerProbe
+ */
+class DomainControllerProbeTest : public QObject {
+    Q_OBJECT
+
+private slots:
+    void finishedProbeReportsResult();
+    void probeTimesOutAtDeadline();
+    void cancelFinishesProbeAndStopsBackend();
+    void cancelOfParentTokenCancelsProbe();
+    void waitForAnyReturnsFirstFinished();
+    void waitForAnyReturnsMinusOneWhenNothingFinishes();
+    void parallelPrefersPrimaryWithinGrace();
+    void parallelFallsBackToFastestWhenPrimaryFails();
+    void parallelReturnsMinusOneWhenAllFail();
+};
+
+} // namespace ActiveDirectory
+
+#endif // DOMAINCONTROLLERPROBETEST_H
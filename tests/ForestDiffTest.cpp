@@ -0,0 +1,128 @@
+#include "ForestDiffTest.h"
+#include <QtTest>
+#include <algorithm>
+#include "ForestDiff.h"
+
+namespace ActiveDirectory {
+
+namespace {
+
+QString testGuid(int index)
+{
+    return QString("%1-0000-4000-8000-%2").arg(index, 8, 16, QChar('0')).arg(index, 12, 16, QChar('0'));
+}
+
+QVector<Forest> testForests(int count, int dcCount)
+{
+    QVector<Forest> ret;
+    for (int i = 0; i < count; ++i) {
+        Forest forest;
+        forest.objectGuid = testGuid(i);
+        forest.userName = QString("admin%1").arg(i);
+        forest.password = QString("secret%1").arg(i);
+        forest.syncGroup = QString("CN=Sync,DC=forest%1,DC=test").arg(i);
+        for (int j = 0; j < dcCount; ++j) {
+            DomainController dc;
+            dc.host = QString("dc%1.forest%2.test").arg(j).arg(i);
+            dc.isPrimary = (j == 0);
+            forest.domainControllers.append(dc);
+        }
+        ret.append(forest);
+    }
+    return ret;
+}
+
+/*
+ * Order independent description of the changes: forest guid with its change flags and
+ * the sorted DC changes, so both comparisons can be checked for equality
+ */
+QStringList describe(const QVector<ForestComparator::ForestWithChange>& changes)
+{
+    QStringList ret;
+    foreach (const ForestComparator::ForestWithChange& fc, changes) {
+        QStringList flags;
+        flags << (hasChange(fc, ForestComparator::Added) ? "added" : "")
+              << (hasChange(fc, ForestComparator::Deleted) ? "deleted" : "")
+              << (hasChange(fc, ForestComparator::CredentialsChanged) ? "credentials" : "")
+              << (hasChange(fc, ForestComparator::SyncGroupChanged) ? "syncGroup" : "");
+        QStringList dcChanges;
+        foreach (const auto& dcc, fc.domainControllerChanges) {
+            dcChanges << QString("%1=%2/%3").arg(dcc.domainContoller.host).arg(static_cast<int>(dcc.change))
+                                            .arg(dcc.domainContoller.isPrimary);
+        }
+        std::sort(dcChanges.begin(), dcChanges.end());
+        ret << fc.forest.objectGuid + " " + flags.join(",") + " " + dcChanges.join(",");
+    }
+    std::sort(ret.begin(), ret.end());
+    return ret;
+}
+
+} // anonymous namespace
+
+void ForestDiffTest::unchangedForestsHaveNoChanges()
+{
+    QVector<Forest> forests = testForests(20, 3);
+    QVector<ForestComparator::ForestWithChange> changes;
+    QVERIFY(!ForestDiff::compare(forests, ForestDiff::contentHashes(forests), forests, &changes));
+    QVERIFY(changes.isEmpty());
+}
+
+void ForestDiffTest::reorderedDomainControllersHaveNoChanges()
+{
+    QVector<Forest> oldForests = testForests(5, 3);
+    QVector<Forest> newForests = oldForests;
+    std::reverse(newForests[2].domainControllers.begin(), newForests[2].domainControllers.end());
+
+    QCOMPARE(ForestDiff::contentHash(newForests[2]), ForestDiff::contentHash(oldForests[2]));
+    QVector<ForestComparator::ForestWithChange> changes;
+    QVERIFY(!ForestDiff::compare(oldForests, ForestDiff::contentHashes(oldForests), newForests, &changes));
+    QVERIFY(changes.isEmpty());
+}
+
+void ForestDiffTest::learnedDnsNamesHaveNoChanges()
+{
+    // The pushed configuration has no DNS names, the loaded one has the names learned by probing
+    QVector<Forest> loadedForests = testForests(5, 2);
+    QVector<Forest> pushedForests = loadedForests;
+    for (int i = 0; i < loadedForests.size(); ++i) {
+        for (int j = 0; j < loadedForests[i].domainControllers.size(); ++j) {
+            loadedForests[i].domainControllers[j].dnsName = loadedForests[i].domainControllers[j].host.toUpper();
+        }
+    }
+
+    QCOMPARE(ForestDiff::contentHashes(pushedForests), ForestDiff::contentHashes(loadedForests));
+    QVector<ForestComparator::ForestWithChange> changes;
+    QVERIFY(!ForestDiff::compare(loadedForests, ForestDiff::contentHashes(loadedForests), pushedForests, &changes));
+}
+
+void ForestDiffTest::churnedForestsMatchComparator()
+{
+    QVector<Forest> oldForests = testForests(30, 3);
+    QVector<Forest> newForests = oldForests;
+    newForests[1].syncGroup += "-changed";
+    newForests[3].password += "-changed";
+    newForests[5].userName += "-changed";
+    newForests[7].domainControllers.removeLast();
+    newForests[9].domainControllers[0].isPrimary = false;
+    newForests[9].domainControllers[1].isPrimary = true;
+    std::reverse(newForests[9].domainControllers.begin(), newForests[9].domainControllers.end());
+    DomainController dc;
+    dc.host = "dcNew.forest11.test";
+    newForests[11].domainControllers.prepend(dc);
+    std::reverse(newForests[13].domainControllers.begin(), newForests[13].domainControllers.end());
+    newForests[15] = testForests(31, 2).last();
+    newForests.remove(17);
+    newForests.append(testForests(40, 1).last());
+    std::reverse(newForests.begin(), newForests.end());
+
+    QVector<ForestComparator::ForestWithChange> expected;
+    bool isExpectedChanged = ForestComparator::compare(oldForests, newForests, &expected);
+    QVector<ForestComparator::ForestWithChange> changes;
+    bool isChanged = ForestDiff::compare(oldForests, ForestDiff::contentHashes(oldForests), newForests, &changes);
+
+    QVERIFY(isExpectedChanged);
+    QCOMPARE(isChanged, isExpectedChanged);
+    QCOMPARE(describe(changes), describe(expected));
+}
+
+} // namespace ActiveDirectory
@@ -0,0 +1,22 @@
+#ifndef FORESTDIFFTEST_H
+#define FORESTDIFFTEST_H
+#include <QObject>
+
+namespace ActiveDirectory {
+
+/*
+ * ForestDiff::compare() must report the same changes as ForestComparator::compare()
+ */
+class ForestDiffTest : public QObject {
+    Q_OBJECT
+
+private slots:
+    void unchangedForestsHaveNoChanges();
+    void reorderedDomainControllersHaveNoChanges();
+    void learnedDnsNamesHaveNoChanges();
+    void churnedForestsMatchComparator();
+};
+
+} // namespace ActiveDirectory
+
+#endif // FORESTDIFFTEST_H
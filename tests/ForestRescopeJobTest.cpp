@@ -0,0 +1,227 @@
+#include "ForestRescopeJobTest.h"
+#include <QtTest>
+#include <QSqlQuery>
+#include "ForestRescopeJob.h"
+#include "ForestSchema.h"
+#include "BenchmarkDatabase.h"
+
+namespace ActiveDirectory {
+
+namespace {
+
+const char *FOREST_GUID = "00000001-0000-4000-8000-000000000001";
+
+/*
+ * Members per sync group, a sync group it does not know cannot be read (deleted in AD)
+ */
+class FakeGroupMembershipSource : public GroupMembershipSource {
+public:
+    void setMembers(const QString& syncGroup, const QStringList& userGuids, const QStringList& groupGuids)
+    {
+        m_users.insert(syncGroup, userGuids.toSet());
+        m_groups.insert(syncGroup, groupGuids.toSet());
+    }
+
+    bool scopeMembers(const Forest& forest, const DomainController& dc, const QString& syncGroup,
+                      QSet<QString> *userGuids, QSet<QString> *groupGuids, QString *errorMsg) override
+    {
+        Q_UNUSED(forest);
+        Q_UNUSED(dc);
+        if (!m_users.contains(syncGroup)) {
+            *errorMsg = "No such group";
+            return false;
+        }
+        *userGuids = m_users.value(syncGroup);
+        *groupGuids = m_groups.value(syncGroup);
+        return true;
+    }
+
+private:
+    QHash<QString, QSet<QString> > m_users;
+    QHash<QString, QSet<QString> > m_groups;
+};
+
+Forest testForest(const QString& syncGroup)
+{
+    Forest forest;
+    forest.objectGuid = FOREST_GUID;
+    forest.userName = "admin";
+    forest.password = "secret";
+    forest.syncGroup = syncGroup;
+    DomainController dc;
+    dc.host = "dc1.test";
+    dc.isPrimary = true;
+    forest.domainControllers.append(dc);
+    return forest;
+}
+
+// Forest row and its change to 'newSyncGroup' as ForestChangeBatchWriter does it
+bool changeSyncGroup(QSqlDatabase db, const QString& newSyncGroup)
+{
+    if (!ForestRescopeJob::schedule(QVariantList() << FOREST_GUID, QVariantList() << newSyncGroup, db)) {
+        return false;
+    }
+    QSqlQuery query(db);
+    query.prepare("UPDATE " FOREST_TABLE " SET " FOREST_SYNC_GROUP_COLUMN " = ? WHERE " FOREST_OBJECT_GUID_COLUMN " = ?");
+    query.addBindValue(newSyncGroup);
+    query.addBindValue(FOREST_GUID);
+    return query.exec();
+}
+
+bool insertObjects(QSqlDatabase db, const char *table, const QStringList& objectGuids)
+{
+    QSqlQuery query(db);
+    foreach (const QString& guid, objectGuids) {
+        query.prepare(QString("INSERT INTO %1 (object_guid, forest_guid) VALUES (?, ?)").arg(table));
+        query.addBindValue(guid);
+        query.addBindValue(FOREST_GUID);
+        if (!query.exec()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+QStringList deletedObjects(QSqlDatabase db, const char *table)
+{
+    QStringList ret;
+    QSqlQuery query(db);
+    query.exec(QString("SELECT object_guid FROM %1 WHERE is_deleted = 1 ORDER BY object_guid").arg(table));
+    while (query.next()) {
+        ret.append(query.value(0).toString());
+    }
+    return ret;
+}
+
+QStringList sorted(QStringList list)
+{
+    list.sort();
+    return list;
+}
+
+} // anonymous namespace
+
+void ForestRescopeJobTest::deltaSplitsEnteringAndLeaving()
+{
+    QSet<QString> oldMembers = (QStringList() << "a" << "b" << "c").toSet();
+    QSet<QString> newMembers = (QStringList() << "b" << "c" << "d" << "e").toSet();
+    QStringList entering, leaving;
+    ForestRescopeJob::delta(oldMembers, newMembers, &entering, &leaving);
+    QCOMPARE(sorted(entering), QStringList() << "d" << "e");
+    QCOMPARE(leaving, QStringList() << "a");
+
+    entering.clear();
+    leaving.clear();
+    ForestRescopeJob::delta(oldMembers, oldMembers, &entering, &leaving);
+    QVERIFY(entering.isEmpty());
+    QVERIFY(leaving.isEmpty());
+}
+
+void ForestRescopeJobTest::scheduleKeepsOldSyncGroupOfPendingRescope()
+{
+    BenchmarkDatabase database;
+    QSqlDatabase db = database.database();
+    QVERIFY(database.insert(QVector<Forest>() << testForest("G1")));
+
+    QVERIFY(changeSyncGroup(db, "G2"));
+    ForestRescope rescope = ForestRescopeJob::pendingOf(FOREST_GUID, db);
+    QCOMPARE(rescope.oldSyncGroup, QString("G1"));
+    QCOMPARE(rescope.newSyncGroup, QString("G2"));
+
+    // Not run yet, G1 is still what was synced
+    QVERIFY(changeSyncGroup(db, "G3"));
+    rescope = ForestRescopeJob::pendingOf(FOREST_GUID, db);
+    QCOMPARE(rescope.oldSyncGroup, QString("G1"));
+    QCOMPARE(rescope.newSyncGroup, QString("G3"));
+    QCOMPARE(ForestRescopeJob::pending(db).size(), 1);
+}
+
+void ForestRescopeJobTest::runFetchesEnteringAndMarksLeavingDeleted()
+{
+    BenchmarkDatabase database;
+    QSqlDatabase db = database.database();
+    QVERIFY(database.insert(QVector<Forest>() << testForest("G1")));
+    QVERIFY(insertObjects(db, AD_USER_TABLE, QStringList() << "u1" << "u2"));
+    QVERIFY(insertObjects(db, AD_GROUP_TABLE, QStringList() << "g1" << "g2"));
+    QVERIFY(changeSyncGroup(db, "G2"));
+
+    QSharedPointer<FakeGroupMembershipSource> source(new FakeGroupMembershipSource());
+    source->setMembers("G1", QStringList() << "u1" << "u2", QStringList() << "g1" << "g2");
+    source->setMembers("G2", QStringList() << "u2" << "u3", QStringList() << "g2");
+
+    QStringList fetchedUsers, fetchedGroups;
+    ForestRescopeJob job(source, db);
+    Forest forest = testForest("G2");
+    QVERIFY(job.run(forest, forest.domainControllers.first(),
+                    [&](const Forest&, const DomainController&, const QStringList& userGuids, const QStringList& groupGuids) {
+        fetchedUsers = userGuids;
+        fetchedGroups = groupGuids;
+        return true;
+    }));
+
+    QCOMPARE(fetchedUsers, QStringList() << "u3");
+    QVERIFY(fetchedGroups.isEmpty());
+    QCOMPARE(deletedObjects(db, AD_USER_TABLE), QStringList() << "u1");
+    QCOMPARE(deletedObjects(db, AD_GROUP_TABLE), QStringList() << "g1");
+    QVERIFY(ForestRescopeJob::pendingOf(FOREST_GUID, db).forestGuid.isEmpty());
+}
+
+void ForestRescopeJobTest::rescheduleDuringRunContinuesFromAppliedScope()
+{
+    BenchmarkDatabase database;
+    QSqlDatabase db = database.database();
+    QVERIFY(database.insert(QVector<Forest>() << testForest("G1")));
+    QVERIFY(changeSyncGroup(db, "G2"));
+
+    QSharedPointer<FakeGroupMembershipSource> source(new FakeGroupMembershipSource());
+    source->setMembers("G1", QStringList() << "u1", QStringList());
+    source->setMembers("G2", QStringList() << "u2", QStringList());
+
+    ForestRescopeJob job(source, db);
+    Forest forest = testForest("G2");
+    bool isRescheduled = false;
+    QVERIFY(job.run(forest, forest.domainControllers.first(),
+                    [&](const Forest&, const DomainController&, const QStringList&, const QStringList&) {
+        // Config push changing the sync group again while entering users are fetched
+        isRescheduled = changeSyncGroup(db, "G3");
+        return true;
+    }));
+    QVERIFY(isRescheduled);
+
+    // G2 was applied, the next run goes from it to G3
+    ForestRescope rescope = ForestRescopeJob::pendingOf(FOREST_GUID, db);
+    QCOMPARE(rescope.forestGuid, QString(FOREST_GUID));
+    QCOMPARE(rescope.oldSyncGroup, QString("G2"));
+    QCOMPARE(rescope.newSyncGroup, QString("G3"));
+}
+
+void ForestRescopeJobTest::unreadableOldScopeFallsBackToFullSync()
+{
+    BenchmarkDatabase database;
+    QSqlDatabase db = database.database();
+    QVERIFY(database.insert(QVector<Forest>() << testForest("G1")));
+    QSqlQuery query(db);
+    QVERIFY(query.exec(QString("INSERT INTO " SYNC_CONTEXT_TABLE " VALUES ('%1', 'dc1.test')").arg(FOREST_GUID)));
+    QVERIFY(changeSyncGroup(db, "G2"));
+
+    // Old group was deleted in AD
+    QSharedPointer<FakeGroupMembershipSource> source(new FakeGroupMembershipSource());
+    source->setMembers("G2", QStringList() << "u2", QStringList());
+
+    ForestRescopeJob job(source, db);
+    Forest forest = testForest("G2");
+    bool isFetched = false;
+    QVERIFY(job.run(forest, forest.domainControllers.first(),
+                    [&](const Forest&, const DomainController&, const QStringList&, const QStringList&) {
+        isFetched = true;
+        return true;
+    }));
+
+    QVERIFY(!isFetched);
+    QVERIFY(ForestRescopeJob::pendingOf(FOREST_GUID, db).forestGuid.isEmpty());
+    QVERIFY(query.exec("SELECT COUNT(*) FROM " SYNC_CONTEXT_TABLE));
+    QVERIFY(query.next());
+    QCOMPARE(query.value(0).toInt(), 0);
+}
+
+} // namespace ActiveDirectory
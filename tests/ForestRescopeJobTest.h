@@ -0,0 +1,23 @@
+#ifndef FORESTRESCOPEJOBTEST_H
+#define FORESTRESCOPEJOBTEST_H
+#include <QObject>
+
+namespace ActiveDirectory {
+
+/*
+ * ForestRescopeJob against a temporary SQLite database and a fake GroupMembershipSource
+ */
+class ForestRescopeJobTest : public QObject {
+    Q_OBJECT
+
+private slots:
+    void deltaSplitsEnteringAndLeaving();
+    void scheduleKeepsOldSyncGroupOfPendingRescope();
+    void runFetchesEnteringAndMarksLeavingDeleted();
+    void rescheduleDuringRunContinuesFromAppliedScope();
+    void unreadableOldScopeFallsBackToFullSync();
+};
+
+} // namespace ActiveDirectory
+
+#endif // FORESTRESCOPEJOBTEST_H
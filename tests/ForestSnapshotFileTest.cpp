@@ -0,0 +1,180 @@
+#include "ForestSnapshotFileTest.h"
+#include <QtTest>
+#include <QTemporaryDir>
+#include <QtEndian>
+#include <limits>
+#include "ForestSnapshotFile.h"
+#include "ForestDiff.h"
+#include "BenchmarkDatabase.h"
+
+namespace ActiveDirectory {
+
+namespace {
+
+// Header: magic, version, epoch, counter, then the forest count
+const int FOREST_COUNT_OFFSET = 4 + 4 + 8 + 8;
+
+ForestConfigurationStamp testStamp()
+{
+    ForestConfigurationStamp stamp;
+    stamp.epoch = 42;
+    stamp.counter = 7;
+    return stamp;
+}
+
+// Size of a QString in the stream: byte length, then UTF-16
+int streamedSize(const QString& str)
+{
+    return 4 + 2 * str.size();
+}
+
+// Forest with one DC, stored in 'database' so read() finds its password
+Forest storedForest(BenchmarkDatabase *database)
+{
+    Forest forest = BenchmarkDatabase::syntheticForests(1, 1).first();
+    forest.domainControllers[0].dnsName = "dc0.forest0.test.";
+    database->insert(QVector<Forest>() << forest);
+    return forest;
+}
+
+// First forest: guid, userName, syncGroup, hash, then the DC count
+int domainControllerCountOffset(const Forest& forest)
+{
+    return FOREST_COUNT_OFFSET + 4 + streamedSize(forest.objectGuid) + streamedSize(forest.userName) +
+           streamedSize(forest.syncGroup) + 8;
+}
+
+bool writeSnapshot(const QString& path, const QVector<Forest>& forests)
+{
+    return ForestSnapshotFile::write(path, testStamp(), forests, ForestDiff::contentHashes(forests));
+}
+
+/*
+ * Writes a snapshot of 'forest' and overwrites the qint32 at 'offset'
+ */
+bool writeDamagedSnapshot(const QString& path, const Forest& forest, int offset, qint32 value)
+{
+    if (!writeSnapshot(path, QVector<Forest>() << forest)) {
+        return false;
+    }
+
+    QFile file(path);
+    if (!file.open(QIODevice::ReadWrite)) {
+        return false;
+    }
+    QByteArray bytes = file.readAll();
+    if (bytes.size() < offset + 4) {
+        return false;
+    }
+    qToBigEndian(value, bytes.data() + offset);
+    file.seek(0);
+    return file.write(bytes) == bytes.size();
+}
+
+bool readSnapshot(const QString& path, QSqlDatabase db, QVector<Forest> *outForests = nullptr)
+{
+    QVector<Forest> forests;
+    QVector<quint64> contentHashes;
+    bool ret = ForestSnapshotFile::read(path, testStamp(), db, &forests, &contentHashes);
+    if (ret && outForests) {
+        *outForests = forests;
+    }
+    return ret;
+}
+
+void compareForests(const QVector<Forest>& actual, const QVector<Forest>& expected)
+{
+    QCOMPARE(actual.size(), expected.size());
+    for (int i = 0; i < expected.size(); ++i) {
+        QCOMPARE(actual[i].objectGuid, expected[i].objectGuid);
+        QCOMPARE(actual[i].userName, expected[i].userName);
+        QCOMPARE(actual[i].password, expected[i].password);
+        QCOMPARE(actual[i].syncGroup, expected[i].syncGroup);
+        QCOMPARE(actual[i].domainControllers.size(), expected[i].domainControllers.size());
+        for (int j = 0; j < expected[i].domainControllers.size(); ++j) {
+            QCOMPARE(actual[i].domainControllers[j].host, expected[i].domainControllers[j].host);
+            QCOMPARE(actual[i].domainControllers[j].isPrimary, expected[i].domainControllers[j].isPrimary);
+            QCOMPARE(actual[i].domainControllers[j].dnsName, expected[i].domainControllers[j].dnsName);
+        }
+    }
+}
+
+} // anonymous namespace
+
+void ForestSnapshotFileTest::roundTripKeepsForests()
+{
+    BenchmarkDatabase database;
+    QVector<Forest> forests = BenchmarkDatabase::syntheticForests(3, 2);
+    forests[1].domainControllers[1].dnsName = "dc1.forest1.test.";
+    QVERIFY(database.insert(forests));
+
+    QTemporaryDir dir;
+    QString path = dir.filePath("forests");
+    QVERIFY(writeSnapshot(path, forests));
+    QVector<Forest> read;
+    QVERIFY(readSnapshot(path, database.database(), &read));
+    compareForests(read, forests);
+
+    // Stamp of another database state
+    ForestConfigurationStamp otherStamp = testStamp();
+    otherStamp.counter++;
+    QVector<quint64> contentHashes;
+    QVERIFY(!ForestSnapshotFile::read(path, otherStamp, database.database(), &read, &contentHashes));
+}
+
+/*
+ * Positive control of the damaged file tests below: same forest and database, file not damaged
+ */
+void ForestSnapshotFileTest::intactSnapshotIsRead()
+{
+    BenchmarkDatabase database;
+    Forest forest = storedForest(&database);
+    QTemporaryDir dir;
+    QString path = dir.filePath("forests");
+    QVERIFY(writeSnapshot(path, QVector<Forest>() << forest));
+    QVector<Forest> read;
+    QVERIFY(readSnapshot(path, database.database(), &read));
+    compareForests(read, QVector<Forest>() << forest);
+}
+
+void ForestSnapshotFileTest::negativeForestCountIsRejected()
+{
+    BenchmarkDatabase database;
+    Forest forest = storedForest(&database);
+    QTemporaryDir dir;
+    QString path = dir.filePath("forests");
+    QVERIFY(writeDamagedSnapshot(path, forest, FOREST_COUNT_OFFSET, -1));
+    QVERIFY(!readSnapshot(path, database.database()));
+}
+
+void ForestSnapshotFileTest::forestCountBeyondFileIsRejected()
+{
+    BenchmarkDatabase database;
+    Forest forest = storedForest(&database);
+    QTemporaryDir dir;
+    QString path = dir.filePath("forests");
+    QVERIFY(writeDamagedSnapshot(path, forest, FOREST_COUNT_OFFSET, std::numeric_limits<qint32>::max()));
+    QVERIFY(!readSnapshot(path, database.database()));
+}
+
+void ForestSnapshotFileTest::negativeDomainControllerCountIsRejected()
+{
+    BenchmarkDatabase database;
+    Forest forest = storedForest(&database);
+    QTemporaryDir dir;
+    QString path = dir.filePath("forests");
+    QVERIFY(writeDamagedSnapshot(path, forest, domainControllerCountOffset(forest), -5));
+    QVERIFY(!readSnapshot(path, database.database()));
+}
+
+void ForestSnapshotFileTest::domainControllerCountBeyondFileIsRejected()
+{
+    BenchmarkDatabase database;
+    Forest forest = storedForest(&database);
+    QTemporaryDir dir;
+    QString path = dir.filePath("forests");
+    QVERIFY(writeDamagedSnapshot(path, forest, domainControllerCountOffset(forest), std::numeric_limits<qint32>::max()));
+    QVERIFY(!readSnapshot(path, database.database()));
+}
+
+} // namespace ActiveDirectory
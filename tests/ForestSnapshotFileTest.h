@@ -0,0 +1,25 @@
+#ifndef FORESTSNAPSHOTFILETEST_H
+#define FORESTSNAPSHOTFILETEST_H
+#include <QObject>
+
+namespace ActiveDirectory {
+
+/*
+ * ForestSnapshotFile::write() and read() against a temporary database. Damaged files must be
+ * rejected before allocating for counts the file cannot hold, the same file intact is read.
+ */
+class ForestSnapshotFileTest : public QObject {
+    Q_OBJECT
+
+private slots:
+    void roundTripKeepsForests();
+    void intactSnapshotIsRead();
+    void negativeForestCountIsRejected();
+    void forestCountBeyondFileIsRejected();
+    void negativeDomainControllerCountIsRejected();
+    void domainControllerCountBeyondFileIsRejected();
+};
+
+} // namespace ActiveDirectory
+
+#endif // FORESTSNAPSHOTFILETEST_H
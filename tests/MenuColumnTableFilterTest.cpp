@@ -0,0 +1,176 @@
+#include "MenuColumnTableFilterTest.h"
+#include <QtTest>
+#include <QSignalSpy>
+#include "MenuColumnTableFilterIndex.h"
+#include "MenuColumnTableWidget.h"
+
+namespace {
+
+QVector<int> rows(std::initializer_list<int> list)
+{
+    return QVector<int>(list);
+}
+
+QVariantList tableRows(const QStringList& names)
+{
+    QVariantList list;
+    foreach (const QString& name, names) {
+        QVariantMap map;
+        map["name"] = name;
+        map["host"] = name + ".example.com";
+        list.append(map);
+    }
+    return list;
+}
+
+void setUpTable(MenuColumnTableWidget *table)
+{
+    table->setColumnCount(2);
+    table->setColumnMappings(QStringList() << "name" << "host");
+    table->setFilterDebounceInterval(0);
+    table->setFilterColumn(0);
+}
+
+/*
+ * Rows not hidden after the filter ran
+ */
+QStringList visibleNames(MenuColumnTableWidget *table, const QString& filter)
+{
+    QSignalSpy spy(table, SIGNAL(filterApplied(int)));
+    table->setFilterText(filter);
+    if (!spy.wait()) {
+        return QStringList() << "<filter not applied>";
+    }
+    QStringList names;
+    for (int row = 0; row < table->rowCount(); ++row) {
+        if (!table->isRowHidden(row)) {
+            names.append(table->item(row, 0)->text());
+        }
+    }
+    return names;
+}
+
+QStringList columnTexts(MenuColumnTableWidget *table)
+{
+    QStringList texts;
+    for (int row = 0; row < table->rowCount(); ++row) {
+        texts.append(table->item(row, 0)->text());
+    }
+    return texts;
+}
+
+} // namespace
+
+void MenuColumnTableFilterTest::replacedTextIsNotFound()
+{
+    MenuColumnTableFilterIndex index;
+    index.setText(0, 0, "Alpha");
+    index.setText(1, 0, "Beta");
+    QCOMPARE(index.match("alp", -1), rows({0}));
+
+    index.setText(0, 0, "Gamma");
+    QCOMPARE(index.match("alp", -1), rows({}));
+    QCOMPARE(index.match("amm", -1), rows({0}));
+}
+
+void MenuColumnTableFilterTest::trigramSharedByOtherCellStays()
+{
+    MenuColumnTableFilterIndex index;
+    index.setText(0, 0, "alpha");
+    index.setText(0, 1, "alpine");
+    index.setText(0, 0, "beta");
+    QCOMPARE(index.match("alp", -1), rows({0}));
+    QCOMPARE(index.match("alp", 0), rows({}));
+}
+
+void MenuColumnTableFilterTest::insertedAndRemovedRowsShiftPostings()
+{
+    MenuColumnTableFilterIndex index;
+    index.setText(0, 0, "one");
+    index.setText(1, 0, "two");
+    index.setText(2, 0, "three");
+
+    index.insertRows(1, 2);
+    QCOMPARE(index.rowCount(), 5);
+    QCOMPARE(index.match("two", -1), rows({3}));
+    QCOMPARE(index.match("thr", -1), rows({4}));
+
+    index.removeRows(0, 4);
+    QCOMPARE(index.rowCount(), 1);
+    QCOMPARE(index.match("one", -1), rows({}));
+    QCOMPARE(index.match("two", -1), rows({}));
+    QCOMPARE(index.match("thr", -1), rows({0}));
+}
+
+void MenuColumnTableFilterTest::appendedRowsKeepPostings()
+{
+    MenuColumnTableFilterIndex index;
+    index.setText(0, 0, "one");
+    index.insertRows(1, 1);
+    index.setText(1, 0, "two");
+    index.insertRows(2, 3);
+
+    QCOMPARE(index.rowCount(), 5);
+    QCOMPARE(index.match("one", -1), rows({0}));
+    QCOMPARE(index.match("two", -1), rows({1}));
+    index.setText(4, 0, "twofold");
+    QCOMPARE(index.match("two", -1), rows({1, 4}));
+}
+
+void MenuColumnTableFilterTest::inheritedRowCallsKeepIndex()
+{
+    MenuColumnTableWidget table;
+    setUpTable(&table);
+    table.setData(tableRows(QStringList() << "alpha" << "beta" << "alphabet"));
+
+    table.removeRow(0);
+    QCOMPARE(visibleNames(&table, "alpha"), QStringList() << "alphabet");
+
+    table.insertRow(0);
+    table.setText(0, 0, "alphanumeric");
+    QCOMPARE(visibleNames(&table, "alphan"), QStringList() << "alphanumeric");
+
+    table.setRowCount(1);
+    QCOMPARE(visibleNames(&table, "alpha"), QStringList() << "alphanumeric");
+}
+
+void MenuColumnTableFilterTest::inheritedItemSetTextKeepsIndex()
+{
+    MenuColumnTableWidget table;
+    setUpTable(&table);
+    table.setData(tableRows(QStringList() << "alpha" << "beta"));
+
+    table.item(0, 0)->setText("gamma");
+    QCOMPARE(visibleNames(&table, "alpha"), QStringList());
+    QCOMPARE(visibleNames(&table, "gamm"), QStringList() << "gamma");
+}
+
+void MenuColumnTableFilterTest::permuteRemapsPostings()
+{
+    MenuColumnTableFilterIndex index;
+    index.setText(0, 0, "charlie");
+    index.setText(1, 0, "alpha");
+    index.setText(2, 0, "bravo");
+
+    index.permute(rows({1, 2, 0}));
+    QCOMPARE(index.match("alp", -1), rows({0}));
+    QCOMPARE(index.match("bra", -1), rows({1}));
+    QCOMPARE(index.match("cha", -1), rows({2}));
+    QCOMPARE(index.match("a", -1), rows({0, 1, 2}));
+}
+
+void MenuColumnTableFilterTest::rowsAppendedWhileSortingAreMerged()
+{
+    MenuColumnTableWidget table;
+    setUpTable(&table);
+    table.setData(tableRows(QStringList() << "user10" << "user3" << "user7" << "user1"));
+
+    QSignalSpy spy(&table, SIGNAL(rowsSorted(int, Qt::SortOrder)));
+    table.sortRows(0);
+    // Result of the first sort is queued to this thread, so these rows come before it
+    table.appendRows(tableRows(QStringList() << "user5" << "user2"));
+    QVERIFY(spy.wait());
+
+    QCOMPARE(columnTexts(&table), QStringList() << "user1" << "user2" << "user3" << "user5" << "user7" << "user10");
+    QCOMPARE(visibleNames(&table, "user1"), QStringList() << "user1" << "user10");
+}
@@ -0,0 +1,22 @@
+#ifndef MENUCOLUMNTABLEFILTERTEST_H
+#define MENUCOLUMNTABLEFILTERTEST_H
+#include <QObject>
+
+/*
+ * Trigram filter index alone and kept in sync by MenuColumnTableWidget, also across sorts
+ */
+class MenuColumnTableFilterTest : public QObject {
+    Q_OBJECT
+
+private slots:
+    void replacedTextIsNotFound();
+    void trigramSharedByOtherCellStays();
+    void insertedAndRemovedRowsShiftPostings();
+    void appendedRowsKeepPostings();
+    void inheritedRowCallsKeepIndex();
+    void inheritedItemSetTextKeepsIndex();
+    void permuteRemapsPostings();
+    void rowsAppendedWhileSortingAreMerged();
+};
+
+#endif // MENUCOLUMNTABLEFILTERTEST_H
@@ -0,0 +1,87 @@
+#include "SyncProgressLedgerTest.h"
+#include <QtTest>
+#include "SyncProgressLedger.h"
+#include "BenchmarkDatabase.h"
+
+namespace ActiveDirectory {
+
+namespace {
+
+const char *FOREST_GUID = "00000001-0000-4000-8000-000000000001";
+
+DirectoryReplicationState replicationState(const QString& invocationId, qint64 highestCommittedUsn,
+                                           const QHash<QString, qint64>& upToDateVector)
+{
+    DirectoryReplicationState state;
+    state.invocationId = invocationId;
+    state.highestCommittedUsn = highestCommittedUsn;
+    state.upToDateVector = upToDateVector;
+    return state;
+}
+
+QHash<QString, qint64> vector(qint64 usnOfA, qint64 usnOfB)
+{
+    QHash<QString, qint64> ret;
+    ret.insert("A", usnOfA);
+    ret.insert("B", usnOfB);
+    return ret;
+}
+
+// Complete sync from DC "A": knowledge becomes A=100, B=50
+bool syncFromA(QSqlDatabase db)
+{
+    return SyncProgressLedger::recordCheckpoint(FOREST_GUID, "dcA.test", replicationState("A", 100, vector(100, 50)), 100, db);
+}
+
+} // anonymous namespace
+
+void SyncProgressLedgerTest::checkpointResumesSameDomainController()
+{
+    BenchmarkDatabase database;
+    QSqlDatabase db = database.database();
+    QVERIFY(syncFromA(db));
+
+    qint64 usn = -1;
+    QVERIFY(SyncProgressLedger::resumeUsn(FOREST_GUID, replicationState("A", 150, vector(150, 60)), &usn, db));
+    QCOMPARE(usn, qint64(100));
+}
+
+void SyncProgressLedgerTest::coveredObservationResumesOtherDomainController()
+{
+    BenchmarkDatabase database;
+    QSqlDatabase db = database.database();
+    // B had seen only what we synced from A
+    QVERIFY(SyncProgressLedger::recordObservation(FOREST_GUID, "dcB.test", replicationState("B", 60, vector(90, 50)), db));
+    QVERIFY(syncFromA(db));
+
+    qint64 usn = -1;
+    QVERIFY(SyncProgressLedger::resumeUsn(FOREST_GUID, replicationState("B", 70, vector(120, 70)), &usn, db));
+    QCOMPARE(usn, qint64(60));
+}
+
+void SyncProgressLedgerTest::uncoveredObservationNeedsFullSync()
+{
+    BenchmarkDatabase database;
+    QSqlDatabase db = database.database();
+    // B had changes of A which we never synced
+    QVERIFY(SyncProgressLedger::recordObservation(FOREST_GUID, "dcB.test", replicationState("B", 60, vector(120, 50)), db));
+    QVERIFY(syncFromA(db));
+
+    qint64 usn = -1;
+    QVERIFY(!SyncProgressLedger::resumeUsn(FOREST_GUID, replicationState("B", 70, vector(130, 70)), &usn, db));
+    // Nothing at all is known of C
+    QVERIFY(!SyncProgressLedger::resumeUsn(FOREST_GUID, replicationState("C", 10, vector(100, 50)), &usn, db));
+}
+
+void SyncProgressLedgerTest::usnRollbackNeedsFullSync()
+{
+    BenchmarkDatabase database;
+    QSqlDatabase db = database.database();
+    QVERIFY(syncFromA(db));
+
+    // A restored from backup without a new invocationId
+    qint64 usn = -1;
+    QVERIFY(!SyncProgressLedger::resumeUsn(FOREST_GUID, replicationState("A", 80, vector(80, 50)), &usn, db));
+}
+
+} // namespace ActiveDirectory
@@ -0,0 +1,22 @@
+#ifndef SYNCPROGRESSLEDGERTEST_H
+#define SYNCPROGRESSLEDGERTEST_H
+#include <QObject>
+
+namespace ActiveDirectory {
+
+/*
+ * SyncProgressLedger::resumeUsn() after checkpoints and observations in a temporary database
+ */
+class SyncProgressLedgerTest : public QObject {
+    Q_OBJECT
+
+private slots:
+    void checkpointResumesSameDomainController();
+    void coveredObservationResumesOtherDomainController();
+    void uncoveredObservationNeedsFullSync();
+    void usnRollbackNeedsFullSync();
+};
+
+} // namespace ActiveDirectory
+
+#endif // SYNCPROGRESSLEDGERTEST_H
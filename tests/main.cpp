@@ -0,0 +1,54 @@
+#include <QApplication>
+#include <QtTest>
+#include "DatabaseWriterTest.h"
+#include "DirectorySessionPoolTest.h"
+#include "DomainControllerProbeTest.h"
+#include "ForestDiffTest.h"
+#include "ForestRescopeJobTest.h"
+#include "ForestSnapshotFileTest.h"
+#include "MenuColumnTableFilterTest.h"
+#include "SyncProgressLedgerTest.h"
+
+/*
+ * Runs every test class, exit code is the number of failed classes
+ */
+int main(int argc, char *argv[])
+{
+    QApplication app(argc, argv);
+    app.setApplicationName("ad_tests");
+
+    int failed = 0;
+    {
+        ActiveDirectory::DatabaseWriterTest test;
+        failed += QTest::qExec(&test, argc, argv) != 0 ? 1 : 0;
+    }
+    {
+        ActiveDirectory::DirectorySessionPoolTest test;
+        failed += QTest::qExec(&test, argc, argv) != 0 ? 1 : 0;
+    }
+    {
+        ActiveDirectory::DomainControllerProbeTest test;
+        failed += QTest::qExec(&test, argc, argv) != 0 ? 1 : 0;
+    }
+    {
+        ActiveDirectory::ForestDiffTest test;
+        failed += QTest::qExec(&test, argc, argv) != 0 ? 1 : 0;
+    }
+    {
+        ActiveDirectory::ForestRescopeJobTest test;
+        failed += QTest::qExec(&test, argc, argv) != 0 ? 1 : 0;
+    }
+    {
+        ActiveDirectory::ForestSnapshotFileTest test;
+        failed += QTest::qExec(&test, argc, argv) != 0 ? 1 : 0;
+    }
+    {
+        MenuColumnTableFilterTest test;
+        failed += QTest::qExec(&test, argc, argv) != 0 ? 1 : 0;
+    }
+    {
+        ActiveDirectory::SyncProgressLedgerTest test;
+        failed += QTest::qExec(&test, argc, argv) != 0 ? 1 : 0;
+    }
+    return failed;
+}
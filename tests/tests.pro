@@ -0,0 +1,37 @@
+# Unit tests of the forest configuration code, built like the benchmarks:
+#   qmake QLIQDIRECT_SRC=<qliqDirect root> QLIQDIRECT_LIBS="..." && make
+#   ./ad_tests
+
+TEMPLATE = app
+TARGET = ad_tests
+CONFIG += console testcase
+CONFIG -= app_bundle
+QT += testlib
+
+include(../ActiveDirectory.pri)
+
+# Temporary SQLite database with the forest tables
+INCLUDEPATH += ../benchmarks
+HEADERS += ../benchmarks/BenchmarkDatabase.h
+SOURCES += ../benchmarks/BenchmarkDatabase.cpp
+
+HEADERS += \
+    DatabaseWriterTest.h \
+    DirectorySessionPoolTest.h \
+    DomainControllerProbeTest.h \
+    ForestDiffTest.h \
+    ForestRescopeJobTest.h \
+    ForestSnapshotFileTest.h \
+    MenuColumnTableFilterTest.h \
+    SyncProgressLedgerTest.h
+
+SOURCES += \
+    main.cpp \
+    DatabaseWriterTest.cpp \
+    DirectorySessionPoolTest.cpp \
+    DomainControllerProbeTest.cpp \
+    ForestDiffTest.cpp \
+    ForestRescopeJobTest.cpp \
+    ForestSnapshotFileTest.cpp \
+    MenuColumnTableFilterTest.cpp \
+    SyncProgressLedgerTest.cpp